@@ -0,0 +1,114 @@
+#include <iostream>
+#include <cassert>
+#include <algorithm>
+#include <string>
+#include <vector>
+
+#include "approximate_index.hpp"
+
+using namespace std;
+
+static vector<uint32_t> ids(vector<ApproximateMatch> matches) {
+  vector<uint32_t> result;
+  for (const ApproximateMatch& m : matches) {
+    result.push_back(m.id);
+  }
+  sort(result.begin(), result.end());
+  return result;
+}
+
+static SmallString make(size_t length, size_t seed) {
+  SmallString s;
+  for (size_t i = 0; i < length; ++i) {
+    char c[2] = {static_cast<char>('a' + (i * 5 + seed * 11 + (seed * i * i) / 7) % 4), '\0'};
+    s.append(c);
+  }
+  return s;
+}
+
+// TESTS
+
+int main() {
+
+  // A few words
+  ApproximateIndex words;
+  const char* dictionary[] = {"apple", "apply", "ample", "maple", "applesauce", "banana", "bandana", "an"};
+  for (const char* word : dictionary) {
+    words.insert(SmallString(word));
+  }
+  assert (words.size() == 8);
+
+  assert (ids(words.search(SmallString("apple"), 0)) == (vector<uint32_t>{0}));
+  assert (ids(words.search(SmallString("apple"), 1)) == (vector<uint32_t>{0, 1, 2}));
+  assert (ids(words.search(SmallString("banana"), 1)) == (vector<uint32_t>{5, 6}));
+  assert (ids(words.search(SmallString("a"), 1)) == (vector<uint32_t>{7})); // Short: BK-tree
+
+  vector<ApproximateMatch> closest = words.top_n(SmallString("appel"), 2, 3);
+  assert (closest.size() == 2);
+  assert (closest[0].id == 0 && closest[0].distance == 2);
+  assert (closest[1].id == 1 && closest[1].distance == 2);
+
+  // Against a full scan, with and without the BK-tree, including keys
+  // that spill out of the buffer.
+  for (bool bk_tree : {true, false}) {
+    ApproximateIndex index(bk_tree);
+    vector<SmallString> keys;
+
+    for (size_t seed = 0; seed < 300; ++seed) {
+      keys.push_back(make(1 + seed % 30, seed));
+      index.insert(keys.back());
+    }
+
+    for (size_t q = 0; q < 40; ++q) {
+      SmallString query = make(1 + (q * 7) % 30, q * 3);
+
+      for (size_t k = 0; k <= 4; ++k) {
+        vector<uint32_t> expected;
+        for (uint32_t id = 0; id < keys.size(); ++id) {
+          if (edit_distance(query, keys[id]) <= k) {
+            expected.push_back(id);
+          }
+        }
+
+        vector<ApproximateMatch> found = index.search(query, k);
+        assert (ids(found) == expected);
+        for (const ApproximateMatch& m : found) {
+          assert (m.distance == edit_distance(query, keys[m.id]));
+        }
+      }
+    }
+  }
+
+  // Few letters, so the posting lists are long and the probes skip far
+  // ahead in them.
+  {
+    ApproximateIndex index(false);
+    vector<SmallString> keys;
+    uint64_t x = 7;
+    for (size_t i = 0; i < 4000; ++i) {
+      string text;
+      for (size_t n = 0; n < 6 + i % 7; ++n) {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        text += "abc"[(x >> 33) % 3];
+      }
+      keys.push_back(SmallString(text.c_str()));
+      index.insert(keys.back());
+    }
+
+    for (size_t q = 0; q < 30; ++q) {
+      const SmallString& query = keys[(q * 131) % keys.size()];
+      for (size_t k = 0; k <= 2; ++k) {
+        vector<uint32_t> expected;
+        for (uint32_t id = 0; id < keys.size(); ++id) {
+          if (edit_distance(query, keys[id]) <= k) {
+            expected.push_back(id);
+          }
+        }
+        assert (ids(index.search(query, k)) == expected);
+      }
+    }
+  }
+
+  return 0;
+
+}
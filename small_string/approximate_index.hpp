@@ -0,0 +1,280 @@
+#ifndef APPROXIMATE_INDEX_HPP
+#define APPROXIMATE_INDEX_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "edit_distance.hpp"
+#include "small_string.hpp"
+
+/*
+ApproximateIndex:
+Finds the stored keys within edit distance k of a query without
+comparing the query against every key.
+
+Every key is cut into padded q-grams ("ab" -> "##a", "#ab", "ab#",
+"b##"), and each distinct gram maps to the (sorted) ids of the keys
+that contain it. An edit touches at most Q grams, so a key within
+distance k of the query still shares at least
+    (distinct grams of the query) - k * Q
+of them. Only keys passing that count (and the length difference
+check) get verified with the bounded edit distance.
+
+When the count bound says nothing (short queries, large k), a BK-tree
+takes over: if it's enabled, its triangle-inequality pruning does a lot
+better than a full scan for small k.
+*/
+
+struct ApproximateMatch {
+  uint32_t id;
+  size_t distance;
+};
+
+class ApproximateIndex {
+
+  static constexpr size_t Q = 3;
+
+  struct BkNode {
+    uint32_t id;
+    std::vector<std::pair<size_t, uint32_t>> children; // (distance, node)
+  };
+
+  private:
+  std::vector<SmallString> _keys;
+  std::unordered_map<uint32_t, std::vector<uint32_t>> _postings;
+  bool _use_bk_tree;
+  std::vector<BkNode> _bk_nodes;
+
+    // The distinct padded grams of s, packed three bytes to an int.
+    static std::vector<uint32_t> grams(const SmallString& s) {
+      std::vector<uint32_t> result;
+      size_t length = s.length();
+      uint32_t gram = 0;
+
+      // Byte 0 pads both ends; keys that really contain '\0' just get a
+      // few extra (harmless) candidates.
+      for (size_t i = 0; i < length + Q - 1; ++i) {
+        uint32_t c = (i < length) ? static_cast<unsigned char>(s.at_unchecked(i)) : 0;
+        gram = ((gram << 8) | c) & 0xFFFFFF;
+        result.push_back(gram);
+      }
+
+      std::sort(result.begin(), result.end());
+      result.erase(std::unique(result.begin(), result.end()), result.end());
+      return result;
+    }
+
+    static size_t length_difference(size_t a, size_t b) noexcept {
+      return (a > b) ? a - b : b - a;
+    }
+
+    // Moves at forward to the first id >= the one wanted (galloping, then
+    // a binary search over the last stride), and says if it's there.
+    static bool skip_to(const uint32_t*& at, const uint32_t* end, uint32_t id) noexcept {
+      size_t stride = 1;
+      while (at + stride < end && at[stride] < id) {
+        at += stride;
+        stride *= 2;
+      }
+      at = std::lower_bound(at, (at + stride < end) ? at + stride + 1 : end, id);
+      return at != end && *at == id;
+    }
+
+    void bk_insert(uint32_t id) {
+      _bk_nodes.push_back(BkNode{id, {}});
+      uint32_t node_index = static_cast<uint32_t>(_bk_nodes.size() - 1);
+      if (node_index == 0) {
+        return;
+      }
+
+      uint32_t current = 0;
+      while (true) {
+        size_t d = edit_distance(_keys[_bk_nodes[current].id], _keys[id]);
+
+        auto& children = _bk_nodes[current].children;
+        auto child = std::find_if(children.begin(), children.end(), [d](const std::pair<size_t, uint32_t>& c) {
+          return c.first == d;
+        });
+
+        if (child == children.end()) {
+          children.push_back(std::make_pair(d, node_index));
+          return;
+        }
+        current = child->second;
+      }
+    }
+
+    void bk_search(const EditDistanceQuery& query, size_t k, std::vector<ApproximateMatch>& out) const {
+      if (_bk_nodes.empty()) {
+        return;
+      }
+
+      std::vector<uint32_t> stack(1, 0);
+      while (!stack.empty()) {
+        const BkNode& node = _bk_nodes[stack.back()];
+        stack.pop_back();
+
+        // The exact distance is needed to prune the children.
+        size_t d = query.distance(_keys[node.id]);
+        if (d <= k) {
+          out.push_back(ApproximateMatch{node.id, d});
+        }
+
+        for (const std::pair<size_t, uint32_t>& child : node.children) {
+          if (length_difference(child.first, d) <= k) {
+            stack.push_back(child.second);
+          }
+        }
+      }
+    }
+
+    void scan(const SmallString& query, const EditDistanceQuery& prepared, size_t k,
+              std::vector<ApproximateMatch>& out) const {
+      for (uint32_t id = 0; id < _keys.size(); ++id) {
+        if (length_difference(_keys[id].length(), query.length()) > k) {
+          continue;
+        }
+
+        size_t d = prepared.distance(_keys[id], k);
+        if (d <= k) {
+          out.push_back(ApproximateMatch{id, d});
+        }
+      }
+    }
+
+  public:
+  explicit ApproximateIndex(bool use_bk_tree = true) : _use_bk_tree(use_bk_tree) {}
+
+  // Adds a key and returns its id (ids are handed out in order).
+  uint32_t insert(const SmallString& key) {
+    uint32_t id = static_cast<uint32_t>(_keys.size());
+    _keys.push_back(key);
+
+    // Ids only grow, so appending keeps the posting lists sorted.
+    for (uint32_t gram : grams(key)) {
+      _postings[gram].push_back(id);
+    }
+
+    if (_use_bk_tree) {
+      bk_insert(id);
+    }
+
+    return id;
+  }
+
+  size_t size() const noexcept {
+    return _keys.size();
+  }
+
+  const SmallString& key(uint32_t id) const {
+    return _keys.at(id);
+  }
+
+  // All the keys within distance k of the query, in no particular order.
+  std::vector<ApproximateMatch> search(const SmallString& query, size_t k) const {
+    std::vector<ApproximateMatch> out;
+    EditDistanceQuery prepared(query);
+
+    std::vector<uint32_t> query_grams = grams(query);
+    size_t lost = k * Q;
+
+    if (query_grams.size() <= lost) {
+      // The count filter can't rule anything out.
+      if (_use_bk_tree) {
+        bk_search(prepared, k, out);
+      }
+      else {
+        scan(query, prepared, k, out);
+      }
+      return out;
+    }
+
+    size_t threshold = query_grams.size() - lost;
+
+    // The posting lists of the query's grams, shortest first. A key that
+    // shares threshold grams must show up in one of the first
+    // (lists - threshold + 1) lists; the rest are only probed.
+    std::vector<const std::vector<uint32_t>*> lists;
+    for (uint32_t gram : query_grams) {
+      auto found = _postings.find(gram);
+      if (found != _postings.end()) {
+        lists.push_back(&found->second);
+      }
+    }
+
+    if (lists.size() < threshold) {
+      return out;
+    }
+
+    std::sort(lists.begin(), lists.end(), [](const std::vector<uint32_t>* a, const std::vector<uint32_t>* b) {
+      return a->size() < b->size();
+    });
+
+    // The lists are sorted, so the candidates are merged, not sorted;
+    // and they come out in order, so each probed list is walked forward
+    // from where the previous probe left it.
+    size_t scanned = lists.size() - threshold + 1;
+    std::vector<uint32_t> candidates;
+    for (size_t l = 0; l < scanned; ++l) {
+      size_t merged = candidates.size();
+      candidates.insert(candidates.end(), lists[l]->begin(), lists[l]->end());
+      std::inplace_merge(candidates.begin(), candidates.begin() + merged, candidates.end());
+    }
+
+    std::vector<const uint32_t*> cursors;
+    for (size_t l = scanned; l < lists.size(); ++l) {
+      cursors.push_back(lists[l]->data());
+    }
+
+    for (size_t i = 0; i < candidates.size();) {
+      uint32_t id = candidates[i];
+      size_t count = 0;
+      for (; i < candidates.size() && candidates[i] == id; ++i) {
+        ++count;
+      }
+
+      // Stops as soon as the lists left can't make up the threshold:
+      // most candidates share a single gram, and miss on the first probe.
+      for (size_t l = scanned; l < lists.size() && count < threshold && count + (lists.size() - l) >= threshold; ++l) {
+        if (skip_to(cursors[l - scanned], lists[l]->data() + lists[l]->size(), id)) {
+          ++count;
+        }
+      }
+      if (count < threshold) {
+        continue;
+      }
+
+      if (length_difference(_keys[id].length(), query.length()) > k) {
+        continue;
+      }
+
+      size_t d = prepared.distance(_keys[id], k);
+      if (d <= k) {
+        out.push_back(ApproximateMatch{id, d});
+      }
+    }
+
+    return out;
+  }
+
+  // The (at most) n closest keys within max_k, closest first; ties go
+  // to the key that was inserted first.
+  std::vector<ApproximateMatch> top_n(const SmallString& query, size_t n, size_t max_k) const {
+    std::vector<ApproximateMatch> matches = search(query, max_k);
+    size_t keep = (n < matches.size()) ? n : matches.size();
+
+    std::partial_sort(matches.begin(), matches.begin() + keep, matches.end(),
+                      [](const ApproximateMatch& a, const ApproximateMatch& b) {
+                        return (a.distance != b.distance) ? a.distance < b.distance : a.id < b.id;
+                      });
+
+    matches.resize(keep);
+    return matches;
+  }
+
+};
+
+#endif
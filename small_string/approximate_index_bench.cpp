@@ -0,0 +1,142 @@
+#include <iostream>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#include "approximate_index.hpp"
+
+using namespace std;
+
+/*
+Queries on an ApproximateIndex of N keys (10M unless given on the
+command line): random lowercase identifiers of 8 to 16 bytes, queried
+with stored keys that had 1 or 2 random edits made to them, at k = 1
+and k = 2 (the q-gram filter), and with 4-byte queries at k = 1 on an
+index of N / 10 keys with the BK-tree (which the q-grams can't filter).
+Also the time to build each index.
+*/
+
+static volatile size_t sink;
+
+static uint64_t state = 1;
+
+static uint64_t next_random() {
+  state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+  return state >> 33;
+}
+
+static string random_key(size_t min_length, size_t max_length) {
+  size_t length = min_length + next_random() % (max_length - min_length + 1);
+  string key;
+  for (size_t i = 0; i < length; ++i) {
+    key += static_cast<char>('a' + next_random() % 26);
+  }
+  return key;
+}
+
+// `edits` random substitutions, insertions or deletions.
+static string mutated(string key, size_t edits) {
+  for (size_t e = 0; e < edits; ++e) {
+    size_t at = next_random() % key.size();
+    char c = static_cast<char>('a' + next_random() % 26);
+    switch (next_random() % 3) {
+      case 0:
+        key[at] = c;
+        break;
+      case 1:
+        key.insert(key.begin() + at, c);
+        break;
+      default:
+        key.erase(key.begin() + at);
+        break;
+    }
+  }
+  return key;
+}
+
+template <typename Body>
+static void time_us(const char* name, size_t operations, Body body) {
+  auto start = chrono::steady_clock::now();
+  body();
+  double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << us / operations << " us/query" << endl;
+}
+
+template <typename Body>
+static void time_s(const char* name, Body body) {
+  auto start = chrono::steady_clock::now();
+  body();
+  double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << s << " s" << endl;
+}
+
+int main(int argc, char** argv) {
+
+  const size_t N = (argc > 1) ? strtoull(argv[1], nullptr, 10) : 10000000;
+  const size_t QUERIES = 1000;
+
+  vector<string> keys;
+  for (size_t i = 0; i < N; ++i) {
+    keys.push_back(random_key(8, 16));
+  }
+
+  ApproximateIndex grams(false);
+  time_s("build, q-grams", [&]() {
+    for (const string& key : keys) {
+      grams.insert(SmallString(key.c_str()));
+    }
+  });
+
+  for (size_t k = 1; k <= 2; ++k) {
+    vector<SmallString> queries;
+    for (size_t q = 0; q < QUERIES; ++q) {
+      queries.push_back(SmallString(mutated(keys[next_random() % N], k).c_str()));
+    }
+
+    string name = "search, q-grams, k = " + to_string(k);
+    time_us(name.c_str(), QUERIES, [&]() {
+      size_t found = 0;
+      for (const SmallString& query : queries) {
+        found += grams.search(query, k).size();
+      }
+      sink = found;
+    });
+
+    name = "top 10, q-grams, k = " + to_string(k);
+    time_us(name.c_str(), QUERIES, [&]() {
+      size_t found = 0;
+      for (const SmallString& query : queries) {
+        found += grams.top_n(query, 10, k).size();
+      }
+      sink = found;
+    });
+  }
+
+  vector<SmallString> short_keys;
+  for (size_t i = 0; i < N / 10; ++i) {
+    short_keys.push_back(SmallString(random_key(3, 6).c_str()));
+  }
+
+  ApproximateIndex tree(true);
+  time_s("build, BK-tree, N / 10 keys", [&]() {
+    for (const SmallString& key : short_keys) {
+      tree.insert(key);
+    }
+  });
+
+  vector<SmallString> short_queries;
+  for (size_t q = 0; q < QUERIES; ++q) {
+    short_queries.push_back(SmallString(random_key(4, 4).c_str()));
+  }
+
+  time_us("search, BK-tree, 4-byte queries, k = 1", QUERIES, [&]() {
+    size_t found = 0;
+    for (const SmallString& query : short_queries) {
+      found += tree.search(query, 1).size();
+    }
+    sink = found;
+  });
+
+  return 0;
+}
@@ -0,0 +1,129 @@
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "art_map.hpp"
+
+using namespace std;
+
+// Paths with lots of shared prefixes, some long enough to overflow both
+// the inline buffer and the stored node prefixes.
+static SmallString make(size_t seed) {
+  const char* parts[] = {"usr", "local", "a", "b", "share", "x", "averyveryverylongdirectoryname", ""};
+  SmallString s;
+  size_t x = seed;
+  for (size_t depth = 0; depth < 1 + seed % 5; ++depth) {
+    s.append("/");
+    s.append(parts[x % 8]);
+    x = x * 2654435761u % 1000003;
+  }
+  return s;
+}
+
+// TESTS
+
+int main() {
+
+  ArtMap<int> map;
+  assert (map.size() == 0);
+  assert (map.find(SmallString("nothing")) == nullptr);
+
+  // Keys that are prefixes of each other
+  assert (map.insert_or_assign(SmallString("a"), 1));
+  assert (map.insert_or_assign(SmallString("ab"), 2));
+  assert (map.insert_or_assign(SmallString("abc"), 3));
+  assert (map.insert_or_assign(SmallString(""), 0));
+  assert (!map.insert_or_assign(SmallString("ab"), 20));
+  assert (map.size() == 4);
+  assert (*map.find(SmallString("ab")) == 20);
+  assert (*map.find(SmallString("")) == 0);
+  assert (map.find(SmallString("abcd")) == nullptr);
+
+  // Ordered iteration
+  vector<string> keys;
+  map.for_each([&](const SmallString& key, int) {
+    keys.push_back(key.str());
+  });
+  assert (keys == (vector<string>{"", "a", "ab", "abc"}));
+
+  // Early stop
+  size_t visited = 0;
+  map.for_each([&](const SmallString&, int) {
+    return ++visited < 2;
+  });
+  assert (visited == 2);
+
+  assert (map.erase(SmallString("ab")));
+  assert (!map.erase(SmallString("ab")));
+  assert (map.find(SmallString("abc")) != nullptr);
+  assert (map.size() == 3);
+
+  // Every node size, and unsigned byte order
+  ArtMap<int> wide;
+  for (int c = 1; c < 256; ++c) {
+    char key[3] = {'k', static_cast<char>(c), '\0'};
+    wide.insert_or_assign(SmallString(key), c);
+  }
+  int previous = 0;
+  wide.for_each([&](const SmallString&, int value) {
+    assert (value == previous + 1);
+    previous = value;
+  });
+  assert (previous == 255);
+  for (int c = 1; c < 256; c += 2) {
+    char key[3] = {'k', static_cast<char>(c), '\0'};
+    assert (wide.erase(SmallString(key)));
+  }
+  assert (wide.size() == 127);
+  assert (*wide.find(SmallString("k\x80")) == 128);
+
+  // Against std::map, with inserts, overwrites, erases and prefix scans
+  ArtMap<size_t> art;
+  std::map<string, size_t> expected;
+
+  for (size_t step = 0; step < 20000; ++step) {
+    SmallString key = make(step * 7 % 5003);
+
+    if (step % 3 == 2) {
+      assert (art.erase(key) == (expected.erase(key.str()) == 1));
+    }
+    else {
+      bool inserted = expected.insert_or_assign(key.str(), step).second;
+      assert (art.insert_or_assign(key, step) == inserted);
+    }
+    assert (art.size() == expected.size());
+  }
+
+  auto it = expected.begin();
+  art.for_each([&](const SmallString& key, size_t value) {
+    assert (it != expected.end());
+    assert (key.str() == it->first);
+    assert (value == it->second);
+    ++it;
+  });
+  assert (it == expected.end());
+
+  for (const auto& entry : expected) {
+    SmallString key(entry.first.c_str());
+    assert (art.find(key) != nullptr && *art.find(key) == entry.second);
+  }
+
+  const char* prefixes[] = {"", "/", "/usr", "/usr/", "/a/b", "/averyveryverylongdirectoryna", "/averyveryverylongdirectoryname/x", "/nope"};
+  for (const char* prefix : prefixes) {
+    vector<string> found;
+    art.prefix_scan(SmallString(prefix), [&](const SmallString& key, size_t) {
+      found.push_back(key.str());
+    });
+
+    vector<string> wanted;
+    for (auto e = expected.lower_bound(prefix); e != expected.end() && e->first.compare(0, strlen(prefix), prefix) == 0; ++e) {
+      wanted.push_back(e->first);
+    }
+    assert (found == wanted);
+  }
+
+  return 0;
+
+}
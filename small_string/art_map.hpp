@@ -0,0 +1,846 @@
+#ifndef ART_MAP_HPP
+#define ART_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "small_string.hpp"
+
+/*
+ArtMap:
+An ordered map from SmallString to V, as an adaptive radix tree
+(Leis et al., "The Adaptive Radix Tree"). Each inner node branches on
+one byte of the key, and comes in four sizes so that sparse nodes stay
+small:
+  - Node4 and Node16 keep sorted key bytes next to their children
+    (Node16 is searched with one SSE2 compare),
+  - Node48 maps all 256 bytes to one of 48 child slots,
+  - Node256 is a plain array of children.
+
+Path compression: a chain of single-child nodes is collapsed into a
+prefix stored in the node below (only the first MAX_PREFIX bytes are
+kept; lookups skip the rest optimistically and the leaf decides).
+Lazy expansion: a key that's alone in its subtree is just a leaf,
+whatever its remaining bytes are.
+
+Keys may be prefixes of each other ("a" and "ab"), so instead of
+appending a terminator byte each inner node can hold the leaf of the
+key that ends exactly there.
+
+Iteration is in unsigned byte order.
+*/
+
+template <typename V>
+class ArtMap {
+
+  static constexpr size_t MAX_PREFIX = 10;
+
+  enum NodeType : uint8_t { NODE4, NODE16, NODE48, NODE256 };
+
+  struct Leaf {
+    SmallString key;
+    V value;
+  };
+
+  struct Node {
+    NodeType type;
+    uint16_t count;
+    uint32_t prefix_length;
+    unsigned char prefix[MAX_PREFIX];
+    Leaf* terminal;
+
+    explicit Node(NodeType t) : type(t), count(0), prefix_length(0), terminal(nullptr) {}
+  };
+
+  struct Node4 : Node {
+    unsigned char keys[4];
+    Node* children[4];
+    Node4() : Node(NODE4) {}
+  };
+
+  struct Node16 : Node {
+    unsigned char keys[16];
+    Node* children[16];
+    Node16() : Node(NODE16) {}
+  };
+
+  struct Node48 : Node {
+    unsigned char index[256]; // 0 means no child, otherwise slot + 1
+    Node* children[48];
+    Node48() : Node(NODE48) {
+      std::memset(index, 0, sizeof(index));
+      std::memset(children, 0, sizeof(children));
+    }
+  };
+
+  struct Node256 : Node {
+    Node* children[256];
+    Node256() : Node(NODE256) {
+      std::memset(children, 0, sizeof(children));
+    }
+  };
+
+  private:
+  Node* _root;
+  size_t _size;
+
+    // Leaves hide behind child pointers with the lowest bit set.
+    static bool is_leaf(const Node* n) noexcept {
+      return reinterpret_cast<uintptr_t>(n) & 1;
+    }
+
+    static Leaf* as_leaf(const Node* n) noexcept {
+      return reinterpret_cast<Leaf*>(reinterpret_cast<uintptr_t>(n) & ~uintptr_t(1));
+    }
+
+    static Node* tag_leaf(Leaf* leaf) noexcept {
+      return reinterpret_cast<Node*>(reinterpret_cast<uintptr_t>(leaf) | 1);
+    }
+
+    static unsigned char byte_at(const SmallString& key, size_t i) noexcept {
+      return static_cast<unsigned char>(key.at_unchecked(i));
+    }
+
+    static bool same_key(const SmallString& a, const SmallString& b) noexcept {
+      if (a.length() != b.length()) {
+        return false;
+      }
+      for (size_t i = 0; i < a.length(); ++i) {
+        if (a.at_unchecked(i) != b.at_unchecked(i)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // How many leading bytes of prefix the key shares.
+    static size_t common_prefix(const SmallString& key, const SmallString& prefix) noexcept {
+      size_t i = 0;
+      while (i < prefix.length() && i < key.length() && key.at_unchecked(i) == prefix.at_unchecked(i)) {
+        ++i;
+      }
+      return i;
+    }
+
+    static size_t min(size_t a, size_t b) noexcept {
+      return (a < b) ? a : b;
+    }
+
+    // Position of the child for byte c, as a pointer to its slot.
+    static Node** find_child(Node* n, unsigned char c) noexcept {
+      switch (n->type) {
+        case NODE4: {
+          Node4* node = static_cast<Node4*>(n);
+          for (size_t i = 0; i < node->count; ++i) {
+            if (node->keys[i] == c) {
+              return &node->children[i];
+            }
+          }
+          return nullptr;
+        }
+
+        case NODE16: {
+          Node16* node = static_cast<Node16*>(n);
+#if defined(__SSE2__)
+          __m128i keys = _mm_loadu_si128(reinterpret_cast<const __m128i*>(node->keys));
+          int hits = _mm_movemask_epi8(_mm_cmpeq_epi8(keys, _mm_set1_epi8(static_cast<char>(c))));
+          hits &= (1 << node->count) - 1;
+          return (hits != 0) ? &node->children[__builtin_ctz(hits)] : nullptr;
+#else
+          for (size_t i = 0; i < node->count; ++i) {
+            if (node->keys[i] == c) {
+              return &node->children[i];
+            }
+          }
+          return nullptr;
+#endif
+        }
+
+        case NODE48: {
+          Node48* node = static_cast<Node48*>(n);
+          return (node->index[c] != 0) ? &node->children[node->index[c] - 1] : nullptr;
+        }
+
+        default: {
+          Node256* node = static_cast<Node256*>(n);
+          return (node->children[c] != nullptr) ? &node->children[c] : nullptr;
+        }
+      }
+    }
+
+    // Where byte c goes among the sorted keys of a Node4/Node16.
+    static size_t insertion_point(const unsigned char* keys, size_t count, unsigned char c) noexcept {
+#if defined(__SSE2__)
+      if (count > 4) {
+        // Unsigned compare, by flipping the sign bits.
+        const __m128i flip = _mm_set1_epi8(static_cast<char>(0x80));
+        __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(keys)), flip);
+        __m128i key = _mm_xor_si128(_mm_set1_epi8(static_cast<char>(c)), flip);
+        int less = _mm_movemask_epi8(_mm_cmplt_epi8(block, key)) & ((1 << count) - 1);
+        return __builtin_popcount(less);
+      }
+#endif
+      size_t i = 0;
+      while (i < count && keys[i] < c) {
+        ++i;
+      }
+      return i;
+    }
+
+    // Adds child under byte c; n may be replaced by a bigger node, in
+    // which case *ref is updated.
+    static void add_child(Node** ref, Node* n, unsigned char c, Node* child) {
+      switch (n->type) {
+        case NODE4: {
+          Node4* node = static_cast<Node4*>(n);
+          if (node->count < 4) {
+            size_t i = insertion_point(node->keys, node->count, c);
+            std::memmove(node->keys + i + 1, node->keys + i, node->count - i);
+            std::memmove(node->children + i + 1, node->children + i, (node->count - i) * sizeof(Node*));
+            node->keys[i] = c;
+            node->children[i] = child;
+            ++node->count;
+            return;
+          }
+
+          Node16* bigger = new Node16;
+          copy_header(bigger, node);
+          std::memcpy(bigger->keys, node->keys, 4);
+          std::memcpy(bigger->children, node->children, 4 * sizeof(Node*));
+          *ref = bigger;
+          delete node;
+          add_child(ref, bigger, c, child);
+          return;
+        }
+
+        case NODE16: {
+          Node16* node = static_cast<Node16*>(n);
+          if (node->count < 16) {
+            size_t i = insertion_point(node->keys, node->count, c);
+            std::memmove(node->keys + i + 1, node->keys + i, node->count - i);
+            std::memmove(node->children + i + 1, node->children + i, (node->count - i) * sizeof(Node*));
+            node->keys[i] = c;
+            node->children[i] = child;
+            ++node->count;
+            return;
+          }
+
+          Node48* bigger = new Node48;
+          copy_header(bigger, node);
+          for (size_t i = 0; i < 16; ++i) {
+            bigger->children[i] = node->children[i];
+            bigger->index[node->keys[i]] = static_cast<unsigned char>(i + 1);
+          }
+          *ref = bigger;
+          delete node;
+          add_child(ref, bigger, c, child);
+          return;
+        }
+
+        case NODE48: {
+          Node48* node = static_cast<Node48*>(n);
+          if (node->count < 48) {
+            size_t slot = 0;
+            while (node->children[slot] != nullptr) {
+              ++slot;
+            }
+            node->children[slot] = child;
+            node->index[c] = static_cast<unsigned char>(slot + 1);
+            ++node->count;
+            return;
+          }
+
+          Node256* bigger = new Node256;
+          copy_header(bigger, node);
+          for (size_t b = 0; b < 256; ++b) {
+            if (node->index[b] != 0) {
+              bigger->children[b] = node->children[node->index[b] - 1];
+            }
+          }
+          *ref = bigger;
+          delete node;
+          add_child(ref, bigger, c, child);
+          return;
+        }
+
+        default: {
+          Node256* node = static_cast<Node256*>(n);
+          node->children[c] = child;
+          ++node->count;
+          return;
+        }
+      }
+    }
+
+    // Removes the child under byte c, shrinking n (and updating *ref) if
+    // it got too sparse for its size.
+    static void remove_child(Node** ref, Node* n, unsigned char c) {
+      switch (n->type) {
+        case NODE4:
+        case NODE16: {
+          unsigned char* keys = (n->type == NODE4) ? static_cast<Node4*>(n)->keys : static_cast<Node16*>(n)->keys;
+          Node** children = (n->type == NODE4) ? static_cast<Node4*>(n)->children : static_cast<Node16*>(n)->children;
+
+          size_t i = 0;
+          while (keys[i] != c) {
+            ++i;
+          }
+          std::memmove(keys + i, keys + i + 1, n->count - i - 1);
+          std::memmove(children + i, children + i + 1, (n->count - i - 1) * sizeof(Node*));
+          --n->count;
+
+          if (n->type == NODE16 && n->count <= 3) {
+            Node4* smaller = new Node4;
+            copy_header(smaller, n);
+            std::memcpy(smaller->keys, keys, n->count);
+            std::memcpy(smaller->children, children, n->count * sizeof(Node*));
+            *ref = smaller;
+            delete static_cast<Node16*>(n);
+          }
+          break;
+        }
+
+        case NODE48: {
+          Node48* node = static_cast<Node48*>(n);
+          node->children[node->index[c] - 1] = nullptr;
+          node->index[c] = 0;
+          --node->count;
+
+          if (node->count <= 12) {
+            Node16* smaller = new Node16;
+            copy_header(smaller, node);
+            size_t j = 0;
+            for (size_t b = 0; b < 256; ++b) {
+              if (node->index[b] != 0) {
+                smaller->keys[j] = static_cast<unsigned char>(b);
+                smaller->children[j++] = node->children[node->index[b] - 1];
+              }
+            }
+            *ref = smaller;
+            delete node;
+          }
+          break;
+        }
+
+        default: {
+          Node256* node = static_cast<Node256*>(n);
+          node->children[c] = nullptr;
+          --node->count;
+
+          if (node->count <= 37) {
+            Node48* smaller = new Node48;
+            copy_header(smaller, node);
+            size_t j = 0;
+            for (size_t b = 0; b < 256; ++b) {
+              if (node->children[b] != nullptr) {
+                smaller->children[j] = node->children[b];
+                smaller->index[b] = static_cast<unsigned char>(++j);
+              }
+            }
+            *ref = smaller;
+            delete node;
+          }
+          break;
+        }
+      }
+
+      collapse(ref);
+    }
+
+    // A Node4 that's down to a single path is merged into what's below.
+    static void collapse(Node** ref) {
+      Node* n = *ref;
+      if (n->type != NODE4) {
+        return;
+      }
+      Node4* node = static_cast<Node4*>(n);
+
+      if (node->count == 0) {
+        // Only the terminal is left (the caller never leaves nothing).
+        *ref = tag_leaf(node->terminal);
+        delete node;
+        return;
+      }
+
+      if (node->count != 1 || node->terminal != nullptr) {
+        return;
+      }
+
+      Node* child = node->children[0];
+      if (!is_leaf(child)) {
+        // child's prefix becomes ours + the branching byte + its own.
+        size_t stored = node->prefix_length;
+        if (stored < MAX_PREFIX) {
+          node->prefix[stored++] = node->keys[0];
+        }
+        if (stored < MAX_PREFIX) {
+          size_t more = min(child->prefix_length, MAX_PREFIX - stored);
+          std::memcpy(node->prefix + stored, child->prefix, more);
+          stored += more;
+        }
+        std::memcpy(child->prefix, node->prefix, min(stored, MAX_PREFIX));
+        child->prefix_length += node->prefix_length + 1;
+      }
+
+      *ref = child;
+      delete node;
+    }
+
+    static void copy_header(Node* to, const Node* from) noexcept {
+      to->count = from->count;
+      to->prefix_length = from->prefix_length;
+      std::memcpy(to->prefix, from->prefix, MAX_PREFIX);
+      to->terminal = from->terminal;
+    }
+
+    // The smallest leaf under n (the terminal, if any, sorts first).
+    static Leaf* minimum(const Node* n) noexcept {
+      while (!is_leaf(n)) {
+        if (n->terminal != nullptr) {
+          return n->terminal;
+        }
+
+        switch (n->type) {
+          case NODE4:
+            n = static_cast<const Node4*>(n)->children[0];
+            break;
+          case NODE16:
+            n = static_cast<const Node16*>(n)->children[0];
+            break;
+          case NODE48: {
+            const Node48* node = static_cast<const Node48*>(n);
+            size_t b = 0;
+            while (node->index[b] == 0) {
+              ++b;
+            }
+            n = node->children[node->index[b] - 1];
+            break;
+          }
+          default: {
+            const Node256* node = static_cast<const Node256*>(n);
+            size_t b = 0;
+            while (node->children[b] == nullptr) {
+              ++b;
+            }
+            n = node->children[b];
+            break;
+          }
+        }
+      }
+      return as_leaf(n);
+    }
+
+    // Optimistic: only compares the stored prefix bytes.
+    static bool stored_prefix_matches(const Node* n, const SmallString& key, size_t depth) noexcept {
+      size_t compared = min(min(n->prefix_length, MAX_PREFIX), key.length() - depth);
+      for (size_t i = 0; i < compared; ++i) {
+        if (n->prefix[i] != byte_at(key, depth + i)) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    // Pessimistic: how many bytes of the (full) prefix match key from
+    // depth on. Bytes past MAX_PREFIX are read from the minimum leaf.
+    static size_t prefix_mismatch(const Node* n, const SmallString& key, size_t depth) noexcept {
+      size_t limit = min(n->prefix_length, key.length() - depth);
+      size_t i = 0;
+
+      for (; i < min(limit, MAX_PREFIX); ++i) {
+        if (n->prefix[i] != byte_at(key, depth + i)) {
+          return i;
+        }
+      }
+
+      if (i < limit) {
+        const SmallString& full = minimum(n)->key;
+        for (; i < limit; ++i) {
+          if (byte_at(full, depth + i) != byte_at(key, depth + i)) {
+            return i;
+          }
+        }
+      }
+
+      return i;
+    }
+
+    static void set_prefix(Node* n, const SmallString& key, size_t depth, size_t length) noexcept {
+      n->prefix_length = static_cast<uint32_t>(length);
+      for (size_t i = 0; i < min(length, MAX_PREFIX); ++i) {
+        n->prefix[i] = byte_at(key, depth + i);
+      }
+    }
+
+    // Hangs leaf under n: as its terminal if the key ends at depth,
+    // otherwise under the key's byte at depth.
+    static void attach(Node** ref, Node* n, Leaf* leaf, size_t depth) {
+      if (leaf->key.length() == depth) {
+        n->terminal = leaf;
+      }
+      else {
+        add_child(ref, n, byte_at(leaf->key, depth), tag_leaf(leaf));
+      }
+    }
+
+    // Returns true if the key is new.
+    bool insert(Node** ref, const SmallString& key, size_t depth, V&& value) {
+      Node* n = *ref;
+
+      if (n == nullptr) {
+        *ref = tag_leaf(new Leaf{key, std::move(value)});
+        return true;
+      }
+
+      if (is_leaf(n)) {
+        Leaf* existing = as_leaf(n);
+        if (same_key(existing->key, key)) {
+          existing->value = std::move(value);
+          return false;
+        }
+
+        // Lazy expansion ends here: both keys go under a new Node4 that
+        // holds whatever they have in common.
+        size_t common = 0;
+        size_t limit = min(existing->key.length(), key.length()) - depth;
+        while (common < limit && byte_at(existing->key, depth + common) == byte_at(key, depth + common)) {
+          ++common;
+        }
+
+        Leaf* leaf = new Leaf{key, std::move(value)};
+        Node4* split = new Node4;
+        set_prefix(split, key, depth, common);
+        *ref = split;
+
+        attach(ref, split, existing, depth + common);
+        attach(ref, split, leaf, depth + common);
+        return true;
+      }
+
+      if (n->prefix_length != 0) {
+        size_t matched = prefix_mismatch(n, key, depth);
+
+        if (matched < n->prefix_length) {
+          // The key leaves the compressed path halfway: split the prefix.
+          Node4* split = new Node4;
+          set_prefix(split, key, depth, matched);
+          *ref = split;
+
+          unsigned char branch;
+          if (n->prefix_length <= MAX_PREFIX) {
+            branch = n->prefix[matched];
+            n->prefix_length -= static_cast<uint32_t>(matched + 1);
+            std::memmove(n->prefix, n->prefix + matched + 1, min(n->prefix_length, MAX_PREFIX));
+          }
+          else {
+            const SmallString& full = minimum(n)->key;
+            branch = byte_at(full, depth + matched);
+            n->prefix_length -= static_cast<uint32_t>(matched + 1);
+            for (size_t i = 0; i < min(n->prefix_length, MAX_PREFIX); ++i) {
+              n->prefix[i] = byte_at(full, depth + matched + 1 + i);
+            }
+          }
+
+          add_child(ref, split, branch, n);
+          attach(ref, split, new Leaf{key, std::move(value)}, depth + matched);
+          return true;
+        }
+
+        depth += n->prefix_length;
+      }
+
+      if (depth == key.length()) {
+        if (n->terminal != nullptr) {
+          n->terminal->value = std::move(value);
+          return false;
+        }
+        n->terminal = new Leaf{key, std::move(value)};
+        return true;
+      }
+
+      Node** child = find_child(n, byte_at(key, depth));
+      if (child != nullptr) {
+        return insert(child, key, depth + 1, std::move(value));
+      }
+
+      add_child(ref, n, byte_at(key, depth), tag_leaf(new Leaf{key, std::move(value)}));
+      return true;
+    }
+
+    // Returns true if the key was there.
+    bool erase(Node** ref, const SmallString& key, size_t depth) {
+      Node* n = *ref;
+
+      if (n == nullptr) {
+        return false;
+      }
+
+      if (is_leaf(n)) {
+        Leaf* leaf = as_leaf(n);
+        if (!same_key(leaf->key, key)) {
+          return false;
+        }
+        delete leaf;
+        *ref = nullptr;
+        return true;
+      }
+
+      if (n->prefix_length != 0) {
+        if (depth + n->prefix_length > key.length() || !stored_prefix_matches(n, key, depth)) {
+          return false;
+        }
+        depth += n->prefix_length;
+      }
+
+      if (depth == key.length()) {
+        if (n->terminal == nullptr || !same_key(n->terminal->key, key)) {
+          return false;
+        }
+        delete n->terminal;
+        n->terminal = nullptr;
+        collapse(ref);
+        return true;
+      }
+
+      unsigned char c = byte_at(key, depth);
+      Node** child = find_child(n, c);
+      if (child == nullptr) {
+        return false;
+      }
+
+      if (is_leaf(*child)) {
+        Leaf* leaf = as_leaf(*child);
+        if (!same_key(leaf->key, key)) {
+          return false;
+        }
+        delete leaf;
+        remove_child(ref, n, c);
+        return true;
+      }
+
+      return erase(child, key, depth + 1);
+    }
+
+    static void destroy(Node* n) noexcept {
+      if (n == nullptr) {
+        return;
+      }
+      if (is_leaf(n)) {
+        delete as_leaf(n);
+        return;
+      }
+
+      delete n->terminal;
+      switch (n->type) {
+        case NODE4:
+          for (size_t i = 0; i < n->count; ++i) {
+            destroy(static_cast<Node4*>(n)->children[i]);
+          }
+          delete static_cast<Node4*>(n);
+          break;
+        case NODE16:
+          for (size_t i = 0; i < n->count; ++i) {
+            destroy(static_cast<Node16*>(n)->children[i]);
+          }
+          delete static_cast<Node16*>(n);
+          break;
+        case NODE48:
+          for (Node* child : static_cast<Node48*>(n)->children) {
+            destroy(child);
+          }
+          delete static_cast<Node48*>(n);
+          break;
+        default:
+          for (Node* child : static_cast<Node256*>(n)->children) {
+            destroy(child);
+          }
+          delete static_cast<Node256*>(n);
+          break;
+      }
+    }
+
+    // Visits every leaf under n in order; stops when f returns false.
+    template <typename F>
+    static bool visit(const Node* n, F& f) {
+      if (is_leaf(n)) {
+        const Leaf* leaf = as_leaf(n);
+        return f(leaf->key, leaf->value);
+      }
+
+      if (n->terminal != nullptr && !f(n->terminal->key, n->terminal->value)) {
+        return false;
+      }
+
+      switch (n->type) {
+        case NODE4:
+          for (size_t i = 0; i < n->count; ++i) {
+            if (!visit(static_cast<const Node4*>(n)->children[i], f)) {
+              return false;
+            }
+          }
+          return true;
+        case NODE16:
+          for (size_t i = 0; i < n->count; ++i) {
+            if (!visit(static_cast<const Node16*>(n)->children[i], f)) {
+              return false;
+            }
+          }
+          return true;
+        case NODE48: {
+          const Node48* node = static_cast<const Node48*>(n);
+          for (size_t b = 0; b < 256; ++b) {
+            if (node->index[b] != 0 && !visit(node->children[node->index[b] - 1], f)) {
+              return false;
+            }
+          }
+          return true;
+        }
+        default: {
+          const Node256* node = static_cast<const Node256*>(n);
+          for (size_t b = 0; b < 256; ++b) {
+            if (node->children[b] != nullptr && !visit(node->children[b], f)) {
+              return false;
+            }
+          }
+          return true;
+        }
+      }
+    }
+
+    // Calls f(key, value) and keeps going, whatever f returns.
+    template <typename F>
+    static auto keep_going(F& f) {
+      return [&f](const SmallString& key, const V& value) {
+        if constexpr (std::is_same_v<decltype(f(key, value)), bool>) {
+          return f(key, value);
+        }
+        else {
+          f(key, value);
+          return true;
+        }
+      };
+    }
+
+  public:
+  ArtMap() noexcept : _root(nullptr), _size(0) {}
+
+  ~ArtMap() noexcept {
+    destroy(_root);
+    _root = nullptr;
+  }
+
+  // Nodes are raw pointers: copying would mean double deletes.
+  ArtMap(const ArtMap&) = delete;
+  ArtMap& operator=(const ArtMap&) = delete;
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  // Returns true if the key is new (otherwise, its value is replaced).
+  bool insert_or_assign(const SmallString& key, V value) {
+    bool inserted = insert(&_root, key, 0, std::move(value));
+    _size += inserted;
+    return inserted;
+  }
+
+  bool erase(const SmallString& key) {
+    bool erased = erase(&_root, key, 0);
+    _size -= erased;
+    return erased;
+  }
+
+  V* find(const SmallString& key) noexcept {
+    Node* n = _root;
+    size_t depth = 0;
+
+    while (n != nullptr) {
+      if (is_leaf(n)) {
+        Leaf* leaf = as_leaf(n);
+        return same_key(leaf->key, key) ? &leaf->value : nullptr;
+      }
+
+      if (n->prefix_length != 0) {
+        if (depth + n->prefix_length > key.length() || !stored_prefix_matches(n, key, depth)) {
+          return nullptr;
+        }
+        depth += n->prefix_length;
+      }
+
+      if (depth == key.length()) {
+        Leaf* leaf = n->terminal;
+        return (leaf != nullptr && same_key(leaf->key, key)) ? &leaf->value : nullptr;
+      }
+
+      Node** child = find_child(n, byte_at(key, depth));
+      n = (child != nullptr) ? *child : nullptr;
+      ++depth;
+    }
+
+    return nullptr;
+  }
+
+  const V* find(const SmallString& key) const noexcept {
+    return const_cast<ArtMap*>(this)->find(key);
+  }
+
+  // Calls f(key, value) for every entry, in order. If f returns bool,
+  // returning false stops the walk.
+  template <typename F>
+  void for_each(F f) const {
+    if (_root != nullptr) {
+      auto visitor = keep_going(f);
+      visit(_root, visitor);
+    }
+  }
+
+  // Like for_each, but only for the keys that start with prefix.
+  template <typename F>
+  void prefix_scan(const SmallString& prefix, F f) const {
+    auto visitor = keep_going(f);
+    const Node* n = _root;
+    size_t depth = 0;
+    size_t length = prefix.length();
+
+    while (n != nullptr) {
+      if (is_leaf(n)) {
+        const Leaf* leaf = as_leaf(n);
+        if (common_prefix(leaf->key, prefix) == length) {
+          visitor(leaf->key, leaf->value);
+        }
+        return;
+      }
+
+      if (n->prefix_length != 0) {
+        size_t wanted = min(n->prefix_length, length - depth);
+        if (prefix_mismatch(n, prefix, depth) < wanted) {
+          return;
+        }
+        if (depth + n->prefix_length >= length) {
+          visit(n, visitor);
+          return;
+        }
+        depth += n->prefix_length;
+      }
+
+      if (depth == length) {
+        visit(n, visitor);
+        return;
+      }
+
+      Node** child = find_child(const_cast<Node*>(n), byte_at(prefix, depth));
+      n = (child != nullptr) ? *child : nullptr;
+      ++depth;
+    }
+  }
+
+};
+
+#endif
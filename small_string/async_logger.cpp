@@ -0,0 +1,140 @@
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "async_logger.hpp"
+
+using namespace std;
+
+static vector<string> lines_of(const string& text) {
+  vector<string> lines;
+  istringstream in(text);
+  string line;
+  while (getline(in, line)) {
+    lines.push_back(line);
+  }
+  return lines;
+}
+
+// TESTS
+
+int main() {
+
+  // Formatting
+  assert (format_line("GET ", string_view("/index"), ' ', 200, ' ', -17, ' ', size_t(42)).str() ==
+          "GET /index 200 -17 42");
+  SmallString path("/a/path/long/enough/to/spill/the/buffer");
+  assert (format_line("path=", path).str() == "path=/a/path/long/enough/to/spill/the/buffer");
+  assert (format_line().length() == 0);
+
+  char name[] = "/tmp/async_logger_testXXXXXX";
+  int fd = mkstemp(name);
+  assert (fd >= 0);
+
+  // Many threads, short and long lines: everything arrives, each
+  // thread's lines in order
+  const size_t THREADS = 4;
+  const size_t LINES = 5000;
+  {
+    AsyncLogger logger(fd, 256);
+
+    vector<thread> threads;
+    for (size_t t = 0; t < THREADS; ++t) {
+      threads.emplace_back([&, t]() {
+        AsyncLogger::Producer producer = logger.producer();
+        for (size_t i = 0; i < LINES;) {
+          bool logged = (i % 5 == 0) ? producer.log("thread ", t, " line ", i, " which is long enough to spill")
+                                     : producer.log(t, ":", i);
+          if (logged) {
+            ++i;
+          }
+          else {
+            this_thread::yield();
+          }
+        }
+      });
+    }
+    for (thread& t : threads) {
+      t.join();
+    }
+
+    // flush() sees lines from producers that are already gone
+    AsyncLogger::Producer last = logger.producer();
+    SmallString line("the last line");
+    assert (last.log(std::move(line)) && line.length() == 0);
+    logger.flush();
+    assert (logger.written() == THREADS * LINES + 1);
+    assert (logger.error() == 0);
+  }
+  close(fd);
+
+  {
+    ifstream in(name);
+    stringstream text;
+    text << in.rdbuf();
+    vector<string> lines = lines_of(text.str());
+    assert (lines.size() == THREADS * LINES + 1);
+    assert (lines.back() == "the last line");
+
+    vector<size_t> next(THREADS, 0);
+    for (size_t k = 0; k + 1 < lines.size(); ++k) {
+      const string& line = lines[k];
+      size_t t = (line.rfind("thread ", 0) == 0) ? line[7] - '0' : line[0] - '0';
+      size_t i = next[t]++;
+      string expected = (i % 5 == 0) ? "thread " + to_string(t) + " line " + to_string(i) + " which is long enough to spill"
+                                     : to_string(t) + ":" + to_string(i);
+      assert (line == expected);
+    }
+  }
+  remove(name);
+
+  // A stuck writer: rings fill up and lines are dropped, not waited on
+  {
+    int pipe_fds[2];
+    assert (pipe(pipe_fds) == 0);
+    string received;
+    uint64_t dropped = 0;
+    size_t logged = 0;
+
+    {
+      AsyncLogger logger(pipe_fds[1], 16);
+      AsyncLogger::Producer producer = logger.producer();
+      // Nobody reads the pipe yet, so the writer blocks once it's full
+      for (size_t i = 0; dropped == 0; ++i) {
+        if (producer.log("a line that goes into the pipe, number ", i)) {
+          ++logged;
+        }
+        else {
+          ++dropped;
+        }
+      }
+      assert (logger.dropped() == dropped);
+
+      thread reader([&]() {
+        char buffer[4096];
+        ssize_t n;
+        while ((n = read(pipe_fds[0], buffer, sizeof(buffer))) > 0) {
+          received.append(buffer, static_cast<size_t>(n));
+        }
+      });
+      logger.flush();
+      assert (logger.written() == logged);
+      close(pipe_fds[1]);
+      reader.join();
+    }
+    close(pipe_fds[0]);
+    assert (lines_of(received).size() == logged);
+  }
+
+  return 0;
+
+}
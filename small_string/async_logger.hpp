@@ -0,0 +1,320 @@
+#ifndef ASYNC_LOGGER_HPP
+#define ASYNC_LOGGER_HPP
+
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include "ring_buffer.hpp"
+#include "small_string.hpp"
+
+/*
+AsyncLogger:
+Hot threads hand lines over and go on; one background thread writes
+them out.
+
+Every thread that logs gets a Producer, which owns an SpscRing of its
+own, so a log call is a relocation into a ring slot and one release
+store: no lock, no allocation (for lines under BUFFER_LIMIT, which also
+format without allocating), no system call. If the ring is full the
+line is dropped and counted, so the hot path stays bounded.
+
+The background thread goes round the rings, pops lines in batches and
+writes them with writev: one iovec per segment of each line plus one
+for the newline, up to IOV_MAX at a time. Lines are freed there too, so
+a spilled line's Fallback goes back on the background thread. When a
+pass finds nothing it sleeps for IDLE.
+
+flush() waits until everything logged before it was written. Producers
+must be gone before their logger.
+
+format_line builds a line from strings and integers straight into a
+SmallString.
+*/
+
+namespace logger_detail {
+
+  inline void append_part(SmallString& line, std::string_view part) {
+    line.append(part.data(), part.size());
+  }
+
+  inline void append_part(SmallString& line, const char* part) {
+    line.append(part);
+  }
+
+  inline void append_part(SmallString& line, const SmallString& part) {
+    line.append(part.inline_data(), part.inline_length());
+    line.append(part.spilled_data(), part.spilled_length());
+  }
+
+  inline void append_part(SmallString& line, char part) {
+    line.append(&part, 1);
+  }
+
+  template <typename T, typename = std::enable_if_t<std::is_integral<T>::value>>
+  void append_part(SmallString& line, T part) {
+    char digits[24];
+    std::to_chars_result result = std::to_chars(digits, digits + sizeof(digits), part);
+    line.append(digits, static_cast<size_t>(result.ptr - digits));
+  }
+
+}
+
+template <typename... Parts>
+SmallString format_line(const Parts&... parts) {
+  SmallString line;
+  (logger_detail::append_part(line, parts), ...);
+  return line;
+}
+
+class AsyncLogger {
+
+  static constexpr size_t BATCH = 64;
+  static constexpr std::chrono::microseconds IDLE{500};
+
+  struct Channel {
+    SpscRing ring;
+    std::atomic<bool> closed{false};
+    std::atomic<uint64_t> dropped{0};
+
+    explicit Channel(size_t capacity) : ring(capacity) {}
+  };
+
+  private:
+  int _fd;
+  size_t _ring_capacity;
+  std::mutex _lock;
+  std::condition_variable _flushed_signal;
+  std::vector<std::unique_ptr<Channel>> _channels;
+  uint64_t _flush_requested;
+  uint64_t _flush_done;
+  std::atomic<bool> _stopping;
+  std::atomic<uint64_t> _written;
+  std::atomic<uint64_t> _dropped; // By producers that are gone.
+  std::atomic<int> _error;
+  std::thread _writer;
+
+    // Writes all of iov (writev may stop short). Errors are remembered,
+    // and the lines dropped.
+    void write_all(std::vector<iovec>& iov) noexcept {
+      size_t first = 0;
+      while (first < iov.size()) {
+        ssize_t n = ::writev(_fd, iov.data() + first, static_cast<int>(iov.size() - first));
+        if (n < 0) {
+          if (errno == EINTR) {
+            continue;
+          }
+          _error.store(errno, std::memory_order_relaxed);
+          break;
+        }
+
+        size_t left = static_cast<size_t>(n);
+        while (first < iov.size() && left >= iov[first].iov_len) {
+          left -= iov[first].iov_len;
+          ++first;
+        }
+        if (left != 0) {
+          iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+          iov[first].iov_len -= left;
+        }
+      }
+      iov.clear();
+    }
+
+    // Empties one channel; true if it had anything.
+    bool drain(Channel& channel, std::vector<SmallString>& lines, std::vector<iovec>& iov) {
+      static char newline = '\n';
+      bool any = false;
+
+      while (true) {
+        size_t n = channel.ring.pop_batch(std::span<SmallString>(lines));
+        if (n == 0) {
+          return any;
+        }
+        any = true;
+
+        for (size_t i = 0; i < n; ++i) {
+          if (iov.size() + 3 > IOV_MAX) {
+            write_all(iov);
+          }
+          const SmallString& line = lines[i];
+          iov.push_back(iovec{const_cast<char*>(line.inline_data()), line.inline_length()});
+          if (line.spilled_length() != 0) {
+            iov.push_back(iovec{const_cast<char*>(line.spilled_data()), line.spilled_length()});
+          }
+          iov.push_back(iovec{&newline, 1});
+        }
+        write_all(iov);
+        _written.fetch_add(n, std::memory_order_relaxed);
+
+        for (size_t i = 0; i < n; ++i) {
+          lines[i].empty();
+        }
+      }
+    }
+
+    void run() {
+      std::vector<SmallString> lines(BATCH);
+      std::vector<iovec> iov;
+      std::vector<Channel*> channels;
+
+      while (true) {
+        uint64_t flush_target;
+        bool stopping = _stopping.load(std::memory_order_acquire);
+        {
+          std::lock_guard<std::mutex> guard(_lock);
+          flush_target = _flush_requested;
+
+          // Closed channels go once they're drained: nothing more can come.
+          size_t kept = 0;
+          for (size_t i = 0; i < _channels.size(); ++i) {
+            Channel& channel = *_channels[i];
+            if (channel.closed.load(std::memory_order_acquire) && channel.ring.size() == 0) {
+              _dropped.fetch_add(channel.dropped.load(std::memory_order_relaxed), std::memory_order_relaxed);
+              _channels[i].reset();
+              continue;
+            }
+            if (kept != i) {
+              _channels[kept] = std::move(_channels[i]);
+            }
+            ++kept;
+          }
+          _channels.resize(kept);
+
+          channels.clear();
+          for (const std::unique_ptr<Channel>& channel : _channels) {
+            channels.push_back(channel.get());
+          }
+        }
+
+        bool any = false;
+        for (Channel* channel : channels) {
+          any = drain(*channel, lines, iov) || any;
+        }
+
+        {
+          std::lock_guard<std::mutex> guard(_lock);
+          _flush_done = flush_target;
+        }
+        _flushed_signal.notify_all();
+
+        if (stopping) {
+          return;
+        }
+        if (!any) {
+          std::this_thread::sleep_for(IDLE);
+        }
+      }
+    }
+
+  public:
+  // One per logging thread; not to be shared between threads.
+  class Producer {
+
+    friend class AsyncLogger;
+
+    private:
+    Channel* _channel;
+
+    explicit Producer(Channel* channel) noexcept : _channel(channel) {}
+
+    public:
+    Producer(Producer&& other) noexcept : _channel(other._channel) {
+      other._channel = nullptr;
+    }
+
+    Producer(const Producer&) = delete;
+    Producer& operator=(const Producer&) = delete;
+    Producer& operator=(Producer&&) = delete;
+
+    ~Producer() noexcept {
+      if (_channel != nullptr) {
+        _channel->closed.store(true, std::memory_order_release);
+      }
+    }
+
+    // Hands the line over (without its newline), leaving it empty. False
+    // if the ring was full and it was dropped.
+    bool log(SmallString&& line) noexcept {
+      if (_channel->ring.try_push(std::move(line))) {
+        return true;
+      }
+      _channel->dropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    template <typename... Parts>
+    bool log(const Parts&... parts) {
+      return log(format_line(parts...));
+    }
+
+  };
+
+  // The logger doesn't own fd. ring_capacity is per producer.
+  explicit AsyncLogger(int fd, size_t ring_capacity = 4096)
+    : _fd(fd), _ring_capacity(ring_capacity), _flush_requested(0), _flush_done(0), _stopping(false), _written(0),
+      _dropped(0), _error(0) {
+    _writer = std::thread(&AsyncLogger::run, this);
+  }
+
+  AsyncLogger(const AsyncLogger&) = delete;
+  AsyncLogger& operator=(const AsyncLogger&) = delete;
+
+  // Writes whatever is left, then stops.
+  ~AsyncLogger() noexcept {
+    _stopping.store(true, std::memory_order_release);
+    _writer.join();
+  }
+
+  Producer producer() {
+    std::lock_guard<std::mutex> guard(_lock);
+    _channels.push_back(std::make_unique<Channel>(_ring_capacity));
+    return Producer(_channels.back().get());
+  }
+
+  // Waits until every line logged before the call has been written.
+  void flush() {
+    std::unique_lock<std::mutex> guard(_lock);
+    uint64_t target = ++_flush_requested;
+    _flushed_signal.wait(guard, [&]() {
+      return _flush_done >= target;
+    });
+  }
+
+  uint64_t written() const noexcept {
+    return _written.load(std::memory_order_relaxed);
+  }
+
+  // Lines dropped because a ring was full.
+  uint64_t dropped() {
+    std::lock_guard<std::mutex> guard(_lock);
+    uint64_t total = _dropped.load(std::memory_order_relaxed);
+    for (const std::unique_ptr<Channel>& channel : _channels) {
+      total += channel->dropped.load(std::memory_order_relaxed);
+    }
+    return total;
+  }
+
+  // The last errno from writev, or 0.
+  int error() const noexcept {
+    return _error.load(std::memory_order_relaxed);
+  }
+
+};
+
+#endif
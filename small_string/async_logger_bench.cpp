@@ -0,0 +1,105 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "async_logger.hpp"
+
+using namespace std;
+
+/*
+The cost a hot thread pays per log line, at 1 to 8 threads logging to
+/dev/null: AsyncLogger (formatting into a SmallString, then a ring push)
+vs formatting into a std::string and writing it under a mutex. Lines
+are about 20 bytes, so under BUFFER_LIMIT. Every 16th call is timed on
+its own for the median and 99th percentile; the mean is over all calls.
+*/
+
+static const size_t LINES = 200000;
+
+struct Result {
+  double mean_ns;
+  double p50_ns;
+  double p99_ns;
+};
+
+template <typename F>
+static Result run(size_t threads, F make_worker) {
+  vector<vector<double>> samples(threads);
+  vector<double> means(threads);
+  vector<thread> workers;
+
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      auto log = make_worker();
+      auto start = chrono::steady_clock::now();
+      for (size_t i = 0; i < LINES; ++i) {
+        if (i % 16 == 0) {
+          auto before = chrono::steady_clock::now();
+          log(t, i);
+          samples[t].push_back(chrono::duration<double, nano>(chrono::steady_clock::now() - before).count());
+        }
+        else {
+          log(t, i);
+        }
+      }
+      means[t] = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count() / LINES;
+    });
+  }
+  for (thread& worker : workers) {
+    worker.join();
+  }
+
+  vector<double> all;
+  double mean = 0;
+  for (size_t t = 0; t < threads; ++t) {
+    all.insert(all.end(), samples[t].begin(), samples[t].end());
+    mean += means[t] / threads;
+  }
+  sort(all.begin(), all.end());
+  return Result{mean, all[all.size() / 2], all[all.size() * 99 / 100]};
+}
+
+int main() {
+
+  int fd = open("/dev/null", O_WRONLY);
+
+  for (size_t threads = 1; threads <= 8; threads *= 2) {
+    Result async_result;
+    uint64_t dropped;
+    {
+      AsyncLogger logger(fd, 1 << 14);
+      async_result = run(threads, [&]() {
+        return [producer = make_shared<AsyncLogger::Producer>(logger.producer())](size_t t, size_t i) {
+          producer->log("req ", i, " t", t, " ok");
+        };
+      });
+      logger.flush();
+      dropped = logger.dropped();
+    }
+
+    mutex lock;
+    Result sync_result = run(threads, [&]() {
+      return [&](size_t t, size_t i) {
+        string line = "req " + to_string(i) + " t" + to_string(t) + " ok\n";
+        lock_guard<mutex> guard(lock);
+        ssize_t n = write(fd, line.data(), line.size());
+        (void) n;
+      };
+    });
+
+    cout << threads << " threads: AsyncLogger " << async_result.mean_ns << " ns mean, " << async_result.p50_ns
+         << " p50, " << async_result.p99_ns << " p99 (" << dropped << " dropped); string + mutex + write "
+         << sync_result.mean_ns << " ns mean, " << sync_result.p50_ns << " p50, " << sync_result.p99_ns << " p99"
+         << endl;
+  }
+
+  close(fd);
+  return 0;
+}
@@ -0,0 +1,154 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+
+#include "batch_filter.hpp"
+
+using namespace std;
+
+// The slow way: one operator[] per char.
+static bool reference(const SmallString& row, const char* needle, size_t n, Predicate pred) {
+  size_t length = row.length();
+  if (n > length) {
+    return false;
+  }
+
+  size_t first = 0;
+  size_t last = length - n;
+
+  switch (pred) {
+    case Predicate::EQUALS:
+      if (length != n) {
+        return false;
+      }
+      last = 0;
+      break;
+    case Predicate::STARTS_WITH:
+      last = 0;
+      break;
+    case Predicate::ENDS_WITH:
+      first = last;
+      break;
+    default:
+      break;
+  }
+
+  for (size_t start = first; start <= last; ++start) {
+    bool hit = true;
+    for (size_t i = 0; i < n && hit; ++i) {
+      hit = (row[start + i] == needle[i]);
+    }
+    if (hit) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+// TESTS
+
+int main() {
+
+  // Bitmap
+  Bitmap bits(130);
+  bits.set(0);
+  bits.set(64);
+  bits.set(129);
+  assert (bits.count() == 3);
+  assert (bits.test(64) && !bits.test(65));
+  assert (bits.to_indices() == (vector<size_t>{0, 64, 129}));
+
+  // Searching inside a SmallString
+  SmallString long_one("0123456789abcdefghijklmnopqrstuvwxyz");
+  assert (find_in(long_one, "abc", 3) == 10);
+  assert (find_in(long_one, "klmnop", 6) == 20); // Straddles both segments
+  assert (find_in(long_one, "xyz", 3) == 33);
+  assert (find_in(long_one, "xyz!", 4) == NOT_FOUND);
+  assert (matches_at(long_one, 18, "ijklmn", 6));
+
+  // A small column
+  vector<SmallString> column;
+  column.push_back(SmallString("GET"));
+  column.push_back(SmallString("POST"));
+  column.push_back(SmallString("GET /index.html HTTP/1.1"));
+  column.push_back(SmallString(""));
+  column.push_back(SmallString("GET"));
+
+  Bitmap equal = batch_filter(column, "GET", Predicate::EQUALS);
+  assert (equal.to_indices() == (vector<size_t>{0, 4}));
+
+  Bitmap starts = batch_filter(column, "GET", Predicate::STARTS_WITH);
+  assert (starts.to_indices() == (vector<size_t>{0, 2, 4}));
+
+  Bitmap ends = batch_filter(column, "HTTP/1.1", Predicate::ENDS_WITH);
+  assert (ends.to_indices() == (vector<size_t>{2}));
+
+  Bitmap contains = batch_filter(column, "index", Predicate::CONTAINS);
+  assert (contains.to_indices() == (vector<size_t>{2}));
+
+  Bitmap empty_needle = batch_filter(column, "", Predicate::EQUALS);
+  assert (empty_needle.to_indices() == (vector<size_t>{3}));
+
+  // Needles longer than the buffer
+  SmallString needle("GET /index.html HTTP/1.1");
+  assert (batch_filter(column, needle, Predicate::EQUALS).to_indices() == (vector<size_t>{2}));
+
+  // Against the slow way, over every length around BUFFER_LIMIT
+  // and more rows than fit in one block.
+  const char* alphabet = "abab";
+  vector<SmallString> rows;
+  for (size_t length = 0; length < 40; ++length) {
+    for (size_t shift = 0; shift < 4; ++shift) {
+      SmallString row;
+      for (size_t i = 0; i < length; ++i) {
+        char c = alphabet[(i * 7 + shift + i / 5) % 4];
+        row.append(c == 'a' ? "a" : "b");
+      }
+      rows.push_back(row);
+    }
+  }
+
+  const char* needles[] = {"", "a", "ab", "abba", "babab", "aaaaaaaaaaaaaaaaaaaaaaaa", "abbabbabababbbaababab"};
+  Predicate preds[] = {Predicate::EQUALS, Predicate::STARTS_WITH, Predicate::ENDS_WITH, Predicate::CONTAINS};
+
+  for (const char* n : needles) {
+    for (Predicate pred : preds) {
+      Bitmap got = batch_filter(rows, n, pred);
+      for (size_t r = 0; r < rows.size(); ++r) {
+        assert (got.test(r) == reference(rows[r], n, strlen(n), pred));
+      }
+    }
+  }
+
+  // Every row against itself
+  for (size_t r = 0; r < rows.size(); ++r) {
+    assert (batch_filter(rows, rows[r], Predicate::EQUALS).test(r));
+  }
+
+  // Needles of 4 GiB and up: no real rows that long, so the lengths are
+  // stubbed. Saturated to 32 bits, they would all look alike.
+  const size_t GiB = size_t(1) << 30;
+  size_t huge = 5 * GiB;
+  size_t lengths[] = {0, 7, 0xFFFFFFFFu, 4 * GiB, huge - 1, huge, huge + 1, 8 * GiB, 5, huge};
+  size_t count = sizeof(lengths) / sizeof(lengths[0]);
+
+  for (size_t n : {huge, size_t(0xFFFFFFFFu), 4 * GiB, size_t(0xFFFFFFFEu)}) {
+    uint64_t equal_mask = length_mask(lengths, count, n, false);
+    uint64_t at_least_mask = length_mask(lengths, count, n, true);
+    for (size_t i = 0; i < count; ++i) {
+      assert (((equal_mask >> i) & 1) == (lengths[i] == n));
+      assert (((at_least_mask >> i) & 1) == (lengths[i] >= n));
+    }
+  }
+
+  // And on real rows, whatever the predicate, nothing gets compared past
+  // the needle's first BUFFER_LIMIT bytes (all that's really there)
+  char prefix[BUFFER_LIMIT] = {};
+  for (Predicate pred : preds) {
+    assert (batch_filter(rows, prefix, huge, pred).count() == 0);
+  }
+
+  return 0;
+
+}
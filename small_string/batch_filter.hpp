@@ -0,0 +1,349 @@
+#ifndef BATCH_FILTER_HPP
+#define BATCH_FILTER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "small_string.hpp"
+
+/*
+Batch filters:
+Instead of calling operator== on every row (one char at a time, and
+with a bounds check per char!), we evaluate a predicate over a whole
+column of SmallStrings at once:
+  1. The lengths are checked first, four rows per SSE2 compare.
+  2. Survivors compare their inline bytes against the needle as
+     16-byte vectors.
+  3. Only rows that survive both get to touch their Fallback.
+*/
+
+const size_t NOT_FOUND = static_cast<size_t>(-1);
+
+// One bit per row; bit i is set if row i was selected.
+struct Bitmap {
+  std::vector<uint64_t> words;
+  size_t size;
+
+  explicit Bitmap(size_t n = 0) : words((n + 63) / 64, 0), size(n) {}
+
+  void set(size_t i) noexcept {
+    words[i / 64] |= uint64_t(1) << (i % 64);
+  }
+
+  bool test(size_t i) const noexcept {
+    return (words[i / 64] >> (i % 64)) & 1;
+  }
+
+  size_t count() const noexcept {
+    size_t total = 0;
+    for (uint64_t w : words) {
+      total += __builtin_popcountll(w);
+    }
+    return total;
+  }
+
+  // The selection vector: indices of the selected rows, in order.
+  std::vector<size_t> to_indices() const {
+    std::vector<size_t> indices;
+    indices.reserve(count());
+
+    for (size_t w = 0; w < words.size(); ++w) {
+      uint64_t bits = words[w];
+      while (bits != 0) {
+        indices.push_back(w * 64 + __builtin_ctzll(bits));
+        bits &= bits - 1;
+      }
+    }
+
+    return indices;
+  }
+};
+
+enum class Predicate { EQUALS, STARTS_WITH, ENDS_WITH, CONTAINS };
+
+// Returns the position of the first c in [p, p + n), or NOT_FOUND.
+inline size_t find_byte(const char* p, size_t n, char c) noexcept {
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  const __m128i needle = _mm_set1_epi8(c);
+  for (; i + 16 <= n; i += 16) {
+    __m128i block = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+    int hits = _mm_movemask_epi8(_mm_cmpeq_epi8(block, needle));
+    if (hits != 0) {
+      return i + __builtin_ctz(hits);
+    }
+  }
+#endif
+
+  for (; i < n; ++i) {
+    if (p[i] == c) {
+      return i;
+    }
+  }
+
+  return NOT_FOUND;
+}
+
+// Checks whether s[pos, pos + n) equals p[0, n), one memcmp per segment.
+// The caller must make sure that pos + n <= s.length().
+inline bool matches_at(const SmallString& s, size_t pos, const char* p, size_t n) noexcept {
+  if (pos < BUFFER_LIMIT) {
+    size_t in_buffer = BUFFER_LIMIT - pos;
+    if (in_buffer > n) {
+      in_buffer = n;
+    }
+
+    if (in_buffer != 0 && std::memcmp(s.inline_data() + pos, p, in_buffer) != 0) {
+      return false;
+    }
+
+    pos += in_buffer;
+    p += in_buffer;
+    n -= in_buffer;
+  }
+
+  return (n == 0) || (std::memcmp(s.spilled_data() + (pos - BUFFER_LIMIT), p, n) == 0);
+}
+
+// Returns the first position >= from where p[0, n) occurs in s, or NOT_FOUND.
+// Candidates are found by scanning each segment for the first needle byte;
+// a match may still straddle both segments, which matches_at handles.
+inline size_t find_in(const SmallString& s, const char* p, size_t n, size_t from = 0) noexcept {
+  size_t length = s.length();
+
+  if (n == 0) {
+    return (from <= length) ? from : NOT_FOUND;
+  }
+  if (n > length) {
+    return NOT_FOUND;
+  }
+
+  size_t last = length - n;
+  size_t i = from;
+
+  while (i <= last) {
+    // Scan only the segment that i lies in, and only up to the last start.
+    const char* segment;
+    size_t offset;
+    size_t segment_end;
+
+    if (i < BUFFER_LIMIT) {
+      segment = s.inline_data();
+      offset = 0;
+      segment_end = BUFFER_LIMIT;
+    }
+    else {
+      segment = s.spilled_data();
+      offset = BUFFER_LIMIT;
+      segment_end = length;
+    }
+
+    if (segment_end > last + 1) {
+      segment_end = last + 1;
+    }
+
+    size_t hit = find_byte(segment + (i - offset), segment_end - i, p[0]);
+    if (hit == NOT_FOUND) {
+      i = segment_end;
+      continue;
+    }
+
+    i += hit;
+    if (matches_at(s, i, p, n)) {
+      return i;
+    }
+    ++i;
+  }
+
+  return NOT_FOUND;
+}
+
+// The inline part of a needle, preloaded for the 16-byte compares.
+// _buffer is 22 bytes long, so it is covered by two overlapping loads:
+// bytes [0, 16) and bytes [6, 22).
+struct InlineNeedle {
+  char bytes[BUFFER_LIMIT];
+  int mask_low;
+  int mask_high;
+
+  InlineNeedle(const char* p, size_t n) noexcept {
+    size_t in_buffer = (n < BUFFER_LIMIT) ? n : BUFFER_LIMIT;
+
+    std::memset(bytes, 0, BUFFER_LIMIT);
+    if (in_buffer != 0) {
+      std::memcpy(bytes, p, in_buffer);
+    }
+
+    mask_low = 0;
+    mask_high = 0;
+    for (size_t i = 0; i < in_buffer; ++i) {
+      if (i < 16) {
+        mask_low |= 1 << i;
+      }
+      else {
+        mask_high |= 1 << (i - 6);
+      }
+    }
+  }
+
+  // Compares the first min(n, BUFFER_LIMIT) bytes of the row.
+  bool matches(const SmallString& row) const noexcept {
+    const char* buffer = row.inline_data();
+
+#if defined(__SSE2__)
+    // Bytes past the row's length may be garbage, but the masks
+    // make sure that we never look at their compare results.
+    __m128i low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer));
+    __m128i needle_low = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes));
+    if ((_mm_movemask_epi8(_mm_cmpeq_epi8(low, needle_low)) & mask_low) != mask_low) {
+      return false;
+    }
+
+    if (mask_high != 0) {
+      __m128i high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(buffer + 6));
+      __m128i needle_high = _mm_loadu_si128(reinterpret_cast<const __m128i*>(bytes + 6));
+      if ((_mm_movemask_epi8(_mm_cmpeq_epi8(high, needle_high)) & mask_high) != mask_high) {
+        return false;
+      }
+    }
+
+    return true;
+#else
+    size_t in_buffer = (mask_high != 0) ? BUFFER_LIMIT : __builtin_popcount(mask_low);
+    return std::memcmp(buffer, bytes, in_buffer) == 0;
+#endif
+  }
+};
+
+// Length pass over count (<= 64) lengths: selects those equal to n (or
+// at least n, if at_least is set).
+inline uint64_t length_mask(const size_t* lengths, size_t count, size_t n, bool at_least) noexcept {
+  // Lengths are saturated to 32 bits so that four of them fit in a vector.
+  // That can't tell lengths from 0xFFFFFFFF up apart, so needles that
+  // long are checked exactly, one row at a time.
+  const uint32_t saturated = 0xFFFFFFFFu;
+  uint64_t mask = 0;
+
+  if (n >= saturated) {
+    for (size_t i = 0; i < count; ++i) {
+      bool hit = at_least ? (lengths[i] >= n) : (lengths[i] == n);
+      mask |= static_cast<uint64_t>(hit) << i;
+    }
+    return mask;
+  }
+
+  uint32_t saturated_lengths[64];
+  for (size_t i = 0; i < count; ++i) {
+    saturated_lengths[i] = (lengths[i] > saturated) ? saturated : static_cast<uint32_t>(lengths[i]);
+  }
+
+  uint32_t target = static_cast<uint32_t>(n);
+  size_t i = 0;
+
+#if defined(__SSE2__)
+  // SSE2 only has signed compares, so flip the sign bits first.
+  const __m128i flip = _mm_set1_epi32(static_cast<int>(0x80000000u));
+  const __m128i wanted = _mm_xor_si128(_mm_set1_epi32(static_cast<int>(target)), flip);
+
+  for (; i + 4 <= count; i += 4) {
+    __m128i block = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i*>(saturated_lengths + i)), flip);
+    __m128i hits = _mm_cmpeq_epi32(block, wanted);
+    if (at_least) {
+      hits = _mm_or_si128(hits, _mm_cmpgt_epi32(block, wanted));
+    }
+    mask |= static_cast<uint64_t>(_mm_movemask_ps(_mm_castsi128_ps(hits))) << i;
+  }
+#endif
+
+  for (; i < count; ++i) {
+    bool hit = at_least ? (saturated_lengths[i] >= target) : (saturated_lengths[i] == target);
+    mask |= static_cast<uint64_t>(hit) << i;
+  }
+
+  return mask;
+}
+
+// The same over the rows in [rows, rows + count).
+inline uint64_t length_mask(const SmallString* rows, size_t count, size_t n, bool at_least) noexcept {
+  size_t lengths[64];
+  for (size_t i = 0; i < count; ++i) {
+    lengths[i] = rows[i].length();
+  }
+  return length_mask(lengths, count, n, at_least);
+}
+
+// Evaluates pred(row, needle) for every row.
+inline Bitmap batch_filter(std::span<const SmallString> rows, const char* needle, size_t n, Predicate pred) {
+  Bitmap selected(rows.size());
+  InlineNeedle inline_needle(needle, n);
+
+  for (size_t begin = 0; begin < rows.size(); begin += 64) {
+    size_t count = rows.size() - begin;
+    if (count > 64) {
+      count = 64;
+    }
+
+    const SmallString* block = rows.data() + begin;
+    uint64_t survivors = length_mask(block, count, n, pred != Predicate::EQUALS);
+    uint64_t result = 0;
+
+    while (survivors != 0) {
+      size_t i = __builtin_ctzll(survivors);
+      survivors &= survivors - 1;
+
+      const SmallString& row = block[i];
+      bool hit;
+
+      switch (pred) {
+        case Predicate::EQUALS:
+        case Predicate::STARTS_WITH:
+          hit = inline_needle.matches(row);
+          if (hit && n > BUFFER_LIMIT) {
+            hit = std::memcmp(row.spilled_data(), needle + BUFFER_LIMIT, n - BUFFER_LIMIT) == 0;
+          }
+          break;
+
+        case Predicate::ENDS_WITH:
+          hit = matches_at(row, row.length() - n, needle, n);
+          break;
+
+        default:
+          hit = find_in(row, needle, n) != NOT_FOUND;
+          break;
+      }
+
+      result |= static_cast<uint64_t>(hit) << i;
+    }
+
+    // Blocks start at multiples of 64, so each one fills exactly one word.
+    selected.words[begin / 64] = result;
+  }
+
+  return selected;
+}
+
+inline Bitmap batch_filter(std::span<const SmallString> rows, const char* needle, Predicate pred) {
+  return batch_filter(rows, needle, std::strlen(needle), pred);
+}
+
+inline Bitmap batch_filter(std::span<const SmallString> rows, const SmallString& needle, Predicate pred) {
+  // The needle is copied once per batch, so that the rows can be
+  // compared against contiguous bytes.
+  std::vector<char> bytes(needle.length() + 1);
+  std::memcpy(bytes.data(), needle.inline_data(), needle.inline_length());
+  if (needle.spilled_length() != 0) {
+    std::memcpy(bytes.data() + BUFFER_LIMIT, needle.spilled_data(), needle.spilled_length());
+  }
+
+  return batch_filter(rows, bytes.data(), needle.length(), pred);
+}
+
+#endif
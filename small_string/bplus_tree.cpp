@@ -0,0 +1,124 @@
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "bplus_tree.hpp"
+
+using namespace std;
+
+// Keys sharing long prefixes, so that the 8-byte prefixes tie a lot.
+static SmallString make(size_t n) {
+  SmallString s(n % 3 == 0 ? "customer/" : (n % 3 == 1 ? "cust" : "customer/order/"));
+  size_t x = n * 2654435761u % 100003;
+  while (x != 0) {
+    char c[2] = {static_cast<char>('0' + x % 10), '\0'};
+    s.append(c);
+    x /= 10;
+  }
+  return s;
+}
+
+// TESTS
+
+int main() {
+
+  // Prefixes keep byte order
+  assert (key_prefix(SmallString("ab")) < key_prefix(SmallString("abc")));
+  assert (key_prefix(SmallString("abcdefgh")) == key_prefix(SmallString("abcdefghij")));
+  assert (key_prefix(SmallString("\x80")) > key_prefix(SmallString("a")));
+
+  BPlusTree<size_t> tree;
+  std::map<string, size_t> expected;
+
+  for (size_t i = 0; i < 20000; ++i) {
+    SmallString key = make(i % 7919);
+    bool inserted = expected.insert_or_assign(key.str(), i).second;
+    assert (tree.insert_or_assign(key, i) == inserted);
+  }
+  assert (tree.size() == expected.size());
+  assert (tree.height() >= 2);
+
+  // Lookups
+  for (const auto& entry : expected) {
+    size_t* value = tree.find(SmallString(entry.first.c_str()));
+    assert (value != nullptr && *value == entry.second);
+  }
+  assert (tree.find(SmallString("customer")) == nullptr);
+  assert (tree.find(SmallString("zzz")) == nullptr);
+
+  // Full iteration is in order
+  auto e = expected.begin();
+  for (auto it = tree.begin(); it != tree.end(); ++it, ++e) {
+    assert (it.key().str() == e->first);
+    assert (it.value() == e->second);
+  }
+  assert (e == expected.end());
+
+  // Ranges
+  SmallString low("customer/1");
+  SmallString high("customer/3");
+  vector<string> in_range;
+  tree.for_each_in_range(low, high, [&](const SmallString& key, size_t) {
+    in_range.push_back(key.str());
+  });
+
+  vector<string> wanted;
+  for (auto it = expected.lower_bound("customer/1"); it != expected.lower_bound("customer/3"); ++it) {
+    wanted.push_back(it->first);
+  }
+  assert (!wanted.empty());
+  assert (in_range == wanted);
+
+  // Bulk loading, at several fill factors
+  vector<SmallString> keys;
+  vector<size_t> values;
+  for (const auto& entry : expected) {
+    keys.push_back(SmallString(entry.first.c_str()));
+    values.push_back(entry.second);
+  }
+
+  for (size_t fill : {2, 3, 24, 32}) {
+    BPlusTree<size_t> loaded;
+    loaded.insert_or_assign(SmallString("replaced"), 0);
+    loaded.bulk_load(keys, values, fill);
+    assert (loaded.size() == keys.size());
+    assert (loaded.find(SmallString("replaced")) == nullptr);
+
+    size_t i = 0;
+    for (auto it = loaded.begin(); it != loaded.end(); ++it, ++i) {
+      assert (compare(it.key(), keys[i]) == 0);
+    }
+    assert (i == keys.size());
+
+    for (size_t k = 0; k < keys.size(); k += 17) {
+      assert (*loaded.find(keys[k]) == values[k]);
+    }
+
+    // Still a valid tree to insert into
+    loaded.insert_or_assign(SmallString("a"), 1);
+    loaded.insert_or_assign(SmallString("zz"), 2);
+    assert (*loaded.find(SmallString("a")) == 1);
+    assert (loaded.begin().value() == 1);
+  }
+
+  // Tiny loads
+  BPlusTree<size_t> empty;
+  empty.bulk_load(span<const SmallString>(), span<const size_t>());
+  assert (empty.size() == 0 && empty.begin() == empty.end());
+
+  bool thrown = false;
+  try {
+    vector<SmallString> unsorted = {SmallString("b"), SmallString("a")};
+    vector<size_t> two = {1, 2};
+    empty.bulk_load(unsorted, two);
+  }
+  catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  return 0;
+
+}
@@ -0,0 +1,453 @@
+#ifndef BPLUS_TREE_HPP
+#define BPLUS_TREE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+#include "small_string.hpp"
+
+/*
+BPlusTree:
+An ordered map from SmallString to V for range queries. Entries live
+in leaves that are chained left to right; inner nodes only route.
+
+Comparing SmallStrings means chasing into the Fallback for long keys,
+so every node keeps, next to each key pointer, the key's first 8 bytes
+as a big-endian integer (zero padded). Integer order is the same as
+byte order, so most comparisons inside a node are a single integer
+compare, and the full key is only looked at when the prefixes tie.
+A node's prefixes take NODE_KEYS * 8 = 256 bytes: four cache lines.
+
+Keys are never erased, so an entry (and the key that separators point
+to) stays where it is for the life of the tree.
+*/
+
+// The first 8 bytes of s, big-endian, with zeros past the end.
+inline uint64_t key_prefix(const SmallString& s) noexcept {
+  unsigned char bytes[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+  size_t n = (s.length() < 8) ? s.length() : 8;
+  if (n != 0) {
+    std::memcpy(bytes, s.inline_data(), n);
+  }
+
+  uint64_t word;
+  std::memcpy(&word, bytes, 8);
+  return __builtin_bswap64(word);
+}
+
+template <typename V>
+class BPlusTree {
+
+  static constexpr size_t NODE_KEYS = 32;
+
+  struct Entry {
+    SmallString key;
+    V value;
+  };
+
+  struct Leaf {
+    uint16_t count;
+    uint64_t prefixes[NODE_KEYS];
+    Entry* entries[NODE_KEYS];
+    Leaf* next;
+  };
+
+  // keys[i] is the smallest key under children[i + 1].
+  struct Inner {
+    uint16_t count;
+    uint64_t prefixes[NODE_KEYS];
+    const SmallString* keys[NODE_KEYS];
+    void* children[NODE_KEYS + 1];
+  };
+
+  // What a split hands to the parent.
+  struct Split {
+    void* right;
+    uint64_t prefix;
+    const SmallString* key;
+  };
+
+  private:
+  void* _root;
+  size_t _height; // 0: the root is a leaf
+  size_t _size;
+
+    // Compares (prefix, key) pairs; the full keys only break ties.
+    static int compare_keys(uint64_t a_prefix, const SmallString& a, uint64_t b_prefix, const SmallString& b) noexcept {
+      if (a_prefix != b_prefix) {
+        return (a_prefix < b_prefix) ? -1 : 1;
+      }
+      return compare(a, b);
+    }
+
+    // First position whose key is >= key (if strict is set, > key).
+    template <typename K>
+    static size_t search(const uint64_t* prefixes, K key_at, size_t count, uint64_t prefix, const SmallString& key, bool strict) noexcept {
+      size_t low = 0;
+      size_t high = count;
+
+      while (low < high) {
+        size_t mid = (low + high) / 2;
+        int c = compare_keys(prefixes[mid], key_at(mid), prefix, key);
+        if (c < 0 || (strict && c == 0)) {
+          low = mid + 1;
+        }
+        else {
+          high = mid;
+        }
+      }
+      return low;
+    }
+
+    static size_t leaf_search(const Leaf* leaf, uint64_t prefix, const SmallString& key) noexcept {
+      return search(leaf->prefixes, [leaf](size_t i) -> const SmallString& {
+        return leaf->entries[i]->key;
+      }, leaf->count, prefix, key, false);
+    }
+
+    // The child that may hold key.
+    static size_t inner_search(const Inner* inner, uint64_t prefix, const SmallString& key) noexcept {
+      return search(inner->prefixes, [inner](size_t i) -> const SmallString& {
+        return *inner->keys[i];
+      }, inner->count, prefix, key, true);
+    }
+
+    Leaf* find_leaf(uint64_t prefix, const SmallString& key) const noexcept {
+      void* node = _root;
+      for (size_t level = _height; level > 0; --level) {
+        Inner* inner = static_cast<Inner*>(node);
+        node = inner->children[inner_search(inner, prefix, key)];
+      }
+      return static_cast<Leaf*>(node);
+    }
+
+    // Inserts into the subtree at node (level levels above the leaves).
+    // Returns true if the key is new; fills split if node had to split.
+    bool insert(void* node, size_t level, uint64_t prefix, const SmallString& key, V&& value, Split& split, bool& did_split) {
+      did_split = false;
+
+      if (level == 0) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        size_t i = leaf_search(leaf, prefix, key);
+
+        if (i < leaf->count && leaf->prefixes[i] == prefix && compare(leaf->entries[i]->key, key) == 0) {
+          leaf->entries[i]->value = std::move(value);
+          return false;
+        }
+
+        Entry* entry = new Entry{key, std::move(value)};
+
+        if (leaf->count == NODE_KEYS) {
+          // Split in half, then insert on the right side.
+          Leaf* right = new Leaf;
+          size_t half = NODE_KEYS / 2;
+          right->count = static_cast<uint16_t>(NODE_KEYS - half);
+          std::memcpy(right->prefixes, leaf->prefixes + half, right->count * sizeof(uint64_t));
+          std::memcpy(right->entries, leaf->entries + half, right->count * sizeof(Entry*));
+          right->next = leaf->next;
+          leaf->next = right;
+          leaf->count = static_cast<uint16_t>(half);
+
+          if (i > half) {
+            leaf_insert_at(right, i - half, prefix, entry);
+          }
+          else {
+            leaf_insert_at(leaf, i, prefix, entry);
+          }
+
+          split = Split{right, right->prefixes[0], &right->entries[0]->key};
+          did_split = true;
+        }
+        else {
+          leaf_insert_at(leaf, i, prefix, entry);
+        }
+        return true;
+      }
+
+      Inner* inner = static_cast<Inner*>(node);
+      size_t i = inner_search(inner, prefix, key);
+
+      Split below;
+      bool child_split;
+      bool inserted = insert(inner->children[i], level - 1, prefix, key, std::move(value), below, child_split);
+      if (!child_split) {
+        return inserted;
+      }
+
+      if (inner->count == NODE_KEYS) {
+        // Split around the middle key, which moves up.
+        Inner* right = new Inner;
+        size_t half = NODE_KEYS / 2;
+        right->count = static_cast<uint16_t>(NODE_KEYS - half - 1);
+        std::memcpy(right->prefixes, inner->prefixes + half + 1, right->count * sizeof(uint64_t));
+        std::memcpy(right->keys, inner->keys + half + 1, right->count * sizeof(SmallString*));
+        std::memcpy(right->children, inner->children + half + 1, (right->count + 1) * sizeof(void*));
+        split = Split{right, inner->prefixes[half], inner->keys[half]};
+        inner->count = static_cast<uint16_t>(half);
+        did_split = true;
+
+        if (i > half) {
+          inner_insert_at(right, i - half - 1, below);
+        }
+        else {
+          inner_insert_at(inner, i, below);
+        }
+      }
+      else {
+        inner_insert_at(inner, i, below);
+      }
+      return true;
+    }
+
+    static void leaf_insert_at(Leaf* leaf, size_t i, uint64_t prefix, Entry* entry) noexcept {
+      size_t moved = leaf->count - i;
+      std::memmove(leaf->prefixes + i + 1, leaf->prefixes + i, moved * sizeof(uint64_t));
+      std::memmove(leaf->entries + i + 1, leaf->entries + i, moved * sizeof(Entry*));
+      leaf->prefixes[i] = prefix;
+      leaf->entries[i] = entry;
+      ++leaf->count;
+    }
+
+    // The split child was children[i]; its new right half goes after it.
+    static void inner_insert_at(Inner* inner, size_t i, const Split& split) noexcept {
+      size_t moved = inner->count - i;
+      std::memmove(inner->prefixes + i + 1, inner->prefixes + i, moved * sizeof(uint64_t));
+      std::memmove(inner->keys + i + 1, inner->keys + i, moved * sizeof(SmallString*));
+      std::memmove(inner->children + i + 2, inner->children + i + 1, moved * sizeof(void*));
+      inner->prefixes[i] = split.prefix;
+      inner->keys[i] = split.key;
+      inner->children[i + 1] = split.right;
+      ++inner->count;
+    }
+
+    void destroy(void* node, size_t level) noexcept {
+      if (level == 0) {
+        Leaf* leaf = static_cast<Leaf*>(node);
+        for (size_t i = 0; i < leaf->count; ++i) {
+          delete leaf->entries[i];
+        }
+        delete leaf;
+        return;
+      }
+
+      Inner* inner = static_cast<Inner*>(node);
+      for (size_t i = 0; i <= inner->count; ++i) {
+        destroy(inner->children[i], level - 1);
+      }
+      delete inner;
+    }
+
+    static Leaf* new_leaf() {
+      Leaf* leaf = new Leaf;
+      leaf->count = 0;
+      leaf->next = nullptr;
+      return leaf;
+    }
+
+  public:
+  // A position in the leaf chain.
+  class iterator {
+    Leaf* _leaf;
+    size_t _i;
+
+    public:
+    iterator(Leaf* leaf, size_t i) noexcept : _leaf(leaf), _i(i) {
+      // Positions past a leaf's last entry mean the next leaf's first.
+      while (_leaf != nullptr && _i >= _leaf->count) {
+        _leaf = _leaf->next;
+        _i = 0;
+      }
+    }
+
+    const SmallString& key() const noexcept {
+      return _leaf->entries[_i]->key;
+    }
+
+    V& value() const noexcept {
+      return _leaf->entries[_i]->value;
+    }
+
+    iterator& operator++() noexcept {
+      *this = iterator(_leaf, _i + 1);
+      return *this;
+    }
+
+    bool operator==(const iterator& other) const noexcept {
+      return _leaf == other._leaf && (_leaf == nullptr || _i == other._i);
+    }
+  };
+
+  BPlusTree() : _root(new_leaf()), _height(0), _size(0) {}
+
+  ~BPlusTree() noexcept {
+    destroy(_root, _height);
+    _root = nullptr;
+  }
+
+  // Nodes are raw pointers: copying would mean double deletes.
+  BPlusTree(const BPlusTree&) = delete;
+  BPlusTree& operator=(const BPlusTree&) = delete;
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  size_t height() const noexcept {
+    return _height;
+  }
+
+  // Returns true if the key is new (otherwise, its value is replaced).
+  bool insert_or_assign(const SmallString& key, V value) {
+    Split split;
+    bool did_split;
+    bool inserted = insert(_root, _height, key_prefix(key), key, std::move(value), split, did_split);
+
+    if (did_split) {
+      Inner* root = new Inner;
+      root->count = 1;
+      root->prefixes[0] = split.prefix;
+      root->keys[0] = split.key;
+      root->children[0] = _root;
+      root->children[1] = split.right;
+      _root = root;
+      ++_height;
+    }
+
+    _size += inserted;
+    return inserted;
+  }
+
+  V* find(const SmallString& key) const noexcept {
+    uint64_t prefix = key_prefix(key);
+    Leaf* leaf = find_leaf(prefix, key);
+    size_t i = leaf_search(leaf, prefix, key);
+
+    if (i < leaf->count && leaf->prefixes[i] == prefix && compare(leaf->entries[i]->key, key) == 0) {
+      return &leaf->entries[i]->value;
+    }
+    return nullptr;
+  }
+
+  // The first entry whose key is >= key.
+  iterator lower_bound(const SmallString& key) const noexcept {
+    uint64_t prefix = key_prefix(key);
+    Leaf* leaf = find_leaf(prefix, key);
+    return iterator(leaf, leaf_search(leaf, prefix, key));
+  }
+
+  iterator begin() const noexcept {
+    void* node = _root;
+    for (size_t level = _height; level > 0; --level) {
+      node = static_cast<Inner*>(node)->children[0];
+    }
+    return iterator(static_cast<Leaf*>(node), 0);
+  }
+
+  iterator end() const noexcept {
+    return iterator(nullptr, 0);
+  }
+
+  // Calls f(key, value) for every key in [low, high), in order.
+  template <typename F>
+  void for_each_in_range(const SmallString& low, const SmallString& high, F f) const {
+    uint64_t high_prefix = key_prefix(high);
+    for (iterator it = lower_bound(low); it != end(); ++it) {
+      if (compare_keys(key_prefix(it.key()), it.key(), high_prefix, high) >= 0) {
+        break;
+      }
+      f(it.key(), it.value());
+    }
+  }
+
+  // Replaces the contents with keys[i] -> values[i]. The keys must be
+  // strictly increasing (throws std::invalid_argument otherwise); leaves
+  // are filled up to fill (out of NODE_KEYS), leaving room for inserts.
+  void bulk_load(std::span<const SmallString> keys, std::span<const V> values, size_t fill = NODE_KEYS) {
+    if (keys.size() != values.size()) {
+      throw std::invalid_argument("bulk_load needs as many values as keys.");
+    }
+    for (size_t i = 1; i < keys.size(); ++i) {
+      if (compare(keys[i - 1], keys[i]) >= 0) {
+        throw std::invalid_argument("bulk_load needs strictly increasing keys.");
+      }
+    }
+    if (fill < 2 || fill > NODE_KEYS) {
+      fill = NODE_KEYS;
+    }
+
+    size_t height = 0;
+
+    // The leaf level, chained left to right, and what each leaf would
+    // hand to its parent as a separator.
+    std::vector<void*> level;
+    std::vector<Split> separators;
+    Leaf* previous = nullptr;
+
+    for (size_t begin = 0; begin < keys.size() || level.empty(); begin += fill) {
+      Leaf* leaf = new_leaf();
+      size_t count = (keys.size() - begin < fill) ? keys.size() - begin : fill;
+
+      for (size_t i = 0; i < count; ++i) {
+        leaf->prefixes[i] = key_prefix(keys[begin + i]);
+        leaf->entries[i] = new Entry{keys[begin + i], values[begin + i]};
+      }
+      leaf->count = static_cast<uint16_t>(count);
+
+      if (previous != nullptr) {
+        previous->next = leaf;
+      }
+      previous = leaf;
+
+      level.push_back(leaf);
+      if (count != 0) {
+        separators.push_back(Split{leaf, leaf->prefixes[0], &leaf->entries[0]->key});
+      }
+    }
+
+    // Inner levels, bottom up: each inner node takes up to fill + 1
+    // children, and the first child's separator moves up.
+    while (level.size() > 1) {
+      std::vector<void*> parents;
+      std::vector<Split> parent_separators;
+
+      for (size_t begin = 0, count = 0; begin < level.size(); begin += count) {
+        count = (level.size() - begin < fill + 1) ? level.size() - begin : fill + 1;
+
+        // Don't leave a lonely child for the last node.
+        if (level.size() - begin - count == 1) {
+          --count;
+        }
+
+        Inner* inner = new Inner;
+        inner->count = static_cast<uint16_t>(count - 1);
+        inner->children[0] = level[begin];
+        for (size_t i = 1; i < count; ++i) {
+          inner->prefixes[i - 1] = separators[begin + i].prefix;
+          inner->keys[i - 1] = separators[begin + i].key;
+          inner->children[i] = level[begin + i];
+        }
+
+        parents.push_back(inner);
+        parent_separators.push_back(Split{inner, separators[begin].prefix, separators[begin].key});
+      }
+
+      level.swap(parents);
+      separators.swap(parent_separators);
+      ++height;
+    }
+
+    // Only now that the new tree is built does the old one go away.
+    destroy(_root, _height);
+    _root = level[0];
+    _height = height;
+    _size = keys.size();
+  }
+
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <algorithm>
+#include <chrono>
+#include <map>
+#include <vector>
+
+#include "bplus_tree.hpp"
+
+using namespace std;
+
+/*
+BPlusTree vs std::map<SmallString, size_t>: random inserts, point
+lookups, a range scan, and (for the tree) bulk loading.
+*/
+
+struct Less {
+  bool operator()(const SmallString& a, const SmallString& b) const noexcept {
+    return compare(a, b) < 0;
+  }
+};
+
+static volatile size_t sink;
+
+template <typename F>
+static double time_ms(F f) {
+  auto start = chrono::steady_clock::now();
+  f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+
+  const size_t KEYS = 1000000;
+
+  // Half short (inline) keys, half long ones that share a prefix.
+  vector<SmallString> keys;
+  for (size_t i = 0; i < KEYS; ++i) {
+    SmallString key(i % 2 == 0 ? "k" : "tenant/some-organization/user/");
+    size_t x = i * 2654435761u % 1000000007;
+    while (x != 0) {
+      char c[2] = {static_cast<char>('a' + x % 26), '\0'};
+      key.append(c);
+      x /= 26;
+    }
+    keys.push_back(key);
+  }
+
+  BPlusTree<size_t> tree;
+  map<SmallString, size_t, Less> ordered;
+
+  double tree_insert = time_ms([&]() {
+    for (size_t i = 0; i < KEYS; ++i) {
+      tree.insert_or_assign(keys[i], i);
+    }
+  });
+  double map_insert = time_ms([&]() {
+    for (size_t i = 0; i < KEYS; ++i) {
+      ordered.insert_or_assign(keys[i], i);
+    }
+  });
+
+  double tree_find = time_ms([&]() {
+    size_t total = 0;
+    for (size_t i = 0; i < KEYS; ++i) {
+      total += *tree.find(keys[(i * 7919) % KEYS]);
+    }
+    sink = total;
+  });
+  double map_find = time_ms([&]() {
+    size_t total = 0;
+    for (size_t i = 0; i < KEYS; ++i) {
+      total += ordered.find(keys[(i * 7919) % KEYS])->second;
+    }
+    sink = total;
+  });
+
+  SmallString low("tenant/some-organization/user/b");
+  SmallString high("tenant/some-organization/user/n");
+  double tree_range = time_ms([&]() {
+    size_t total = 0;
+    tree.for_each_in_range(low, high, [&](const SmallString&, size_t value) {
+      total += value;
+    });
+    sink = total;
+  });
+  double map_range = time_ms([&]() {
+    size_t total = 0;
+    for (auto it = ordered.lower_bound(low); it != ordered.end() && compare(it->first, high) < 0; ++it) {
+      total += it->second;
+    }
+    sink = total;
+  });
+
+  vector<SmallString> sorted = keys;
+  sort(sorted.begin(), sorted.end(), Less());
+  vector<size_t> values(KEYS, 1);
+  BPlusTree<size_t> loaded;
+  double tree_bulk = time_ms([&]() {
+    loaded.bulk_load(sorted, values);
+  });
+
+  cout << "insert: BPlusTree " << tree_insert << " ms, std::map " << map_insert << " ms" << endl;
+  cout << "find:   BPlusTree " << tree_find << " ms, std::map " << map_find << " ms" << endl;
+  cout << "range:  BPlusTree " << tree_range << " ms, std::map " << map_range << " ms" << endl;
+  cout << "bulk load: " << tree_bulk << " ms" << endl;
+
+  return 0;
+
+}
@@ -0,0 +1,122 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "clock_cache.hpp"
+
+using namespace std;
+
+static SmallString make(size_t n) {
+  return SmallString(("https://example.com/fragments/" + to_string(n) + "?variant=dark").c_str());
+}
+
+// TESTS
+
+int main() {
+
+  // Heap footprints
+  assert (SmallString("short").heap_footprint() == 0);
+  assert (make(1).heap_footprint() > make(1).spilled_length());
+
+  ClockCache<int> cache(1 << 20, 8);
+  assert (cache.insert(SmallString("a"), 1));
+  assert (cache.insert(make(2), 2));
+  assert (*cache.find(string_view("a")) == 1);
+  assert (*cache.find(make(2)) == 2);
+  assert (cache.find(string_view("b")) == nullptr);
+
+  string url = "https://example.com/fragments/2?variant=dark";
+  assert (*cache.find(string_view(url)) == 2);
+
+  // Replacing keeps one entry
+  assert (cache.insert(SmallString("a"), 10));
+  assert (cache.size() == 2 && *cache.find(string_view("a")) == 10);
+
+  // Entry-bound: hit entries survive, cold ones go first
+  for (size_t i = 0; i < 6; ++i) {
+    cache.insert(make(100 + i), static_cast<int>(i));
+  }
+  assert (cache.size() == 8);
+  cache.find(string_view("a"));
+  cache.insert(make(200), 200);
+  assert (cache.size() == 8);
+  assert (cache.find(string_view("a")) != nullptr);
+  assert (cache.find(make(200)) != nullptr);
+
+  assert (cache.erase("a"));
+  assert (!cache.erase("a"));
+  assert (cache.size() == 7);
+
+  // Byte-bound: the charges add up and stay under the limit
+  ClockCache<string> bounded(4096, 1000);
+  assert (bounded.insert(make(0), string(100, 'x'), 100));
+  size_t charge = bounded.bytes();
+  assert (charge >= 100 + make(0).heap_footprint());
+  for (size_t i = 1; i < 5; ++i) {
+    assert (bounded.insert(make(i), string(100, 'x'), 100));
+  }
+  assert (bounded.size() == 5 && bounded.bytes() == 5 * charge);
+  assert (bounded.erase("https://example.com/fragments/3?variant=dark"));
+  assert (bounded.bytes() == 4 * charge);
+
+  for (size_t i = 0; i < 1000; ++i) {
+    bounded.insert(make(i), string(100, 'x'), 100);
+    assert (bounded.bytes() <= bounded.max_bytes());
+  }
+  assert (bounded.size() < 1000 && bounded.size() > 10);
+
+  assert (!bounded.insert(make(1), string(), 5000));
+  assert (bounded.find(make(1)) == nullptr);
+
+  // Growing an entry when every entry is referenced: the hand clears
+  // them all on its first lap, and the second must evict the others
+  {
+    ClockCache<string> full(5 * charge, 100);
+    for (size_t i = 0; i < 5; ++i) {
+      assert (full.insert(make(i), string(100, 'x'), 100));
+    }
+    assert (full.bytes() == full.max_bytes());
+    for (size_t i = 0; i < 5; ++i) {
+      assert (full.find(make(i)) != nullptr);
+    }
+
+    assert (full.insert(make(0), string(100, 'y'), 100 + 2 * charge));
+    assert (full.find(make(0)) != nullptr && *full.find(make(0)) == string(100, 'y'));
+    assert (full.size() == 3 && full.bytes() == full.max_bytes());
+  }
+
+  // Sharded, from several threads
+  ShardedClockCache<size_t> shared(1 << 22, 4096, 8);
+  vector<thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([&shared, t]() {
+      for (size_t i = 0; i < 20000; ++i) {
+        size_t k = (i * 7919 + t) % 3000;
+        SmallString key = make(k);
+        string text = "https://example.com/fragments/" + to_string(k) + "?variant=dark";
+
+        optional<size_t> hit = shared.get(text);
+        if (hit) {
+          assert (*hit == k);
+        }
+        else {
+          shared.insert(key, k);
+        }
+        if (i % 97 == 0) {
+          shared.erase(text);
+        }
+      }
+    });
+  }
+  for (thread& t : threads) {
+    t.join();
+  }
+  assert (shared.size() <= 4096 && shared.size() > 0);
+  assert (shared.bytes() <= (size_t(1) << 22));
+
+  return 0;
+
+}
@@ -0,0 +1,346 @@
+#ifndef CLOCK_CACHE_HPP
+#define CLOCK_CACHE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+ClockCache:
+A bounded cache keyed by SmallString, with CLOCK eviction (a cheap
+approximation of LRU): every hit sets the entry's reference bit, and
+when room is needed a hand sweeps the slots, clearing set bits and
+evicting the first entry whose bit was already clear.
+
+Entries live in one flat array of slots (never reallocated after
+construction), found through a linear-probing index of slot numbers.
+Lookups take a string_view (or a SmallString), hash it in place and
+compare against the stored key segment by segment, so a hit or a miss
+allocates nothing.
+
+The capacity is in bytes. An entry is charged sizeof(Slot), plus what
+its key really holds on the heap (heap_footprint), plus whatever extra
+the caller says the value holds. There's also a cap on the number of
+entries (the number of slots).
+
+V must be default constructible and movable.
+
+ShardedClockCache splits the keys (by the top bits of their hash)
+between shards with a mutex each, for use from many threads. It hands
+out copies of values, never pointers into a shard.
+*/
+
+template <typename V>
+class ClockCache {
+
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  struct Slot {
+    SmallString key;
+    V value;
+    uint64_t hash;
+    size_t charge;
+    bool used;
+    bool referenced;
+  };
+
+  template <typename>
+  friend class ShardedClockCache;
+
+  private:
+  std::vector<Slot> _slots;
+  std::vector<uint32_t> _free;
+  std::vector<uint32_t> _index;
+  size_t _mask;
+  size_t _hand;
+  size_t _bytes;
+  size_t _max_bytes;
+  size_t _size;
+
+    template <typename Key>
+    size_t find_position(const Key& key, uint64_t hash) const noexcept {
+      size_t i = hash & _mask;
+      while (_index[i] != EMPTY) {
+        const Slot& slot = _slots[_index[i]];
+        if (slot.hash == hash && same(slot.key, key)) {
+          return i;
+        }
+        i = (i + 1) & _mask;
+      }
+      return i;
+    }
+
+    static bool same(const SmallString& stored, std::string_view key) noexcept {
+      return equals(stored, key);
+    }
+
+    static bool same(const SmallString& stored, const SmallString& key) noexcept {
+      return stored.length() == key.length() && compare(stored, key) == 0;
+    }
+
+    // Backward-shift deletion, so the index never needs tombstones.
+    void erase_position(size_t hole) noexcept {
+      size_t next = (hole + 1) & _mask;
+      while (_index[next] != EMPTY) {
+        size_t home = _slots[_index[next]].hash & _mask;
+        if (((next - home) & _mask) >= ((next - hole) & _mask)) {
+          _index[hole] = _index[next];
+          hole = next;
+        }
+        next = (next + 1) & _mask;
+      }
+      _index[hole] = EMPTY;
+    }
+
+    void release(uint32_t s) {
+      Slot& slot = _slots[s];
+      erase_position(find_position(slot.key, slot.hash));
+
+      _bytes -= slot.charge;
+      --_size;
+      slot.key.empty();
+      slot.value = V();
+      slot.used = false;
+      _free.push_back(s);
+    }
+
+    // Sweeps until one entry (other than keep) is gone. Twice round is
+    // always enough, as long as there is another entry.
+    void evict_one(uint32_t keep = EMPTY) {
+      while (true) {
+        Slot& slot = _slots[_hand];
+        uint32_t s = static_cast<uint32_t>(_hand);
+        _hand = (_hand + 1 == _slots.size()) ? 0 : _hand + 1;
+
+        if (!slot.used || s == keep) {
+          continue;
+        }
+        if (slot.referenced) {
+          slot.referenced = false;
+          continue;
+        }
+        release(s);
+        return;
+      }
+    }
+
+    template <typename Key>
+    V* find_hashed(const Key& key, uint64_t hash) noexcept {
+      size_t i = find_position(key, hash);
+      if (_index[i] == EMPTY) {
+        return nullptr;
+      }
+      Slot& slot = _slots[_index[i]];
+      slot.referenced = true;
+      return &slot.value;
+    }
+
+    bool insert_hashed(const SmallString& key, uint64_t hash, V value, size_t value_bytes) {
+      size_t i = find_position(key, hash);
+      if (_index[i] != EMPTY) {
+        uint32_t s = _index[i];
+        Slot& slot = _slots[s];
+        size_t charge = sizeof(Slot) + slot.key.heap_footprint() + value_bytes;
+        if (charge > _max_bytes) {
+          release(s);
+          return false;
+        }
+
+        _bytes = _bytes - slot.charge + charge;
+        slot.charge = charge;
+        slot.value = std::move(value);
+        // Hit, so the hand passes it over at least once.
+        slot.referenced = true;
+
+        // It fits on its own, so while over the capacity there are others
+        // to evict; if they're all referenced too, the second lap must not
+        // take this one.
+        while (_bytes > _max_bytes) {
+          evict_one(s);
+        }
+        return true;
+      }
+
+      // The copy is what gets charged (its fallback may be smaller than
+      // the original's).
+      SmallString stored(key);
+      size_t charge = sizeof(Slot) + stored.heap_footprint() + value_bytes;
+      if (charge > _max_bytes) {
+        return false;
+      }
+
+      while (_free.empty() || _bytes + charge > _max_bytes) {
+        evict_one();
+      }
+
+      uint32_t s = _free.back();
+      _free.pop_back();
+      Slot& slot = _slots[s];
+      slot.key = std::move(stored);
+      slot.value = std::move(value);
+      slot.hash = hash;
+      slot.charge = charge;
+      slot.used = true;
+      // New entries start cold: they only survive the hand if they're hit.
+      slot.referenced = false;
+
+      _index[find_position(key, hash)] = s;
+      _bytes += charge;
+      ++_size;
+      return true;
+    }
+
+    bool erase_hashed(std::string_view key, uint64_t hash) {
+      size_t i = find_position(key, hash);
+      if (_index[i] == EMPTY) {
+        return false;
+      }
+      release(_index[i]);
+      return true;
+    }
+
+  public:
+  ClockCache(size_t max_bytes, size_t max_entries)
+    : _hand(0), _bytes(0), _max_bytes(max_bytes), _size(0) {
+    if (max_entries == 0 || max_entries >= EMPTY / 2) {
+      throw std::invalid_argument("Invalid number of entries");
+    }
+
+    _slots.resize(max_entries);
+    for (Slot& slot : _slots) {
+      slot.used = false;
+      slot.referenced = false;
+    }
+    for (size_t s = max_entries; s-- > 0;) {
+      _free.push_back(static_cast<uint32_t>(s));
+    }
+
+    size_t index_size = 1;
+    while (index_size < 2 * max_entries) {
+      index_size <<= 1;
+    }
+    _index.assign(index_size, EMPTY);
+    _mask = index_size - 1;
+  }
+
+  size_t size() const noexcept {
+    return _size;
+  }
+
+  size_t bytes() const noexcept {
+    return _bytes;
+  }
+
+  size_t max_bytes() const noexcept {
+    return _max_bytes;
+  }
+
+  // The cached value, or nullptr; good until the next insert or erase.
+  V* find(std::string_view key) noexcept {
+    return find_hashed(key, hash_string(key));
+  }
+
+  V* find(const SmallString& key) noexcept {
+    return find_hashed(key, hash_string(key));
+  }
+
+  // Inserts or replaces, evicting as needed. value_bytes is what the
+  // value owns beyond sizeof(V). False if the entry alone is over the
+  // capacity (the key is then not cached at all).
+  bool insert(const SmallString& key, V value, size_t value_bytes = 0) {
+    return insert_hashed(key, hash_string(key), std::move(value), value_bytes);
+  }
+
+  bool erase(std::string_view key) {
+    return erase_hashed(key, hash_string(key));
+  }
+
+};
+
+template <typename V>
+class ShardedClockCache {
+
+  struct alignas(64) Shard {
+    std::mutex lock;
+    ClockCache<V> cache;
+
+    Shard(size_t max_bytes, size_t max_entries) : cache(max_bytes, max_entries) {}
+  };
+
+  private:
+  std::vector<std::unique_ptr<Shard>> _shards;
+  size_t _bits;
+
+    // The top bits pick the shard; the index inside uses the low ones.
+    Shard& shard_of(uint64_t hash) const noexcept {
+      return *_shards[(_bits == 0) ? 0 : hash >> (64 - _bits)];
+    }
+
+  public:
+  // The capacities are split evenly; shards is rounded up to a power of two.
+  ShardedClockCache(size_t max_bytes, size_t max_entries, size_t shards = 16) : _bits(0) {
+    while ((size_t(1) << _bits) < shards) {
+      ++_bits;
+    }
+
+    size_t count = size_t(1) << _bits;
+    size_t entries = (max_entries + count - 1) / count;
+    for (size_t i = 0; i < count; ++i) {
+      _shards.push_back(std::make_unique<Shard>(max_bytes / count, entries));
+    }
+  }
+
+  // A copy of the cached value, if there is one.
+  std::optional<V> get(std::string_view key) {
+    uint64_t hash = hash_string(key);
+    Shard& shard = shard_of(hash);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    V* value = shard.cache.find_hashed(key, hash);
+    return (value == nullptr) ? std::nullopt : std::optional<V>(*value);
+  }
+
+  bool insert(const SmallString& key, V value, size_t value_bytes = 0) {
+    uint64_t hash = hash_string(key);
+    Shard& shard = shard_of(hash);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.cache.insert_hashed(key, hash, std::move(value), value_bytes);
+  }
+
+  bool erase(std::string_view key) {
+    uint64_t hash = hash_string(key);
+    Shard& shard = shard_of(hash);
+    std::lock_guard<std::mutex> guard(shard.lock);
+    return shard.cache.erase_hashed(key, hash);
+  }
+
+  size_t size() const {
+    size_t total = 0;
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+      std::lock_guard<std::mutex> guard(shard->lock);
+      total += shard->cache.size();
+    }
+    return total;
+  }
+
+  size_t bytes() const {
+    size_t total = 0;
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+      std::lock_guard<std::mutex> guard(shard->lock);
+      total += shard->cache.bytes();
+    }
+    return total;
+  }
+
+};
+
+#endif
@@ -0,0 +1,88 @@
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "concurrent_map.hpp"
+
+using namespace std;
+
+static SmallString make(size_t n) {
+  return SmallString(((n % 2 ? "k" : "a key that is long enough to spill/") + to_string(n)).c_str());
+}
+
+static string make_std(size_t n) {
+  return (n % 2 ? "k" : "a key that is long enough to spill/") + to_string(n);
+}
+
+// TESTS
+
+int main() {
+
+  ConcurrentMap<uint64_t> map(4);
+  assert (map.shards() == 4);
+  assert (!map.find(string_view("missing")));
+
+  assert (map.insert_or_assign(SmallString("one"), 1));
+  assert (!map.insert_or_assign(SmallString("one"), 11));
+  assert (*map.find(string_view("one")) == 11);
+  assert (*map.find(SmallString("one")) == 11);
+  assert (map.upsert(SmallString("two"), [](uint64_t v) { return v + 2; }) == 2);
+  assert (map.upsert(SmallString("two"), [](uint64_t v) { return v + 2; }) == 4);
+  assert (map.insert_or_assign(SmallString(""), 0));
+  assert (map.find(string_view("")).value() == 0);
+
+  // Lots of growing
+  for (size_t i = 0; i < 50000; ++i) {
+    map.insert_or_assign(make(i), i);
+  }
+  assert (map.size() == 50003);
+  for (size_t i = 0; i < 50000; i += 7) {
+    assert (*map.find(make_std(i)) == i);
+  }
+
+  size_t seen = 0;
+  map.for_each([&](string_view key, uint64_t value) {
+    if (key != "one" && key != "two" && !key.empty()) {
+      assert (key == make_std(value));
+    }
+    ++seen;
+  });
+  assert (seen == 50003);
+
+  // Counters from many threads, readers alongside
+  ConcurrentMap<uint64_t> counters(8);
+  const size_t THREADS = 6;
+  const size_t ROUNDS = 20000;
+  vector<thread> threads;
+  for (size_t t = 0; t < THREADS; ++t) {
+    threads.emplace_back([&counters, t]() {
+      for (size_t i = 0; i < ROUNDS; ++i) {
+        size_t k = (i * 31 + t) % 5000;
+        if (t % 3 == 2) {
+          // A reader: counts only go up.
+          optional<uint64_t> before = counters.find(make_std(k));
+          optional<uint64_t> after = counters.find(make_std(k));
+          assert (!before || (after && *after >= *before));
+        }
+        else {
+          counters.upsert(make(k), [](uint64_t v) { return v + 1; });
+        }
+      }
+    });
+  }
+  for (thread& t : threads) {
+    t.join();
+  }
+
+  uint64_t total = 0;
+  counters.for_each([&](string_view, uint64_t value) {
+    total += value;
+  });
+  assert (total == ROUNDS * (THREADS - THREADS / 3));
+
+  return 0;
+
+}
@@ -0,0 +1,308 @@
+#ifndef CONCURRENT_MAP_HPP
+#define CONCURRENT_MAP_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+ConcurrentMap:
+A SmallString -> V map shared by many threads. Keys are spread over
+lock-striped shards (by the top bits of their hash); writers take their
+shard's mutex, readers never lock.
+
+Each shard is an open-addressing table whose slots are published once
+and never move or go away: a writer fills in the key and value, then
+stores the slot's tag with release, and readers that see the tag see
+the rest. Values are std::atomic<V>, so assigning to an existing key is
+a single atomic store.
+
+The one thing that can't be done under a reader's feet is growing, so
+that is fenced with a seqlock: the shard's version is odd while a new
+table is being filled, and a reader retries if the version moved while
+it was looking. Old tables are retired, not freed, since a reader may
+still be walking one; they are freed with the map (all of them together
+take less than the live table).
+
+Keys are copied into per-shard arenas of fixed chunks, so the bytes a
+slot points at stay put for the life of the map. There is no erase.
+
+V must be trivially copyable; atomic<V> is lock-free for the usual
+counter and pointer sizes.
+*/
+
+template <typename V>
+class ConcurrentMap {
+
+  static_assert(std::is_trivially_copyable<V>::value, "ConcurrentMap values must be trivially copyable");
+
+  static constexpr size_t ARENA_CHUNK = 64 * 1024;
+  static constexpr size_t INITIAL_SLOTS = 16;
+
+  struct Slot {
+    // hash | 1, or 0 while the slot is free.
+    std::atomic<uint64_t> tag;
+    std::atomic<const char*> key;
+    std::atomic<size_t> length;
+    std::atomic<V> value;
+  };
+
+  struct Table {
+    size_t mask;
+    std::unique_ptr<Slot[]> slots;
+
+    explicit Table(size_t size) : mask(size - 1), slots(new Slot[size]) {}
+  };
+
+  struct alignas(64) Shard {
+    std::mutex lock;
+    std::atomic<uint64_t> version{0};
+    std::atomic<Table*> table{nullptr};
+    size_t size = 0;
+    std::vector<std::unique_ptr<Table>> tables; // The live one is last.
+    std::vector<std::unique_ptr<char[]>> chunks;
+    size_t chunk_used = ARENA_CHUNK;
+  };
+
+  private:
+  std::vector<std::unique_ptr<Shard>> _shards;
+  size_t _bits;
+
+    static uint64_t tag_of(uint64_t hash) noexcept {
+      return hash | 1;
+    }
+
+    // Bit 0 went to the tag, so the index starts at bit 1.
+    static size_t home(uint64_t tag, size_t mask) noexcept {
+      return static_cast<size_t>(tag >> 1) & mask;
+    }
+
+    Shard& shard_of(uint64_t hash) const noexcept {
+      return *_shards[(_bits == 0) ? 0 : hash >> (64 - _bits)];
+    }
+
+    static bool same(const Slot& slot, const SmallString& key) noexcept {
+      size_t length = slot.length.load(std::memory_order_relaxed);
+      return length == key.length() && equals(key, std::string_view(slot.key.load(std::memory_order_relaxed), length));
+    }
+
+    static bool same(const Slot& slot, std::string_view key) noexcept {
+      size_t length = slot.length.load(std::memory_order_relaxed);
+      return std::string_view(slot.key.load(std::memory_order_relaxed), length) == key;
+    }
+
+    // The slot holding key, or the free slot where it would go.
+    template <typename Key>
+    static Slot* probe(const Table* table, const Key& key, uint64_t tag) noexcept {
+      for (size_t i = home(tag, table->mask);; i = (i + 1) & table->mask) {
+        Slot& slot = table->slots[i];
+        uint64_t seen = slot.tag.load(std::memory_order_acquire);
+        if (seen == 0 || (seen == tag && same(slot, key))) {
+          return &slot;
+        }
+      }
+    }
+
+    // Optimistic read: retried if the table was swapped meanwhile.
+    template <typename Key>
+    std::optional<V> read(const Key& key) const noexcept {
+      uint64_t tag = tag_of(hash_string(key));
+      Shard& shard = shard_of(tag);
+
+      while (true) {
+        uint64_t before = shard.version.load(std::memory_order_acquire);
+        if (before & 1) {
+          std::this_thread::yield();
+          continue;
+        }
+
+        std::optional<V> result;
+        Table* table = shard.table.load(std::memory_order_acquire);
+        if (table != nullptr) {
+          Slot* slot = probe(table, key, tag);
+          if (slot->tag.load(std::memory_order_relaxed) != 0) {
+            result = slot->value.load(std::memory_order_acquire);
+          }
+        }
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (shard.version.load(std::memory_order_relaxed) == before) {
+          return result;
+        }
+      }
+    }
+
+    const char* store_key(Shard& shard, const SmallString& key) {
+      size_t length = key.length();
+      if (shard.chunk_used + length > ARENA_CHUNK || shard.chunks.empty()) {
+        shard.chunks.push_back(std::unique_ptr<char[]>(new char[(length > ARENA_CHUNK) ? length : ARENA_CHUNK]));
+        shard.chunk_used = 0;
+      }
+
+      char* out = shard.chunks.back().get() + shard.chunk_used;
+      std::memcpy(out, key.inline_data(), key.inline_length());
+      if (key.spilled_length() != 0) {
+        std::memcpy(out + key.inline_length(), key.spilled_data(), key.spilled_length());
+      }
+      shard.chunk_used += length;
+      return out;
+    }
+
+    // Under the shard's lock. Readers spin while the version is odd.
+    void grow(Shard& shard) {
+      Table* old_table = shard.table.load(std::memory_order_relaxed);
+      size_t size = (old_table == nullptr) ? INITIAL_SLOTS : 2 * (old_table->mask + 1);
+      std::unique_ptr<Table> table(new Table(size));
+
+      shard.version.fetch_add(1, std::memory_order_acq_rel);
+      if (old_table != nullptr) {
+        for (size_t i = 0; i <= old_table->mask; ++i) {
+          const Slot& from = old_table->slots[i];
+          uint64_t tag = from.tag.load(std::memory_order_relaxed);
+          if (tag == 0) {
+            continue;
+          }
+
+          size_t j = home(tag, table->mask);
+          while (table->slots[j].tag.load(std::memory_order_relaxed) != 0) {
+            j = (j + 1) & table->mask;
+          }
+          Slot& to = table->slots[j];
+          to.key.store(from.key.load(std::memory_order_relaxed), std::memory_order_relaxed);
+          to.length.store(from.length.load(std::memory_order_relaxed), std::memory_order_relaxed);
+          to.value.store(from.value.load(std::memory_order_relaxed), std::memory_order_relaxed);
+          to.tag.store(tag, std::memory_order_relaxed);
+        }
+      }
+
+      shard.table.store(table.get(), std::memory_order_release);
+      shard.tables.push_back(std::move(table));
+      shard.version.fetch_add(1, std::memory_order_release);
+    }
+
+    // Under the shard's lock: the key's slot, created (holding V{}) if
+    // it's new. The bool says whether it was.
+    std::pair<Slot*, bool> slot_for(Shard& shard, const SmallString& key, uint64_t tag) {
+      Table* table = shard.table.load(std::memory_order_relaxed);
+      if (table != nullptr) {
+        Slot* slot = probe(table, key, tag);
+        if (slot->tag.load(std::memory_order_relaxed) != 0) {
+          return std::make_pair(slot, false);
+        }
+      }
+
+      // Kept at most half full.
+      if (table == nullptr || 2 * (shard.size + 1) > table->mask + 1) {
+        grow(shard);
+        table = shard.table.load(std::memory_order_relaxed);
+      }
+
+      Slot* slot = probe(table, key, tag);
+      slot->key.store(store_key(shard, key), std::memory_order_relaxed);
+      slot->length.store(key.length(), std::memory_order_relaxed);
+      slot->value.store(V{}, std::memory_order_relaxed);
+      slot->tag.store(tag, std::memory_order_release);
+      ++shard.size;
+      return std::make_pair(slot, true);
+    }
+
+  public:
+  // shards is rounded up to a power of two.
+  explicit ConcurrentMap(size_t shards = 64) : _bits(0) {
+    while ((size_t(1) << _bits) < shards) {
+      ++_bits;
+    }
+    for (size_t i = 0; i < (size_t(1) << _bits); ++i) {
+      _shards.push_back(std::make_unique<Shard>());
+    }
+  }
+
+  size_t shards() const noexcept {
+    return _shards.size();
+  }
+
+  std::optional<V> find(std::string_view key) const noexcept {
+    return read(key);
+  }
+
+  std::optional<V> find(const SmallString& key) const noexcept {
+    return read(key);
+  }
+
+  // True if the key is new.
+  bool insert_or_assign(const SmallString& key, V value) {
+    uint64_t tag = tag_of(hash_string(key));
+    Shard& shard = shard_of(tag);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    std::pair<Slot*, bool> found = slot_for(shard, key, tag);
+    found.first->value.store(value, std::memory_order_release);
+    return found.second;
+  }
+
+  // Sets the value to f(current) (current is V{} for a new key), all
+  // under the shard's lock, and returns it.
+  template <typename F>
+  V upsert(const SmallString& key, F f) {
+    uint64_t tag = tag_of(hash_string(key));
+    Shard& shard = shard_of(tag);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    Slot* slot = slot_for(shard, key, tag).first;
+    V value = f(slot->value.load(std::memory_order_relaxed));
+    slot->value.store(value, std::memory_order_release);
+    return value;
+  }
+
+  size_t size() const {
+    size_t total = 0;
+    for (const std::unique_ptr<Shard>& shard : _shards) {
+      std::lock_guard<std::mutex> guard(shard->lock);
+      total += shard->size;
+    }
+    return total;
+  }
+
+  // Calls f(key, value) for every entry of one shard, holding its lock,
+  // so it sees the shard as of one moment.
+  template <typename F>
+  void for_each_in_shard(size_t shard_index, F f) const {
+    Shard& shard = *_shards.at(shard_index);
+    std::lock_guard<std::mutex> guard(shard.lock);
+
+    Table* table = shard.table.load(std::memory_order_relaxed);
+    if (table == nullptr) {
+      return;
+    }
+    for (size_t i = 0; i <= table->mask; ++i) {
+      const Slot& slot = table->slots[i];
+      if (slot.tag.load(std::memory_order_relaxed) != 0) {
+        f(std::string_view(slot.key.load(std::memory_order_relaxed), slot.length.load(std::memory_order_relaxed)),
+          slot.value.load(std::memory_order_relaxed));
+      }
+    }
+  }
+
+  // Shard by shard: consistent within each, not across them.
+  template <typename F>
+  void for_each(F f) const {
+    for (size_t i = 0; i < _shards.size(); ++i) {
+      for_each_in_shard(i, f);
+    }
+  }
+
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include <iostream>
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "concurrent_map.hpp"
+
+using namespace std;
+
+/*
+ConcurrentMap vs one mutex around an unordered_map, from 1 to 64
+threads sharing 1000 hot counters: 90% reads, 10% increments. The total
+work is fixed, so on a machine with enough cores the time should drop
+as threads are added.
+*/
+
+static volatile size_t sink;
+
+template <typename F>
+static double time_ms(size_t threads, F f) {
+  auto start = chrono::steady_clock::now();
+  vector<thread> workers;
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back(f, t);
+  }
+  for (thread& worker : workers) {
+    worker.join();
+  }
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+
+  const size_t KEYS = 1000;
+  const size_t OPERATIONS = 4000000;
+
+  vector<SmallString> keys;
+  for (size_t k = 0; k < KEYS; ++k) {
+    string key = ((k % 2) ? "worker/state/" : "counter/requests/by-endpoint/") + to_string(k);
+    keys.push_back(SmallString(key.c_str()));
+  }
+
+  for (size_t threads = 1; threads <= 64; threads *= 2) {
+    size_t per_thread = OPERATIONS / threads;
+
+    ConcurrentMap<uint64_t> map;
+    double sharded = time_ms(threads, [&](size_t t) {
+      size_t found = 0;
+      for (size_t i = 0; i < per_thread; ++i) {
+        const SmallString& key = keys[(i * 7919 + t * 13) % KEYS];
+        if (i % 10 == 0) {
+          map.upsert(key, [](uint64_t v) { return v + 1; });
+        }
+        else {
+          found += map.find(key).has_value();
+        }
+      }
+      sink = found;
+    });
+
+    mutex lock;
+    unordered_map<SmallString, uint64_t, SmallStringHash, SmallStringEqual> locked;
+    double single_lock = time_ms(threads, [&](size_t t) {
+      size_t found = 0;
+      for (size_t i = 0; i < per_thread; ++i) {
+        const SmallString& key = keys[(i * 7919 + t * 13) % KEYS];
+        lock_guard<mutex> guard(lock);
+        if (i % 10 == 0) {
+          ++locked[key];
+        }
+        else {
+          found += locked.count(key);
+        }
+      }
+      sink = found;
+    });
+
+    cout << threads << " thread(s): ConcurrentMap " << sharded << " ms, mutex + unordered_map " << single_lock << " ms"
+         << endl;
+  }
+
+  return 0;
+
+}
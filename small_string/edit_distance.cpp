@@ -0,0 +1,107 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+
+#include "edit_distance.hpp"
+
+using namespace std;
+
+// The textbook DP.
+static size_t reference(const SmallString& a, const SmallString& b) {
+  size_t m = a.length();
+  size_t n = b.length();
+  vector<size_t> row(n + 1);
+
+  for (size_t j = 0; j <= n; ++j) {
+    row[j] = j;
+  }
+
+  for (size_t i = 1; i <= m; ++i) {
+    size_t diagonal = row[0];
+    row[0] = i;
+    for (size_t j = 1; j <= n; ++j) {
+      size_t above = row[j];
+      size_t best = diagonal + (a[i - 1] != b[j - 1]);
+      if (above + 1 < best) {
+        best = above + 1;
+      }
+      if (row[j - 1] + 1 < best) {
+        best = row[j - 1] + 1;
+      }
+      row[j] = best;
+      diagonal = above;
+    }
+  }
+
+  return row[n];
+}
+
+static SmallString make(size_t length, size_t seed, size_t alphabet) {
+  SmallString s;
+  for (size_t i = 0; i < length; ++i) {
+    char c[2] = {static_cast<char>('a' + (i * 7 + seed * 13 + (i * i * seed) / 3) % alphabet), '\0'};
+    s.append(c);
+  }
+  return s;
+}
+
+// TESTS
+
+int main() {
+
+  // The classics
+  assert (edit_distance(SmallString("kitten"), SmallString("sitting")) == 3);
+  assert (edit_distance(SmallString(""), SmallString("abc")) == 3);
+  assert (edit_distance(SmallString("abc"), SmallString("")) == 3);
+  assert (edit_distance(SmallString("same"), SmallString("same")) == 0);
+  assert (edit_distance(SmallString("flaw"), SmallString("lawn")) == 2);
+
+  // Bounded
+  assert (edit_distance(SmallString("kitten"), SmallString("sitting"), 2) == 3);
+  assert (edit_distance(SmallString("kitten"), SmallString("sitting"), 3) == 3);
+  assert (edit_distance(SmallString("a"), SmallString("abcdefgh"), 1) == 2);
+
+  // Against the DP: short, around 64 and well past it (several blocks),
+  // with and without bounds.
+  size_t lengths[] = {0, 1, 5, 21, 22, 23, 40, 63, 64, 65, 100, 129, 200};
+  size_t bounds[] = {0, 1, 3, 10, 50, NO_LIMIT};
+
+  for (size_t la : lengths) {
+    for (size_t lb : lengths) {
+      for (size_t seed = 0; seed < 3; ++seed) {
+        SmallString a = make(la, seed, 2 + seed);
+        SmallString b = make(lb, seed + 1, 2 + seed);
+        size_t expected = reference(a, b);
+
+        for (size_t k : bounds) {
+          size_t got = edit_distance(a, b, k);
+          assert (got == ((expected > k) ? k + 1 : expected));
+        }
+      }
+    }
+  }
+
+  // Near-duplicates of a long string: the band is what matters here.
+  SmallString original = make(300, 4, 4);
+  SmallString edited = original;
+  edited.append("xyz");
+  assert (edit_distance(original, edited, 5) == 3);
+  assert (edit_distance(edited, original, 2) == 3);
+
+  // Batch
+  SmallString query("levenshtein");
+  vector<SmallString> candidates;
+  candidates.push_back(SmallString("levenshtein"));
+  candidates.push_back(SmallString("levenstein"));
+  candidates.push_back(SmallString("frankenstein"));
+  candidates.push_back(SmallString("a rather long candidate that spills out of the buffer"));
+
+  vector<size_t> scores = edit_distance_batch(query, candidates, 2);
+  assert (scores[0] == 0);
+  assert (scores[1] == 1);
+  assert (scores[2] == 3);
+  assert (scores[3] == 3);
+
+  return 0;
+
+}
@@ -0,0 +1,271 @@
+#ifndef EDIT_DISTANCE_HPP
+#define EDIT_DISTANCE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <vector>
+
+#include "small_string.hpp"
+
+/*
+Edit distance:
+Levenshtein distance with Myers'/Hyyro's bit-parallel algorithm. The
+textbook DP fills an (m + 1) x (n + 1) table; here a whole column of
+it (for queries of up to 64 chars) lives in two 64-bit words holding
+the +1/-1 vertical deltas, and one text char updates the whole column
+with a handful of word operations.
+
+Longer queries are split into blocks of 64 rows. Given a bound max_k,
+only the blocks that intersect the diagonal band |row - column| <= max_k
+are computed (cells outside of it are always > max_k), and we give up
+as soon as the last row can no longer come back under the bound.
+
+Distances above max_k are reported as max_k + 1.
+*/
+
+const size_t NO_LIMIT = static_cast<size_t>(-1);
+
+class EditDistanceQuery {
+
+  static constexpr size_t WORD = 64;
+
+  private:
+  size_t _length;
+  size_t _blocks;
+
+  // _peq[c] has bit i set if query[i] == c. Queries of up to 64 chars
+  // only need this table, so they never touch the heap.
+  uint64_t _peq[256];
+  std::vector<uint64_t> _long_peq; // [c * _blocks + b], for longer queries
+
+    // Advances one block of the column by one text char. hin is the
+    // horizontal delta coming in from the row above; returns the delta
+    // going out at the row selected by last_row.
+    static int advance(uint64_t& pv, uint64_t& mv, uint64_t eq, int hin, uint64_t last_row) noexcept {
+      uint64_t xv = eq | mv;
+      eq |= (hin < 0) ? 1 : 0;
+      uint64_t xh = (((eq & pv) + pv) ^ pv) | eq;
+      uint64_t ph = mv | ~(xh | pv);
+      uint64_t mh = pv & xh;
+
+      int hout = 0;
+      if (ph & last_row) {
+        hout = 1;
+      }
+      else if (mh & last_row) {
+        hout = -1;
+      }
+
+      ph <<= 1;
+      mh <<= 1;
+      if (hin < 0) {
+        mh |= 1;
+      }
+      else if (hin > 0) {
+        ph |= 1;
+      }
+
+      pv = mh | ~(xv | ph);
+      mv = ph & xv;
+      return hout;
+    }
+
+    template <typename F>
+    static void for_each_char(const SmallString& s, F f) {
+      const char* segment = s.inline_data();
+      for (size_t i = 0; i < s.inline_length(); ++i) {
+        f(static_cast<unsigned char>(segment[i]));
+      }
+
+      segment = s.spilled_data();
+      for (size_t i = 0; i < s.spilled_length(); ++i) {
+        f(static_cast<unsigned char>(segment[i]));
+      }
+    }
+
+    size_t single_block(const SmallString& text, size_t k) const noexcept {
+      size_t n = text.length();
+      uint64_t last_row = uint64_t(1) << (_length - 1);
+      uint64_t pv = ~uint64_t(0);
+      uint64_t mv = 0;
+      size_t score = _length;
+      size_t j = 0;
+      bool gave_up = false;
+
+      // Not for_each_char, so that we can stop early.
+      const char* segments[2] = {text.inline_data(), text.spilled_data()};
+      size_t lengths[2] = {text.inline_length(), text.spilled_length()};
+
+      for (size_t s = 0; s < 2 && !gave_up; ++s) {
+        for (size_t i = 0; i < lengths[s]; ++i) {
+          uint64_t eq = _peq[static_cast<unsigned char>(segments[s][i])];
+          score += advance(pv, mv, eq, 1, last_row);
+          ++j;
+
+          // Each remaining char can lower the score by at most one.
+          if (score > k + (n - j)) {
+            gave_up = true;
+            break;
+          }
+        }
+      }
+
+      return gave_up ? k + 1 : score;
+    }
+
+    size_t banded_blocks(const SmallString& text, size_t k) const {
+      size_t n = text.length();
+      size_t m = _length;
+
+      std::vector<uint64_t> pv(_blocks, ~uint64_t(0));
+      std::vector<uint64_t> mv(_blocks, 0);
+      std::vector<size_t> score(_blocks);
+
+      uint64_t last_row = uint64_t(1) << ((m - 1) % WORD);
+      size_t last_rows = m - (_blocks - 1) * WORD;
+
+      // Column 0 is D[i][0] = i; rows r >= 1 live in block (r - 1) / 64.
+      size_t first = 0;
+      size_t last = ((k < m ? k : m) - (k == 0 ? 0 : 1)) / WORD;
+      for (size_t b = 0; b <= last; ++b) {
+        score[b] = (b == _blocks - 1) ? m : (b + 1) * WORD;
+      }
+
+      size_t j = 0;
+      bool gave_up = false;
+
+      // Returns false once the bound can no longer be met.
+      auto step = [&](unsigned char c) {
+        ++j;
+
+        // Blocks entering the band from below start out as if they
+        // continued the block above vertically (+1 per row). That
+        // overestimates, but only cells > k get overestimated.
+        size_t band_end = (j + k < m) ? j + k : m;
+        size_t new_last = (band_end - 1) / WORD;
+        for (; last < new_last; ++last) {
+          pv[last + 1] = ~uint64_t(0);
+          mv[last + 1] = 0;
+          score[last + 1] = score[last] + ((last + 1 == _blocks - 1) ? last_rows : WORD);
+        }
+
+        // Blocks that fell out of the band above are dropped for good;
+        // the first block left acts as if it were right under row 0.
+        if (j > k) {
+          size_t new_first = (j - k - 1) / WORD;
+          if (new_first > first) {
+            first = (new_first < last) ? new_first : last;
+          }
+        }
+
+        const uint64_t* eq = _long_peq.data() + c * _blocks;
+        int hin = 1;
+        for (size_t b = first; b <= last; ++b) {
+          uint64_t row = (b == _blocks - 1) ? last_row : (uint64_t(1) << (WORD - 1));
+          hin = advance(pv[b], mv[b], eq[b], hin, row);
+          score[b] += hin;
+        }
+
+        return !(last == _blocks - 1 && score[last] > k + (n - j));
+      };
+
+      const char* segments[2] = {text.inline_data(), text.spilled_data()};
+      size_t lengths[2] = {text.inline_length(), text.spilled_length()};
+
+      for (size_t s = 0; s < 2 && !gave_up; ++s) {
+        for (size_t i = 0; i < lengths[s] && !gave_up; ++i) {
+          gave_up = !step(static_cast<unsigned char>(segments[s][i]));
+        }
+      }
+
+      if (gave_up || score[_blocks - 1] > k) {
+        return k + 1;
+      }
+      return score[_blocks - 1];
+    }
+
+  public:
+  explicit EditDistanceQuery(const SmallString& query) {
+    _length = query.length();
+    _blocks = (_length + WORD - 1) / WORD;
+    std::memset(_peq, 0, sizeof(_peq));
+
+    if (_blocks > 1) {
+      _long_peq.assign(256 * _blocks, 0);
+    }
+
+    size_t i = 0;
+    for_each_char(query, [&](unsigned char c) {
+      if (_blocks > 1) {
+        _long_peq[c * _blocks + i / WORD] |= uint64_t(1) << (i % WORD);
+      }
+      else {
+        _peq[c] |= uint64_t(1) << i;
+      }
+      ++i;
+    });
+  }
+
+  size_t length() const noexcept {
+    return _length;
+  }
+
+  // The edit distance to text, or max_k + 1 if it's larger than max_k.
+  size_t distance(const SmallString& text, size_t max_k = NO_LIMIT) const {
+    size_t n = text.length();
+    size_t m = _length;
+
+    // The distance is at least the difference in lengths, and at most
+    // the longer length: tighten the bound accordingly.
+    size_t difference = (m > n) ? m - n : n - m;
+    if (difference > max_k) {
+      return max_k + 1;
+    }
+
+    size_t longer = (m > n) ? m : n;
+    size_t k = (max_k < longer) ? max_k : longer;
+
+    if (m == 0) {
+      return n;
+    }
+    if (n == 0) {
+      return m;
+    }
+
+    size_t d = (_blocks == 1) ? single_block(text, k) : banded_blocks(text, k);
+    return (d > k) ? max_k + 1 : d;
+  }
+
+};
+
+// The edit distance between a and b, or max_k + 1 if it's larger than
+// max_k. The shorter string is used as the query, so pairs where either
+// one fits in 64 chars never touch the heap.
+inline size_t edit_distance(const SmallString& a, const SmallString& b, size_t max_k = NO_LIMIT) {
+  if (a.length() <= b.length()) {
+    return EditDistanceQuery(a).distance(b, max_k);
+  }
+  return EditDistanceQuery(b).distance(a, max_k);
+}
+
+// Scores one query against many candidates: out[i] = distance to
+// candidates[i] (capped at max_k + 1). The query is preprocessed once.
+inline void edit_distance_batch(const SmallString& query, std::span<const SmallString> candidates,
+                                std::span<size_t> out, size_t max_k = NO_LIMIT) {
+  EditDistanceQuery prepared(query);
+
+  for (size_t i = 0; i < candidates.size() && i < out.size(); ++i) {
+    out[i] = prepared.distance(candidates[i], max_k);
+  }
+}
+
+inline std::vector<size_t> edit_distance_batch(const SmallString& query, std::span<const SmallString> candidates,
+                                               size_t max_k = NO_LIMIT) {
+  std::vector<size_t> out(candidates.size());
+  edit_distance_batch(query, candidates, out, max_k);
+  return out;
+}
+
+#endif
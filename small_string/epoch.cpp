@@ -0,0 +1,158 @@
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "epoch.hpp"
+
+using namespace std;
+
+// Counts live instances, to see when retired ones are freed.
+struct Tracked {
+  static inline atomic<int> alive{0};
+
+  Tracked() {
+    ++alive;
+  }
+
+  ~Tracked() {
+    --alive;
+  }
+};
+
+// TESTS
+
+int main() {
+
+  {
+    EpochDomain domain;
+    EpochDomain::Reader reader = domain.register_reader();
+
+    // Nobody inside: retired objects go at the next collect
+    domain.retire(new Tracked());
+    assert (Tracked::alive == 1 && domain.retired() == 1);
+    assert (domain.collect() == 1);
+    assert (Tracked::alive == 0 && domain.retired() == 0);
+
+    // A reader inside holds everything retired meanwhile
+    reader.enter();
+    domain.retire(new Tracked());
+    assert (domain.collect() == 0 && Tracked::alive == 1);
+
+    // Nested sections: still inside
+    {
+      EpochGuard guard(reader);
+    }
+    assert (domain.collect() == 0 && Tracked::alive == 1);
+    reader.exit();
+    assert (domain.collect() == 1 && Tracked::alive == 0);
+
+    // Readers that enter after the retire don't hold it
+    reader.enter();
+    EpochDomain::Reader late = domain.register_reader();
+    domain.retire(new Tracked());
+    domain.collect();
+    reader.exit();
+    late.enter();
+    assert (domain.collect() == 1 && Tracked::alive == 0);
+    late.exit();
+
+    // Left over at the end: the domain frees them
+    domain.retire(new Tracked());
+    reader.enter();
+  }
+  assert (Tracked::alive == 0);
+
+  // Reader slots are reused
+  {
+    EpochDomain domain;
+    {
+      EpochDomain::Reader a = domain.register_reader();
+      a.enter();
+      a.exit();
+    }
+    EpochDomain::Reader b = domain.register_reader();
+    b.enter();
+    domain.retire(new Tracked());
+    assert (domain.collect() == 0);
+    b.exit();
+    assert (domain.collect() == 1 && Tracked::alive == 0);
+  }
+
+  // RcuString, single threaded
+  {
+    EpochDomain domain;
+    EpochDomain::Reader reader = domain.register_reader();
+    RcuString cell(domain, SmallString("first"));
+
+    {
+      EpochGuard guard(reader);
+      const SmallString& value = cell.read();
+      cell.store(SmallString("a second value, long enough for the fallback"));
+      // The old value is still there for this reader
+      assert (value == "first");
+      assert (cell.read() == "a second value, long enough for the fallback");
+      assert (domain.collect() == 0);
+    }
+    domain.synchronize();
+    assert (domain.retired() == 0);
+  }
+
+  // RcuString under load: readers always see one whole value, writers
+  // replace it (spilled, so every old Fallback is freed through the domain)
+  {
+    EpochDomain domain;
+    const size_t THREADS = 4;
+    const size_t WRITES = 20000;
+
+    auto value_of = [](size_t i) {
+      string s = "value number " + to_string(i) + " - ";
+      while (s.length() < 40) {
+        s += char('a' + i % 26);
+      }
+      return s;
+    };
+
+    RcuString cell(domain, SmallString(value_of(0).c_str()));
+    atomic<bool> done(false);
+    atomic<size_t> bad(0);
+
+    vector<thread> readers;
+    for (size_t t = 0; t < THREADS; ++t) {
+      readers.emplace_back([&]() {
+        EpochDomain::Reader reader = domain.register_reader();
+        while (!done.load()) {
+          EpochGuard guard(reader);
+          const SmallString& value = cell.read();
+          string s = value.str();
+          size_t number = stoul(s.substr(13));
+          if (s != value_of(number)) {
+            ++bad;
+          }
+        }
+      });
+    }
+
+    thread writer([&]() {
+      for (size_t i = 1; i <= WRITES; ++i) {
+        cell.store(SmallString(value_of(i).c_str()));
+      }
+      done = true;
+    });
+
+    writer.join();
+    for (thread& t : readers) {
+      t.join();
+    }
+    assert (bad == 0);
+
+    domain.synchronize();
+    assert (domain.retired() == 0);
+    assert (cell.read().str() == value_of(WRITES));
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,307 @@
+#ifndef EPOCH_HPP
+#define EPOCH_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "small_string.hpp"
+
+/*
+Epoch-based reclamation:
+Lets readers use shared objects with no locks while writers replace
+them, freeing the old ones only once no reader can still be looking.
+
+Every reader thread registers once and gets its own counter, on its own
+cache line. Entering a read section makes the counter odd, leaving makes
+it even again; that's all a reader ever does.
+
+The enter is a store then a load (of the shared pointer), and the writer
+does the opposite: it swaps the pointer, then loads the counters. Those
+are two independent store-load pairs, which no choice of memory orders
+on the accesses alone keeps apart: the reader could still load the old
+pointer while the writer loads the old, even counter, and frees the
+object under the reader. So both sides put a seq_cst fence between
+their store and their load (enter() after bumping the counter, seal()
+before reading them): then one of them must see the other's store.
+
+A writer unlinks an object and retires it. Retired objects are sealed
+in batches together with a snapshot of the readers that were inside at
+the time (their odd counters). A batch can go once every one of those
+counters has moved on: anyone who entered later can only have seen the
+new objects. collect() frees the batches that are ready and never
+waits; synchronize() waits for everything retired so far.
+
+RcuString is the usual use: a SmallString that readers read in place
+and a writer replaces wholesale (the old one, Fallback included, is
+retired).
+*/
+
+class EpochDomain {
+
+  static constexpr size_t BATCH = 64;
+
+  struct alignas(64) ReaderSlot {
+    std::atomic<uint64_t> counter{0};
+    std::atomic<bool> in_use{false};
+  };
+
+  struct Retired {
+    void* object;
+    void (*free)(void*);
+  };
+
+  struct Batch {
+    std::vector<Retired> objects;
+    // Readers that were inside when the batch was sealed, and their counters then.
+    std::vector<std::pair<const ReaderSlot*, uint64_t>> waiting;
+  };
+
+  private:
+  std::mutex _lock;
+  std::vector<std::unique_ptr<ReaderSlot>> _slots;
+  std::vector<Retired> _pending;
+  std::vector<Batch> _batches;
+
+    // Under _lock.
+    void seal() {
+      if (_pending.empty()) {
+        return;
+      }
+
+      Batch batch;
+      batch.objects.swap(_pending);
+
+      // Pairs with the fence in Reader::enter (see above); the objects
+      // were unlinked before this.
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      for (const std::unique_ptr<ReaderSlot>& slot : _slots) {
+        uint64_t counter = slot->counter.load(std::memory_order_acquire);
+        if (counter & 1) {
+          batch.waiting.push_back(std::make_pair(slot.get(), counter));
+        }
+      }
+      _batches.push_back(std::move(batch));
+    }
+
+    static bool ready(const Batch& batch) noexcept {
+      for (const std::pair<const ReaderSlot*, uint64_t>& reader : batch.waiting) {
+        if (reader.first->counter.load(std::memory_order_acquire) == reader.second) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+    static void free_batch(Batch& batch) noexcept {
+      for (const Retired& retired : batch.objects) {
+        retired.free(retired.object);
+      }
+      batch.objects.clear();
+    }
+
+    // Under _lock.
+    size_t collect_locked() noexcept {
+      size_t freed = 0;
+      size_t kept = 0;
+      for (size_t i = 0; i < _batches.size(); ++i) {
+        if (ready(_batches[i])) {
+          freed += _batches[i].objects.size();
+          free_batch(_batches[i]);
+        }
+        else {
+          if (kept != i) {
+            _batches[kept] = std::move(_batches[i]);
+          }
+          ++kept;
+        }
+      }
+      _batches.resize(kept);
+      return freed;
+    }
+
+  public:
+  // One per reading thread; not to be shared between threads.
+  class Reader {
+
+    friend class EpochDomain;
+
+    private:
+    ReaderSlot* _slot;
+    size_t _depth;
+
+    explicit Reader(ReaderSlot* slot) noexcept : _slot(slot), _depth(0) {}
+
+    public:
+    Reader(Reader&& other) noexcept : _slot(other._slot), _depth(other._depth) {
+      other._slot = nullptr;
+    }
+
+    Reader(const Reader&) = delete;
+    Reader& operator=(const Reader&) = delete;
+    Reader& operator=(Reader&&) = delete;
+
+    ~Reader() noexcept {
+      if (_slot != nullptr) {
+        _slot->in_use.store(false, std::memory_order_release);
+      }
+    }
+
+    // Sections nest; only the outermost one touches the counter.
+    void enter() noexcept {
+      if (_depth++ == 0) {
+        _slot->counter.store(_slot->counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        // Keeps the loads of the section from moving above the store.
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+
+    void exit() noexcept {
+      if (--_depth == 0) {
+        _slot->counter.store(_slot->counter.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+      }
+    }
+
+  };
+
+  EpochDomain() = default;
+  EpochDomain(const EpochDomain&) = delete;
+  EpochDomain& operator=(const EpochDomain&) = delete;
+
+  // Every Reader must be gone by now.
+  ~EpochDomain() noexcept {
+    std::lock_guard<std::mutex> guard(_lock);
+    for (Batch& batch : _batches) {
+      free_batch(batch);
+    }
+    for (const Retired& retired : _pending) {
+      retired.free(retired.object);
+    }
+  }
+
+  Reader register_reader() {
+    std::lock_guard<std::mutex> guard(_lock);
+
+    // Slots are reused, but their counters carry on, so an old snapshot
+    // can't mistake a new reader for the old one.
+    for (const std::unique_ptr<ReaderSlot>& slot : _slots) {
+      bool expected = false;
+      if (slot->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+        return Reader(slot.get());
+      }
+    }
+
+    _slots.push_back(std::make_unique<ReaderSlot>());
+    _slots.back()->in_use.store(true, std::memory_order_relaxed);
+    return Reader(_slots.back().get());
+  }
+
+  // Frees object with delete once no reader can see it any more. It must
+  // already be unreachable for readers that enter from now on.
+  template <typename T>
+  void retire(T* object) {
+    if (object == nullptr) {
+      return;
+    }
+
+    std::lock_guard<std::mutex> guard(_lock);
+    _pending.push_back(Retired{object, [](void* p) {
+                                 delete static_cast<T*>(p);
+                               }});
+    if (_pending.size() >= BATCH) {
+      seal();
+      collect_locked();
+    }
+  }
+
+  // Frees whatever is safe to free, without waiting. Returns how many
+  // objects went.
+  size_t collect() {
+    std::lock_guard<std::mutex> guard(_lock);
+    seal();
+    return collect_locked();
+  }
+
+  // Waits until every object retired so far is freed. Not to be called
+  // from inside a read section.
+  void synchronize() {
+    std::lock_guard<std::mutex> guard(_lock);
+    seal();
+    while (true) {
+      collect_locked();
+      if (_batches.empty()) {
+        return;
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  // Objects retired but not yet freed.
+  size_t retired() {
+    std::lock_guard<std::mutex> guard(_lock);
+    size_t total = _pending.size();
+    for (const Batch& batch : _batches) {
+      total += batch.objects.size();
+    }
+    return total;
+  }
+
+};
+
+// A read section for as long as it lives.
+class EpochGuard {
+
+  private:
+  EpochDomain::Reader& _reader;
+
+  public:
+  explicit EpochGuard(EpochDomain::Reader& reader) noexcept : _reader(reader) {
+    _reader.enter();
+  }
+
+  EpochGuard(const EpochGuard&) = delete;
+  EpochGuard& operator=(const EpochGuard&) = delete;
+
+  ~EpochGuard() noexcept {
+    _reader.exit();
+  }
+
+};
+
+class RcuString {
+
+  private:
+  EpochDomain& _domain;
+  std::atomic<const SmallString*> _current;
+
+  public:
+  RcuString(EpochDomain& domain, SmallString initial)
+    : _domain(domain), _current(new SmallString(std::move(initial))) {}
+
+  RcuString(const RcuString&) = delete;
+  RcuString& operator=(const RcuString&) = delete;
+
+  // Readers are gone by now; the last value goes straight away.
+  ~RcuString() noexcept {
+    delete _current.load(std::memory_order_relaxed);
+  }
+
+  // Only to be called (and the result only used) inside a read section.
+  const SmallString& read() const noexcept {
+    return *_current.load(std::memory_order_acquire);
+  }
+
+  // Publishes a new value; the old one is retired.
+  void store(SmallString value) {
+    const SmallString* old = _current.exchange(new SmallString(std::move(value)), std::memory_order_seq_cst);
+    _domain.retire(const_cast<SmallString*>(old));
+  }
+
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+
+#include "frozen_string.hpp"
+
+using namespace std;
+
+// TESTS
+
+int main() {
+
+  SmallString source("a string long enough to need the fallback");
+  FrozenString frozen = source.freeze();
+  assert (frozen.length() == source.length());
+  assert (frozen.view() == "a string long enough to need the fallback");
+  assert (frozen.c_str()[frozen.length()] == '\0');
+  assert (frozen.hash() == hash_string(source));
+  assert (frozen[2] == 's');
+  assert (frozen.use_count() == 1);
+
+  // Freezing copies: changing the source changes nothing
+  source.append("!");
+  assert (frozen.length() + 1 == source.length());
+
+  // Copies share the block
+  FrozenString copy = frozen;
+  assert (frozen.use_count() == 2 && copy.c_str() == frozen.c_str());
+  copy = copy;
+  assert (frozen.use_count() == 2);
+  FrozenString moved = std::move(copy);
+  assert (frozen.use_count() == 2 && copy.length() == 0);
+  moved = FrozenString();
+  assert (frozen.use_count() == 1);
+
+  // Empty strings
+  FrozenString empty = SmallString().freeze();
+  assert (empty.length() == 0 && empty.use_count() == 0);
+  assert (string_view(empty.c_str()).empty());
+  assert (empty.hash() == hash_bytes("", 0));
+  assert (empty == FrozenString(string_view()));
+
+  bool thrown = false;
+  try {
+    empty[0];
+  }
+  catch (const std::out_of_range&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  // Back to a SmallString, '\0' included
+  FrozenString binary(string_view("a\0b", 3));
+  SmallString thawed = binary.thaw();
+  assert (thawed.length() == 3 && thawed[2] == 'b');
+  assert (binary.hash() == hash_string(thawed));
+  assert (binary == thawed.freeze());
+  assert (!(binary == frozen));
+
+  // Lookups by string_view
+  unordered_set<FrozenString, FrozenStringHash, FrozenStringEqual> set;
+  set.insert(frozen);
+  set.insert(SmallString("short").freeze());
+  assert (set.count(string_view("short")) == 1);
+  assert (set.count(frozen.view()) == 1);
+  assert (set.count(string_view("shorT")) == 0);
+
+  // Shared by threads that copy and drop it all the time
+  FrozenString shared = SmallString("shared between all of the threads, read only").freeze();
+  vector<thread> threads;
+  for (size_t t = 0; t < 4; ++t) {
+    threads.emplace_back([shared]() {
+      for (size_t i = 0; i < 20000; ++i) {
+        FrozenString local = shared;
+        assert (local.length() == 44 && local[0] == 's');
+        assert (local.hash() == hash_string(local.view()));
+      }
+    });
+  }
+  for (thread& t : threads) {
+    t.join();
+  }
+  assert (shared.use_count() == 1);
+
+  return 0;
+
+}
@@ -0,0 +1,199 @@
+#ifndef FROZEN_STRING_HPP
+#define FROZEN_STRING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string_view>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+FrozenString:
+An immutable string made once (SmallString::freeze(), or from a
+string_view) and then shared by any number of threads.
+
+Everything lives in one allocation: a header with the reference count,
+the length and the hash (computed once, at freezing time), followed by
+the chars and a '\0'. Copying a FrozenString only bumps the count, and
+the last one out frees the block. Since nothing in the block changes
+after it's built, reading it needs no synchronization at all; only the
+count is atomic.
+
+The empty string is a null block, so it costs no allocation.
+
+The hash is hash_string's, so frozen strings can be looked up by
+string_view (or SmallString) in the same containers.
+*/
+
+class FrozenString {
+
+  struct Block {
+    std::atomic<size_t> references;
+    size_t length;
+    uint64_t hash;
+
+    char* chars() noexcept {
+      return reinterpret_cast<char*>(this + 1);
+    }
+  };
+
+  private:
+  Block* _block;
+
+    static Block* allocate(size_t length) {
+      void* memory = ::operator new(sizeof(Block) + length + 1);
+      Block* block = new (memory) Block;
+      block->references.store(1, std::memory_order_relaxed);
+      block->length = length;
+      block->chars()[length] = '\0';
+      return block;
+    }
+
+    void release() noexcept {
+      // The last reference frees the block; acq_rel so the freeing thread
+      // sees everything the others did with it.
+      if (_block != nullptr && _block->references.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        _block->~Block();
+        ::operator delete(_block);
+      }
+      _block = nullptr;
+    }
+
+  public:
+  FrozenString() noexcept : _block(nullptr) {}
+
+  explicit FrozenString(std::string_view s) : _block(nullptr) {
+    if (!s.empty()) {
+      _block = allocate(s.size());
+      std::memcpy(_block->chars(), s.data(), s.size());
+      _block->hash = hash_string(s);
+    }
+  }
+
+  explicit FrozenString(const SmallString& s) : _block(nullptr) {
+    if (s.length() != 0) {
+      _block = allocate(s.length());
+      std::memcpy(_block->chars(), s.inline_data(), s.inline_length());
+      if (s.spilled_length() != 0) {
+        std::memcpy(_block->chars() + s.inline_length(), s.spilled_data(), s.spilled_length());
+      }
+      _block->hash = hash_string(s);
+    }
+  }
+
+  FrozenString(const FrozenString& other) noexcept : _block(other._block) {
+    if (_block != nullptr) {
+      _block->references.fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  FrozenString(FrozenString&& other) noexcept : _block(other._block) {
+    other._block = nullptr;
+  }
+
+  FrozenString& operator=(const FrozenString& rhs) noexcept {
+    // Taking the new reference first makes self-assignment harmless.
+    Block* block = rhs._block;
+    if (block != nullptr) {
+      block->references.fetch_add(1, std::memory_order_relaxed);
+    }
+    release();
+    _block = block;
+    return *this;
+  }
+
+  FrozenString& operator=(FrozenString&& rhs) noexcept {
+    if (this != &rhs) {
+      release();
+      _block = rhs._block;
+      rhs._block = nullptr;
+    }
+    return *this;
+  }
+
+  ~FrozenString() noexcept {
+    release();
+  }
+
+  size_t length() const noexcept {
+    return (_block == nullptr) ? 0 : _block->length;
+  }
+
+  // Always '\0' terminated.
+  const char* c_str() const noexcept {
+    return (_block == nullptr) ? "" : _block->chars();
+  }
+
+  std::string_view view() const noexcept {
+    return std::string_view(c_str(), length());
+  }
+
+  uint64_t hash() const noexcept {
+    return (_block == nullptr) ? hash_bytes("", 0) : _block->hash;
+  }
+
+  const char& operator[](size_t i) const {
+    if (i >= length()) {
+      throw std::out_of_range("Index outside of the bounds!");
+    }
+    return _block->chars()[i];
+  }
+
+  // How many FrozenStrings share this one's block (0 when empty).
+  size_t use_count() const noexcept {
+    return (_block == nullptr) ? 0 : _block->references.load(std::memory_order_relaxed);
+  }
+
+  // A mutable copy.
+  SmallString thaw() const {
+    return SmallString(c_str(), length());
+  }
+
+  friend bool operator==(const FrozenString& a, const FrozenString& b) noexcept {
+    if (a._block == b._block) {
+      return true;
+    }
+    return a.hash() == b.hash() && a.view() == b.view();
+  }
+
+};
+
+inline FrozenString SmallString::freeze() const {
+  return FrozenString(*this);
+}
+
+// Uses the precomputed hash; transparent, like SmallStringHash.
+struct FrozenStringHash {
+  using is_transparent = void;
+
+  size_t operator()(const FrozenString& s) const noexcept {
+    return s.hash();
+  }
+
+  size_t operator()(std::string_view s) const noexcept {
+    return hash_string(s);
+  }
+};
+
+struct FrozenStringEqual {
+  using is_transparent = void;
+
+  bool operator()(const FrozenString& a, const FrozenString& b) const noexcept {
+    return a == b;
+  }
+
+  bool operator()(const FrozenString& a, std::string_view b) const noexcept {
+    return a.view() == b;
+  }
+
+  bool operator()(std::string_view a, const FrozenString& b) const noexcept {
+    return a == b.view();
+  }
+};
+
+#endif
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "group_by.hpp"
+
+using namespace std;
+
+struct MinMax {
+  int64_t low = INT64_MAX;
+  int64_t high = INT64_MIN;
+
+  void add(int64_t value) noexcept {
+    low = std::min(low, value);
+    high = std::max(high, value);
+  }
+
+  void merge(const MinMax& other) noexcept {
+    low = std::min(low, other.low);
+    high = std::max(high, other.high);
+  }
+};
+
+// TESTS
+
+int main() {
+
+  // Short keys, keys just around INLINE_KEY and keys that spill.
+  vector<SmallString> keys;
+  vector<int64_t> values;
+  map<string, pair<int64_t, uint64_t>> expected;
+
+  uint64_t x = 7;
+  for (size_t i = 0; i < 100000; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    size_t k = (x >> 33) % 3000;
+    string key = (k % 3 == 0) ? to_string(k) : (k % 3 == 1 ? "sixteen-bytes-" + to_string(k % 100)
+                                                             : "a key long enough to spill/" + to_string(k));
+    int64_t value = static_cast<int64_t>(x >> 40) - (1 << 23);
+
+    keys.push_back(SmallString(key.c_str()));
+    values.push_back(value);
+    expected[key].first += value;
+    ++expected[key].second;
+  }
+  keys.push_back(SmallString(""));
+  values.push_back(5);
+  expected[""] = make_pair(5, 1);
+
+  GroupBy<> grouped;
+  grouped.add(span<const SmallString>(keys).first(5000), span<const int64_t>(values).first(5000));
+  for (size_t i = 5000; i < 10000; ++i) {
+    grouped.add(keys[i], values[i]);
+  }
+  grouped.add(span<const SmallString>(keys).subspan(10000), span<const int64_t>(values).subspan(10000));
+
+  assert (grouped.size() == expected.size());
+  size_t visited = 0;
+  grouped.for_each([&](string_view key, const SumCount& aggregate) {
+    const auto& wanted = expected.at(string(key));
+    assert (aggregate.sum == wanted.first && aggregate.count == wanted.second);
+    ++visited;
+  });
+  assert (visited == expected.size());
+  assert (grouped.find("no such key") == nullptr);
+  assert (grouped.find("a key long enough to spill/2")->count == expected["a key long enough to spill/2"].second);
+
+  // Merging two halves gives the whole
+  GroupBy<> first_half;
+  GroupBy<> second_half(4);
+  first_half.add(span<const SmallString>(keys).first(50000), span<const int64_t>(values).first(50000));
+  second_half.add(span<const SmallString>(keys).subspan(50000), span<const int64_t>(values).subspan(50000));
+  first_half.merge(second_half);
+  assert (first_half.size() == expected.size());
+  for (const auto& entry : expected) {
+    assert (first_half.find(entry.first)->sum == entry.second.first);
+  }
+
+  // Parallel, with a couple of thread counts
+  for (size_t threads : {1, 3, 4}) {
+    vector<GroupBy<>> partitions = parallel_group_by(keys, values, threads);
+    assert (partitions.size() >= threads);
+
+    size_t groups = 0;
+    for (const GroupBy<>& partition : partitions) {
+      groups += partition.size();
+      partition.for_each([&](string_view key, const SumCount& aggregate) {
+        const auto& wanted = expected.at(string(key));
+        assert (aggregate.sum == wanted.first && aggregate.count == wanted.second);
+      });
+    }
+    assert (groups == expected.size());
+  }
+
+  // Other aggregates
+  vector<GroupBy<MinMax>> ranges = parallel_group_by<MinMax>(keys, values, 2);
+  const MinMax* range = nullptr;
+  for (const GroupBy<MinMax>& partition : ranges) {
+    if (partition.find("") != nullptr) {
+      range = partition.find("");
+    }
+  }
+  assert (range != nullptr && range->low == 5 && range->high == 5);
+
+  bool thrown = false;
+  try {
+    grouped.add(span<const SmallString>(keys).first(2), span<const int64_t>(values).first(1));
+  }
+  catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  return 0;
+
+}
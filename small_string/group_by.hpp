@@ -0,0 +1,334 @@
+#ifndef GROUP_BY_HPP
+#define GROUP_BY_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+GroupBy:
+Hash aggregation (GROUP BY key, with sums and counts) over batches of
+SmallString keys and int64 values.
+
+A batch is worked through in chunks of BATCH rows: first every key of
+the chunk is hashed (in place, no copies), and the table slot it will
+probe is prefetched; only then are the rows looked up, so the cache
+misses of a chunk overlap.
+
+The table is open addressing (linear probing) over 16-byte slots that
+hold the full hash and the group's index, so almost every mismatch is
+rejected without touching a key. Groups store their key inline when it
+fits in INLINE_KEY bytes, and in a shared byte arena otherwise.
+
+parallel_group_by splits the rows between threads. Every thread builds
+one table per partition (picked by the top bits of the hash), and then
+partition p of all the threads is merged by one thread. Partitions hold
+disjoint keys, so the result is the list of merged partitions.
+
+The Aggregate needs add(int64_t) and merge(const Aggregate&).
+*/
+
+struct SumCount {
+  int64_t sum = 0;
+  uint64_t count = 0;
+
+  void add(int64_t value) noexcept {
+    sum += value;
+    ++count;
+  }
+
+  void merge(const SumCount& other) noexcept {
+    sum += other.sum;
+    count += other.count;
+  }
+};
+
+template <typename Aggregate = SumCount>
+class GroupBy {
+
+  static constexpr size_t BATCH = 32;
+  static constexpr size_t INLINE_KEY = 16;
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  struct Slot {
+    uint64_t hash;
+    uint32_t group;
+  };
+
+  struct Group {
+    uint64_t hash;
+    size_t length;
+    union {
+      char bytes[INLINE_KEY];
+      size_t offset; // in the arena
+    } key;
+    Aggregate aggregate;
+  };
+
+  private:
+  std::vector<Slot> _slots;
+  size_t _mask;
+  std::vector<Group> _groups;
+  std::vector<char> _arena;
+
+    std::string_view key_of(const Group& group) const noexcept {
+      if (group.length <= INLINE_KEY) {
+        return std::string_view(group.key.bytes, group.length);
+      }
+      return std::string_view(_arena.data() + group.key.offset, group.length);
+    }
+
+    // Copies the segments of s to out (which has room for all of them).
+    static void copy_key(const SmallString& s, char* out) noexcept {
+      std::memcpy(out, s.inline_data(), s.inline_length());
+      if (s.spilled_length() != 0) {
+        std::memcpy(out + s.inline_length(), s.spilled_data(), s.spilled_length());
+      }
+    }
+
+    void grow() {
+      std::vector<Slot> slots(_slots.size() * 2, Slot{0, EMPTY});
+      size_t mask = slots.size() - 1;
+
+      for (uint32_t g = 0; g < _groups.size(); ++g) {
+        size_t i = _groups[g].hash & mask;
+        while (slots[i].group != EMPTY) {
+          i = (i + 1) & mask;
+        }
+        slots[i] = Slot{_groups[g].hash, g};
+      }
+
+      _slots.swap(slots);
+      _mask = mask;
+    }
+
+    // The group of the key (a SmallString or a string_view), created if
+    // it's new.
+    template <typename Key>
+    Aggregate& group_of(const Key& key, uint64_t hash) {
+      size_t i = hash & _mask;
+
+      while (_slots[i].group != EMPTY) {
+        if (_slots[i].hash == hash) {
+          Group& group = _groups[_slots[i].group];
+          if (same_key(group, key)) {
+            return group.aggregate;
+          }
+        }
+        i = (i + 1) & _mask;
+      }
+
+      uint32_t index = static_cast<uint32_t>(_groups.size());
+      _groups.push_back(Group{hash, length_of(key), {}, Aggregate{}});
+      Group& group = _groups.back();
+      if (group.length <= INLINE_KEY) {
+        store(key, group.key.bytes);
+      }
+      else {
+        group.key.offset = _arena.size();
+        _arena.resize(_arena.size() + group.length);
+        store(key, _arena.data() + group.key.offset);
+      }
+      _slots[i] = Slot{hash, index};
+
+      // Kept at most half full; growing moves the slots, not the groups.
+      if (_groups.size() * 2 > _slots.size()) {
+        grow();
+      }
+      return _groups[index].aggregate;
+    }
+
+    static size_t length_of(const SmallString& key) noexcept {
+      return key.length();
+    }
+
+    static size_t length_of(std::string_view key) noexcept {
+      return key.size();
+    }
+
+    bool same_key(const Group& group, const SmallString& key) const noexcept {
+      return group.length == key.length() && equals(key, key_of(group));
+    }
+
+    bool same_key(const Group& group, std::string_view key) const noexcept {
+      return key_of(group) == key;
+    }
+
+    static void store(const SmallString& key, char* out) noexcept {
+      copy_key(key, out);
+    }
+
+    static void store(std::string_view key, char* out) noexcept {
+      if (!key.empty()) {
+        std::memcpy(out, key.data(), key.size());
+      }
+    }
+
+  public:
+  explicit GroupBy(size_t expected_groups = 16) {
+    size_t slots = 16;
+    while (slots < 2 * expected_groups) {
+      slots <<= 1;
+    }
+    _slots.assign(slots, Slot{0, EMPTY});
+    _mask = slots - 1;
+    _groups.reserve(expected_groups);
+  }
+
+  size_t size() const noexcept {
+    return _groups.size();
+  }
+
+  // Adds one row.
+  void add(const SmallString& key, int64_t value) {
+    group_of(key, hash_string(key)).add(value);
+  }
+
+  // For callers that already have hash_string(key): a row goes in with
+  // add_hashed, and prefetch gets its slot on the way.
+  void add_hashed(const SmallString& key, uint64_t hash, int64_t value) {
+    group_of(key, hash).add(value);
+  }
+
+  void prefetch(uint64_t hash) const noexcept {
+    __builtin_prefetch(&_slots[hash & _mask]);
+  }
+
+  // Adds rows (keys[i], values[i]).
+  void add(std::span<const SmallString> keys, std::span<const int64_t> values) {
+    if (keys.size() != values.size()) {
+      throw std::invalid_argument("Keys and values differ in length");
+    }
+
+    uint64_t hashes[BATCH];
+    for (size_t begin = 0; begin < keys.size(); begin += BATCH) {
+      size_t count = (keys.size() - begin < BATCH) ? keys.size() - begin : BATCH;
+
+      for (size_t i = 0; i < count; ++i) {
+        hashes[i] = hash_string(keys[begin + i]);
+        prefetch(hashes[i]);
+      }
+      for (size_t i = 0; i < count; ++i) {
+        group_of(keys[begin + i], hashes[i]).add(values[begin + i]);
+      }
+    }
+  }
+
+  // The aggregate of a key, or nullptr if no row had it.
+  const Aggregate* find(std::string_view key) const noexcept {
+    uint64_t hash = hash_string(key);
+    for (size_t i = hash & _mask; _slots[i].group != EMPTY; i = (i + 1) & _mask) {
+      const Group& group = _groups[_slots[i].group];
+      if (_slots[i].hash == hash && key_of(group) == key) {
+        return &group.aggregate;
+      }
+    }
+    return nullptr;
+  }
+
+  // Folds other in (it is left as it was).
+  void merge(const GroupBy& other) {
+    for (const Group& group : other._groups) {
+      group_of(other.key_of(group), group.hash).merge(group.aggregate);
+    }
+  }
+
+  // Calls f(key, aggregate) for every group, in order of appearance. The
+  // view is only good until the next change to the table.
+  template <typename F>
+  void for_each(F f) const {
+    for (const Group& group : _groups) {
+      f(key_of(group), group.aggregate);
+    }
+  }
+
+};
+
+/*
+The rows split into `threads` contiguous runs; the result has one
+GroupBy per partition, and every key is in exactly one of them.
+*/
+template <typename Aggregate = SumCount>
+std::vector<GroupBy<Aggregate>> parallel_group_by(std::span<const SmallString> keys, std::span<const int64_t> values,
+                                                  size_t threads) {
+  if (keys.size() != values.size()) {
+    throw std::invalid_argument("Keys and values differ in length");
+  }
+  if (threads == 0) {
+    threads = 1;
+  }
+
+  // At least as many partitions as threads, as a power of two.
+  size_t bits = 0;
+  while ((size_t(1) << bits) < threads) {
+    ++bits;
+  }
+  size_t partitions = size_t(1) << bits;
+
+  auto partition_of = [bits](uint64_t hash) -> size_t {
+    return (bits == 0) ? 0 : static_cast<size_t>(hash >> (64 - bits));
+  };
+
+  // Phase 1: every thread aggregates its run into its own partitions.
+  std::vector<std::vector<GroupBy<Aggregate>>> local(threads);
+  std::vector<std::thread> workers;
+  size_t per_thread = (keys.size() + threads - 1) / threads;
+
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      std::vector<GroupBy<Aggregate>>& tables = local[t];
+      tables.resize(partitions);
+
+      size_t first = std::min(keys.size(), t * per_thread);
+      size_t last = std::min(keys.size(), first + per_thread);
+
+      // Hash a chunk and prefetch, then insert, like GroupBy::add.
+      const size_t CHUNK = 32;
+      uint64_t hashes[CHUNK];
+      for (size_t begin = first; begin < last; begin += CHUNK) {
+        size_t count = std::min(CHUNK, last - begin);
+
+        for (size_t i = 0; i < count; ++i) {
+          hashes[i] = hash_string(keys[begin + i]);
+          tables[partition_of(hashes[i])].prefetch(hashes[i]);
+        }
+        for (size_t i = 0; i < count; ++i) {
+          tables[partition_of(hashes[i])].add_hashed(keys[begin + i], hashes[i], values[begin + i]);
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+  workers.clear();
+
+  // Phase 2: partition p of every thread gets merged into thread 0's.
+  std::vector<GroupBy<Aggregate>> result(partitions);
+  for (size_t t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t]() {
+      for (size_t p = t; p < partitions; p += threads) {
+        result[p] = std::move(local[0][p]);
+        for (size_t other = 1; other < threads; ++other) {
+          result[p].merge(local[other][p]);
+        }
+      }
+    });
+  }
+  for (std::thread& worker : workers) {
+    worker.join();
+  }
+
+  return result;
+}
+
+#endif
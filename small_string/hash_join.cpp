@@ -0,0 +1,83 @@
+#include <iostream>
+#include <algorithm>
+#include <cassert>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "hash_join.hpp"
+
+using namespace std;
+
+// All the pairs, the slow way.
+static vector<pair<uint32_t, uint32_t>> nested_loops(const vector<SmallString>& build, const vector<SmallString>& probe) {
+  multimap<string, uint32_t> index;
+  for (uint32_t i = 0; i < build.size(); ++i) {
+    index.insert(make_pair(build[i].str(), i));
+  }
+
+  vector<pair<uint32_t, uint32_t>> pairs;
+  for (uint32_t j = 0; j < probe.size(); ++j) {
+    auto range = index.equal_range(probe[j].str());
+    for (auto it = range.first; it != range.second; ++it) {
+      pairs.push_back(make_pair(it->second, j));
+    }
+  }
+  sort(pairs.begin(), pairs.end());
+  return pairs;
+}
+
+static vector<pair<uint32_t, uint32_t>> sorted(const vector<JoinPair>& pairs) {
+  vector<pair<uint32_t, uint32_t>> result;
+  for (const JoinPair& p : pairs) {
+    result.push_back(make_pair(p.build_row, p.probe_row));
+  }
+  sort(result.begin(), result.end());
+  return result;
+}
+
+// TESTS
+
+int main() {
+
+  // Keys that agree on their first 8 bytes, and on everything but the
+  // last byte, plus duplicates on both sides.
+  vector<SmallString> build;
+  vector<SmallString> probe;
+  vector<uint32_t> build_ids;
+  vector<uint32_t> probe_ids;
+  for (size_t i = 0; i < 40000; ++i) {
+    size_t k = i % 30000;
+    string key = (k % 4 == 0) ? to_string(k) : "customer/000000000000000000000/" + to_string(k);
+    build.push_back(SmallString(key.c_str()));
+    build_ids.push_back(static_cast<uint32_t>(k));
+  }
+  for (size_t i = 0; i < 100000; ++i) {
+    size_t k = (i * 7919) % 60000;
+    string key = (k % 4 == 0) ? to_string(k) : "customer/000000000000000000000/" + to_string(k);
+    probe.push_back(SmallString(key.c_str()));
+    probe_ids.push_back(static_cast<uint32_t>(k));
+  }
+  probe.push_back(SmallString(""));
+  probe_ids.push_back(123456789);
+  build.push_back(SmallString(""));
+  build_ids.push_back(123456789);
+
+  vector<pair<uint32_t, uint32_t>> expected = nested_loops(build, probe);
+  assert (!expected.empty());
+
+  for (size_t threads : {1, 2, 3, 8}) {
+    assert (sorted(hash_join(build, probe, threads)) == expected);
+    assert (sorted(hash_join(build_ids, probe_ids, threads)) == expected);
+  }
+
+  // Degenerate sides
+  assert (hash_join(span<const SmallString>(), probe).empty());
+  assert (hash_join(build, span<const SmallString>(), 4).empty());
+
+  vector<SmallString> same(1000, SmallString("same key, long enough to be in the fallback"));
+  assert (hash_join(same, span<const SmallString>(same).first(10), 2).size() == 10000);
+
+  return 0;
+
+}
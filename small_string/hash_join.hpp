@@ -0,0 +1,268 @@
+#ifndef HASH_JOIN_HPP
+#define HASH_JOIN_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <thread>
+#include <vector>
+
+#include <unistd.h>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+Hash join:
+Equi-joins two columns of keys (SmallStrings, or interned uint32 ids),
+returning the matching (build row, probe row) pairs in no particular
+order. Rows are uint32 indices, so each side has fewer than 2^32.
+
+1. Every row becomes a JoinEntry: its hash, its first 8 bytes and its
+   length. This is the only pass that reads the strings.
+2. Both sides are radix-partitioned on the top bits of the hash, with as
+   many partitions as it takes for one build partition and its table to
+   fit in half the L2 cache. Threads histogram, then scatter, their own
+   runs of rows.
+3. Threads grab whole partitions (an atomic counter hands them out) and
+   join them independently: a chained table over the build partition,
+   walked by every probe entry of the same partition.
+
+Candidates are checked by hash, prefix and length first; keys of up to 8
+bytes are then known to be equal, and only longer ones get the full
+compare, which is the only time a Fallback is read.
+*/
+
+struct JoinPair {
+  uint32_t build_row;
+  uint32_t probe_row;
+};
+
+struct JoinEntry {
+  uint64_t hash;
+  uint64_t prefix;
+  uint32_t row;
+  uint32_t length;
+};
+
+// The first (up to) 8 bytes of s, zero padded, straight from the buffer.
+inline uint64_t inline_prefix(const SmallString& s) noexcept {
+  uint64_t prefix = 0;
+  size_t n = (s.inline_length() < 8) ? s.inline_length() : 8;
+  if (n != 0) {
+    std::memcpy(&prefix, s.inline_data(), n);
+  }
+  return prefix;
+}
+
+class HashJoin {
+
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+  static constexpr size_t MAX_BITS = 14;
+
+  private:
+    template <typename F>
+    static void run_threads(size_t threads, F f) {
+      if (threads == 1) {
+        f(0);
+        return;
+      }
+
+      std::vector<std::thread> workers;
+      for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back(f, t);
+      }
+      for (std::thread& worker : workers) {
+        worker.join();
+      }
+    }
+
+    static size_t l2_bytes() noexcept {
+      long bytes = sysconf(_SC_LEVEL2_CACHE_SIZE);
+      return (bytes > 0) ? static_cast<size_t>(bytes) : 256 * 1024;
+    }
+
+    // Partition bits so that a build partition (entries plus its table,
+    // about 32 bytes a row) takes at most half of L2.
+    static size_t partition_bits(size_t build_rows) noexcept {
+      size_t budget = l2_bytes() / 2;
+      size_t bits = 0;
+      while (bits < MAX_BITS && (build_rows >> bits) * 32 > budget) {
+        ++bits;
+      }
+      return bits;
+    }
+
+    static size_t partition_of(uint64_t hash, size_t bits) noexcept {
+      return (bits == 0) ? 0 : static_cast<size_t>(hash >> (64 - bits));
+    }
+
+    // Scatters in into partitions; offsets[p] is where partition p
+    // starts (offsets has one more element, the total).
+    static std::vector<JoinEntry> partition(const std::vector<JoinEntry>& in, size_t bits, size_t threads,
+                                            std::vector<size_t>& offsets) {
+      size_t partitions = size_t(1) << bits;
+      size_t per_thread = (in.size() + threads - 1) / threads;
+      std::vector<std::vector<size_t>> histograms(threads, std::vector<size_t>(partitions, 0));
+
+      run_threads(threads, [&](size_t t) {
+        size_t begin = std::min(in.size(), t * per_thread);
+        size_t end = std::min(in.size(), begin + per_thread);
+        for (size_t i = begin; i < end; ++i) {
+          ++histograms[t][partition_of(in[i].hash, bits)];
+        }
+      });
+
+      // Partition by partition, thread by thread: each thread writes its
+      // rows of a partition to its own range.
+      offsets.assign(partitions + 1, 0);
+      std::vector<std::vector<size_t>> cursors(threads, std::vector<size_t>(partitions, 0));
+      size_t total = 0;
+      for (size_t p = 0; p < partitions; ++p) {
+        offsets[p] = total;
+        for (size_t t = 0; t < threads; ++t) {
+          cursors[t][p] = total;
+          total += histograms[t][p];
+        }
+      }
+      offsets[partitions] = total;
+
+      std::vector<JoinEntry> out(in.size());
+      run_threads(threads, [&](size_t t) {
+        size_t begin = std::min(in.size(), t * per_thread);
+        size_t end = std::min(in.size(), begin + per_thread);
+        std::vector<size_t>& cursor = cursors[t];
+        for (size_t i = begin; i < end; ++i) {
+          out[cursor[partition_of(in[i].hash, bits)]++] = in[i];
+        }
+      });
+
+      return out;
+    }
+
+    template <typename Key, typename MakeEntry>
+    static std::vector<JoinEntry> entries(std::span<const Key> keys, size_t threads, MakeEntry make) {
+      std::vector<JoinEntry> out(keys.size());
+      size_t per_thread = (keys.size() + threads - 1) / threads;
+
+      run_threads(threads, [&](size_t t) {
+        size_t begin = std::min(keys.size(), t * per_thread);
+        size_t end = std::min(keys.size(), begin + per_thread);
+        for (size_t i = begin; i < end; ++i) {
+          out[i] = make(keys[i], static_cast<uint32_t>(i));
+        }
+      });
+
+      return out;
+    }
+
+    // equal(build_row, probe_row) settles the candidates longer than 8 bytes.
+    template <typename Equal>
+    static std::vector<JoinPair> join(const std::vector<JoinEntry>& build_entries,
+                                      const std::vector<JoinEntry>& probe_entries, size_t threads, Equal equal) {
+      size_t bits = partition_bits(build_entries.size());
+      std::vector<size_t> build_offsets;
+      std::vector<size_t> probe_offsets;
+      std::vector<JoinEntry> build = partition(build_entries, bits, threads, build_offsets);
+      std::vector<JoinEntry> probe = partition(probe_entries, bits, threads, probe_offsets);
+
+      size_t partitions = size_t(1) << bits;
+      std::atomic<size_t> next_partition(0);
+      std::vector<std::vector<JoinPair>> results(threads);
+
+      run_threads(threads, [&](size_t t) {
+        std::vector<uint32_t> heads;
+        std::vector<uint32_t> chain;
+        std::vector<JoinPair>& out = results[t];
+
+        for (size_t p = next_partition++; p < partitions; p = next_partition++) {
+          size_t build_begin = build_offsets[p];
+          size_t rows = build_offsets[p + 1] - build_begin;
+          if (rows == 0) {
+            continue;
+          }
+
+          size_t buckets = 1;
+          while (buckets < rows) {
+            buckets <<= 1;
+          }
+          size_t mask = buckets - 1;
+          heads.assign(buckets, EMPTY);
+          chain.resize(rows);
+
+          // The low bits of the hash; the top ones are the partition.
+          for (uint32_t i = 0; i < rows; ++i) {
+            size_t bucket = build[build_begin + i].hash & mask;
+            chain[i] = heads[bucket];
+            heads[bucket] = i;
+          }
+
+          for (size_t j = probe_offsets[p]; j < probe_offsets[p + 1]; ++j) {
+            const JoinEntry& row = probe[j];
+            for (uint32_t i = heads[row.hash & mask]; i != EMPTY; i = chain[i]) {
+              const JoinEntry& candidate = build[build_begin + i];
+              if (candidate.hash == row.hash && candidate.prefix == row.prefix && candidate.length == row.length &&
+                  (row.length <= 8 || equal(candidate.row, row.row))) {
+                out.push_back(JoinPair{candidate.row, row.row});
+              }
+            }
+          }
+        }
+      });
+
+      size_t total = 0;
+      for (const std::vector<JoinPair>& part : results) {
+        total += part.size();
+      }
+      std::vector<JoinPair> pairs;
+      pairs.reserve(total);
+      for (const std::vector<JoinPair>& part : results) {
+        pairs.insert(pairs.end(), part.begin(), part.end());
+      }
+      return pairs;
+    }
+
+  public:
+  static std::vector<JoinPair> run(std::span<const SmallString> build, std::span<const SmallString> probe,
+                                   size_t threads = 1) {
+    auto make = [](const SmallString& key, uint32_t row) {
+      return JoinEntry{hash_string(key), inline_prefix(key), row, static_cast<uint32_t>(key.length())};
+    };
+
+    threads = (threads == 0) ? 1 : threads;
+    auto equal = [&](uint32_t build_row, uint32_t probe_row) {
+      return compare(build[build_row], probe[probe_row]) == 0;
+    };
+    return join(entries(build, threads, make), entries(probe, threads, make), threads, equal);
+  }
+
+  // Keys that were interned to ids: the id is the whole key.
+  static std::vector<JoinPair> run(std::span<const uint32_t> build, std::span<const uint32_t> probe,
+                                   size_t threads = 1) {
+    auto make = [](uint32_t id, uint32_t row) {
+      return JoinEntry{hash_mix(id ^ 0x9e3779b97f4a7c15ULL, 0xe7037ed1a0b428dbULL), id, row, 0};
+    };
+
+    threads = (threads == 0) ? 1 : threads;
+    auto equal = [](uint32_t, uint32_t) {
+      return true;
+    };
+    return join(entries(build, threads, make), entries(probe, threads, make), threads, equal);
+  }
+
+};
+
+inline std::vector<JoinPair> hash_join(std::span<const SmallString> build, std::span<const SmallString> probe,
+                                       size_t threads = 1) {
+  return HashJoin::run(build, probe, threads);
+}
+
+inline std::vector<JoinPair> hash_join(std::span<const uint32_t> build, std::span<const uint32_t> probe,
+                                       size_t threads = 1) {
+  return HashJoin::run(build, probe, threads);
+}
+
+#endif
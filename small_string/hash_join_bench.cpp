@@ -0,0 +1,75 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "hash_join.hpp"
+
+using namespace std;
+
+/*
+hash_join at 1, 2, 4, ... threads (up to twice the cores), on a 2M-row
+build side and an 8M-row probe side where every probe row finds one
+match, against a plain unordered_multimap join on one thread.
+*/
+
+static volatile size_t sink;
+
+template <typename F>
+static double time_ms(F f) {
+  auto start = chrono::steady_clock::now();
+  sink = f();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+
+  const size_t BUILD = 2000000;
+  const size_t PROBE = 8000000;
+
+  vector<SmallString> build;
+  for (size_t k = 0; k < BUILD; ++k) {
+    string key = (k % 2 == 0) ? "order-" + to_string(k) : "customer/region-eu/account/" + to_string(k);
+    build.push_back(SmallString(key.c_str()));
+  }
+
+  vector<SmallString> probe;
+  for (size_t i = 0; i < PROBE; ++i) {
+    probe.push_back(build[(i * 2654435761u) % BUILD]);
+  }
+
+  double baseline = time_ms([&]() {
+    unordered_multimap<SmallString, uint32_t, SmallStringHash, SmallStringEqual> index;
+    for (uint32_t i = 0; i < build.size(); ++i) {
+      index.emplace(build[i], i);
+    }
+
+    size_t matches = 0;
+    for (const SmallString& key : probe) {
+      auto range = index.equal_range(key);
+      for (auto it = range.first; it != range.second; ++it) {
+        ++matches;
+      }
+    }
+    return matches;
+  });
+  cout << "unordered_multimap, 1 thread: " << baseline << " ms" << endl;
+
+  size_t cores = thread::hardware_concurrency();
+  size_t most = 2 * ((cores == 0) ? 1 : cores);
+  double one = 0;
+  for (size_t threads = 1; threads <= most; threads *= 2) {
+    double elapsed = time_ms([&]() {
+      return hash_join(build, probe, threads).size();
+    });
+    if (threads == 1) {
+      one = elapsed;
+    }
+    cout << "hash_join, " << threads << " thread(s): " << elapsed << " ms (speedup " << one / elapsed << ")" << endl;
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,143 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <string_view>
+#include <unordered_set>
+#include <vector>
+
+#include "membership_filters.hpp"
+
+using namespace std;
+
+static SmallString make(const string& prefix, size_t n) {
+  return SmallString((prefix + to_string(n)).c_str());
+}
+
+// TESTS
+
+int main() {
+
+  // The hash doesn't care about segmentation
+  string text = "the quick brown fox jumps over the lazy dog";
+  for (size_t n = 0; n <= text.size(); ++n) {
+    SmallString s(text.substr(0, n).c_str());
+    uint64_t expected = hash_bytes(text.data(), n);
+    assert (hash_string(s) == expected);
+    assert (hash_string(string_view(text.data(), n)) == expected);
+
+    for (size_t cut = 0; cut <= n; ++cut) {
+      StringHasher hasher;
+      hasher.update(text.data(), cut);
+      hasher.update(text.data() + cut, n - cut);
+      assert (hasher.finish() == expected);
+    }
+  }
+  assert (hash_bytes("a", 1) != hash_bytes("a\0", 2));
+  assert (hash_bytes("ab", 2, 1) != hash_bytes("ab", 2, 2));
+
+  // Heterogeneous lookups
+  unordered_set<SmallString, SmallStringHash, SmallStringEqual> set;
+  set.insert(SmallString("short"));
+  set.insert(SmallString("a key long enough to spill out of the buffer"));
+  assert (set.find(string_view("short")) != set.end());
+  assert (set.find(string_view("a key long enough to spill out of the buffer")) != set.end());
+  assert (set.find(string_view("a key long enough to spill out of the buffeR")) == set.end());
+
+  vector<SmallString> present;
+  vector<SmallString> absent;
+  for (size_t i = 0; i < 20000; ++i) {
+    present.push_back(make(i % 2 ? "user/" : "a much longer key for user number ", i));
+    absent.push_back(make(i % 2 ? "other/" : "a much longer key for someone else, number ", i));
+  }
+
+  // Bloom filter
+  BlockedBloomFilter bloom(present.size(), 10);
+  assert (bloom.probes() == 7);
+  bloom.insert(span<const SmallString>(present).first(10000));
+  for (size_t i = 10000; i < present.size(); ++i) {
+    bloom.insert(present[i]);
+  }
+
+  Bitmap hits = bloom.contains(present);
+  assert (hits.count() == present.size());
+
+  Bitmap false_hits = bloom.contains(absent);
+  size_t false_positives = 0;
+  for (size_t i = 0; i < absent.size(); ++i) {
+    assert (false_hits.test(i) == bloom.contains(absent[i]));
+    false_positives += bloom.contains(absent[i]);
+  }
+  assert (false_positives < absent.size() * 2 / 100);
+
+  vector<uint8_t> image = bloom.serialize();
+  BlockedBloomFilter copy = BlockedBloomFilter::deserialize(image);
+  assert (copy.probes() == bloom.probes());
+  assert (copy.contains(absent).words == false_hits.words);
+  assert (copy.serialize() == image);
+
+  // Cuckoo filter
+  CuckooFilter cuckoo(present.size());
+  assert (cuckoo.insert(present) == present.size());
+  assert (cuckoo.size() == present.size());
+  assert (cuckoo.contains(present).count() == present.size());
+
+  false_positives = cuckoo.contains(absent).count();
+  assert (false_positives < absent.size() * 2 / 100);
+
+  for (size_t i = 0; i < present.size(); i += 2) {
+    assert (cuckoo.erase(present[i]));
+  }
+  assert (cuckoo.size() == present.size() / 2);
+  for (size_t i = 1; i < present.size(); i += 2) {
+    assert (cuckoo.contains(present[i]));
+  }
+  size_t still_there = 0;
+  for (size_t i = 0; i < present.size(); i += 2) {
+    still_there += cuckoo.contains(present[i]);
+  }
+  assert (still_there < present.size() / 100);
+
+  image = cuckoo.serialize();
+  CuckooFilter cuckoo_copy = CuckooFilter::deserialize(image);
+  assert (cuckoo_copy.size() == cuckoo.size());
+  assert (cuckoo_copy.contains(present).words == cuckoo.contains(present).words);
+
+  // Filling it up: inserts start failing, nothing is lost
+  CuckooFilter small(64);
+  size_t inserted = 0;
+  for (size_t i = 0; i < present.size() && small.insert(present[i]); ++i) {
+    ++inserted;
+  }
+  assert (inserted >= 64 && inserted <= small.size_in_bytes() / 2 + 1);
+  for (size_t i = 0; i < inserted; ++i) {
+    assert (small.contains(present[i]));
+  }
+  assert (small.erase(present[0]));
+  assert (small.size() == inserted - 1);
+  for (size_t i = 1; i < inserted; ++i) {
+    assert (small.contains(present[i]));
+  }
+
+  // Bad images
+  bool thrown = false;
+  try {
+    image.resize(image.size() - 1);
+    CuckooFilter::deserialize(image);
+  }
+  catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  thrown = false;
+  try {
+    BlockedBloomFilter::deserialize(cuckoo.serialize());
+  }
+  catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  return 0;
+
+}
@@ -0,0 +1,532 @@
+#ifndef MEMBERSHIP_FILTERS_HPP
+#define MEMBERSHIP_FILTERS_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "batch_filter.hpp"
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+Membership filters:
+Cheap "definitely not there / probably there" tests to put in front of
+expensive lookups. Both filters hash each key once (hash_string) and
+split the 64 bits into all the probes they need.
+
+BlockedBloomFilter: every key lands in a single 512-bit block (one cache
+line) and sets k bits inside it, so a query costs one cache miss no
+matter what k is.
+
+CuckooFilter: 16-bit fingerprints in buckets of four, each key having
+two candidate buckets. Slightly smaller than a Bloom filter at the same
+false positive rate, and it can erase keys (only ones that were really
+inserted, of course).
+
+The span versions hash a group of keys, prefetch all of their cache
+lines, and only then probe, so the misses overlap instead of queueing.
+
+serialize() writes a little-endian image (magic, format and hash
+versions, shape, then the table) that deserialize() reads back in any
+process; a mismatched or truncated image throws invalid_argument.
+*/
+
+inline void put_u32(std::vector<uint8_t>& out, uint32_t x) {
+  for (int i = 0; i < 4; ++i) {
+    out.push_back(static_cast<uint8_t>(x >> (8 * i)));
+  }
+}
+
+inline void put_u64(std::vector<uint8_t>& out, uint64_t x) {
+  for (int i = 0; i < 8; ++i) {
+    out.push_back(static_cast<uint8_t>(x >> (8 * i)));
+  }
+}
+
+// Reads little-endian integers off an image, checking the bounds.
+class ByteReader {
+
+  private:
+  std::span<const uint8_t> _bytes;
+  size_t _position;
+
+    uint64_t get(size_t n) {
+      if (_bytes.size() - _position < n) {
+        throw std::invalid_argument("Truncated image");
+      }
+
+      uint64_t x = 0;
+      for (size_t i = 0; i < n; ++i) {
+        x |= static_cast<uint64_t>(_bytes[_position + i]) << (8 * i);
+      }
+      _position += n;
+      return x;
+    }
+
+  public:
+  explicit ByteReader(std::span<const uint8_t> bytes) : _bytes(bytes), _position(0) {}
+
+  uint32_t u32() {
+    return static_cast<uint32_t>(get(4));
+  }
+
+  uint64_t u64() {
+    return get(8);
+  }
+
+  size_t remaining() const noexcept {
+    return _bytes.size() - _position;
+  }
+
+  // Checks the magic number and both versions.
+  void header(uint32_t magic, uint32_t version) {
+    if (u32() != magic) {
+      throw std::invalid_argument("Not a filter image of this kind");
+    }
+    if (u32() != version || u32() != HASH_VERSION) {
+      throw std::invalid_argument("Filter image from an incompatible version");
+    }
+  }
+};
+
+// Keys hashed and prefetched ahead of the probes in the span versions.
+const size_t PREFETCH_GROUP = 16;
+
+class BlockedBloomFilter {
+
+  static constexpr uint32_t MAGIC = 0x46424253; // "SBBF"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t MAX_PROBES = 16;
+
+  struct alignas(64) Block {
+    uint64_t words[8];
+  };
+
+  private:
+  std::vector<Block> _blocks;
+  size_t _probes;
+
+    BlockedBloomFilter(size_t blocks, size_t probes, bool) : _blocks(blocks, Block{}), _probes(probes) {}
+
+    // The high half picks the block (multiply-shift instead of a modulo).
+    size_t block_of(uint64_t hash) const noexcept {
+      return static_cast<size_t>(((hash >> 32) * static_cast<uint64_t>(_blocks.size())) >> 32);
+    }
+
+    // The low half makes the probes: bit i is the top 9 bits of
+    // h1 + i * h2 (double hashing).
+    void add(uint64_t hash) noexcept {
+      Block& block = _blocks[block_of(hash)];
+      uint32_t h1 = static_cast<uint32_t>(hash);
+      uint32_t h2 = ((h1 >> 16) | (h1 << 16)) | 1;
+
+      for (size_t i = 0; i < _probes; ++i) {
+        uint32_t bit = (h1 + static_cast<uint32_t>(i) * h2) >> 23;
+        block.words[bit / 64] |= uint64_t(1) << (bit % 64);
+      }
+    }
+
+    bool test(uint64_t hash) const noexcept {
+      const Block& block = _blocks[block_of(hash)];
+      uint32_t h1 = static_cast<uint32_t>(hash);
+      uint32_t h2 = ((h1 >> 16) | (h1 << 16)) | 1;
+
+      for (size_t i = 0; i < _probes; ++i) {
+        uint32_t bit = (h1 + static_cast<uint32_t>(i) * h2) >> 23;
+        if (((block.words[bit / 64] >> (bit % 64)) & 1) == 0) {
+          return false;
+        }
+      }
+      return true;
+    }
+
+  public:
+  // Sized for expected_keys at bits_per_key; 10 bits is about 1%.
+  explicit BlockedBloomFilter(size_t expected_keys, double bits_per_key = 10) {
+    if (!(bits_per_key > 0)) {
+      throw std::invalid_argument("bits_per_key must be positive");
+    }
+
+    double bits = static_cast<double>(expected_keys) * bits_per_key;
+    size_t blocks = static_cast<size_t>(std::ceil(bits / 512));
+    _blocks.assign(blocks == 0 ? 1 : blocks, Block{});
+
+    size_t probes = static_cast<size_t>(std::lround(bits_per_key * 0.6931));
+    _probes = (probes < 1) ? 1 : (probes > MAX_PROBES ? MAX_PROBES : probes);
+  }
+
+  size_t probes() const noexcept {
+    return _probes;
+  }
+
+  size_t size_in_bytes() const noexcept {
+    return _blocks.size() * sizeof(Block);
+  }
+
+  void insert(const SmallString& key) noexcept {
+    add(hash_string(key));
+  }
+
+  bool contains(const SmallString& key) const noexcept {
+    return test(hash_string(key));
+  }
+
+  void insert(std::span<const SmallString> keys) noexcept {
+    uint64_t hashes[PREFETCH_GROUP];
+
+    for (size_t begin = 0; begin < keys.size(); begin += PREFETCH_GROUP) {
+      size_t count = (keys.size() - begin < PREFETCH_GROUP) ? keys.size() - begin : PREFETCH_GROUP;
+
+      for (size_t i = 0; i < count; ++i) {
+        hashes[i] = hash_string(keys[begin + i]);
+        __builtin_prefetch(&_blocks[block_of(hashes[i])], 1);
+      }
+      for (size_t i = 0; i < count; ++i) {
+        add(hashes[i]);
+      }
+    }
+  }
+
+  // Bit i of the result is set when keys[i] may be in the filter.
+  Bitmap contains(std::span<const SmallString> keys) const {
+    Bitmap result(keys.size());
+    uint64_t hashes[PREFETCH_GROUP];
+
+    for (size_t begin = 0; begin < keys.size(); begin += PREFETCH_GROUP) {
+      size_t count = (keys.size() - begin < PREFETCH_GROUP) ? keys.size() - begin : PREFETCH_GROUP;
+
+      for (size_t i = 0; i < count; ++i) {
+        hashes[i] = hash_string(keys[begin + i]);
+        __builtin_prefetch(&_blocks[block_of(hashes[i])]);
+      }
+      for (size_t i = 0; i < count; ++i) {
+        if (test(hashes[i])) {
+          result.set(begin + i);
+        }
+      }
+    }
+
+    return result;
+  }
+
+  void clear() noexcept {
+    std::fill(_blocks.begin(), _blocks.end(), Block{});
+  }
+
+  std::vector<uint8_t> serialize() const {
+    std::vector<uint8_t> out;
+    out.reserve(32 + size_in_bytes());
+
+    put_u32(out, MAGIC);
+    put_u32(out, VERSION);
+    put_u32(out, HASH_VERSION);
+    put_u32(out, static_cast<uint32_t>(_probes));
+    put_u64(out, _blocks.size());
+
+    for (const Block& block : _blocks) {
+      for (uint64_t w : block.words) {
+        put_u64(out, w);
+      }
+    }
+    return out;
+  }
+
+  static BlockedBloomFilter deserialize(std::span<const uint8_t> image) {
+    ByteReader reader(image);
+    reader.header(MAGIC, VERSION);
+
+    size_t probes = reader.u32();
+    uint64_t blocks = reader.u64();
+    if (probes < 1 || probes > MAX_PROBES || blocks == 0 || blocks != reader.remaining() / sizeof(Block) ||
+        reader.remaining() % sizeof(Block) != 0) {
+      throw std::invalid_argument("Corrupt filter image");
+    }
+
+    BlockedBloomFilter filter(blocks, probes, true);
+    for (Block& block : filter._blocks) {
+      for (uint64_t& w : block.words) {
+        w = reader.u64();
+      }
+    }
+    return filter;
+  }
+
+};
+
+class CuckooFilter {
+
+  static constexpr uint32_t MAGIC = 0x46434b43; // "CKCF"
+  static constexpr uint32_t VERSION = 1;
+  static constexpr size_t SLOTS = 4;
+  static constexpr size_t MAX_KICKS = 500;
+
+  // Zero marks an empty slot.
+  struct Bucket {
+    uint16_t fingerprints[SLOTS];
+  };
+
+  private:
+  std::vector<Bucket> _buckets;
+  size_t _mask;
+  size_t _count;
+  // A fingerprint that got kicked out and had nowhere to go; while it's
+  // here the filter is full.
+  uint16_t _victim;
+  size_t _victim_bucket;
+  uint64_t _random;
+
+    CuckooFilter(size_t buckets, bool)
+      : _buckets(buckets, Bucket{}), _mask(buckets - 1), _count(0), _victim(0), _victim_bucket(0),
+        _random(0x9e3779b97f4a7c15ULL) {}
+
+    static uint16_t fingerprint(uint64_t hash) noexcept {
+      uint16_t f = static_cast<uint16_t>(hash);
+      return (f == 0) ? 1 : f;
+    }
+
+    size_t first_bucket(uint64_t hash) const noexcept {
+      return static_cast<size_t>(hash >> 32) & _mask;
+    }
+
+    // Works both ways (it's an xor), so a kicked fingerprint can find its
+    // other bucket without the key.
+    size_t other_bucket(size_t bucket, uint16_t f) const noexcept {
+      return (bucket ^ static_cast<size_t>(f * 0x5bd1e995u)) & _mask;
+    }
+
+    bool bucket_has(size_t bucket, uint16_t f) const noexcept {
+      const Bucket& b = _buckets[bucket];
+      bool found = false;
+      for (size_t i = 0; i < SLOTS; ++i) {
+        found |= (b.fingerprints[i] == f);
+      }
+      return found;
+    }
+
+    bool bucket_put(size_t bucket, uint16_t f) noexcept {
+      Bucket& b = _buckets[bucket];
+      for (size_t i = 0; i < SLOTS; ++i) {
+        if (b.fingerprints[i] == 0) {
+          b.fingerprints[i] = f;
+          return true;
+        }
+      }
+      return false;
+    }
+
+    static size_t bucket_count(size_t keys) noexcept {
+      size_t needed = static_cast<size_t>(std::ceil(static_cast<double>(keys) / (SLOTS * 0.95)));
+      size_t buckets = 1;
+      while (buckets < needed) {
+        buckets <<= 1;
+      }
+      return buckets;
+    }
+
+    size_t next_random() noexcept {
+      _random ^= _random << 13;
+      _random ^= _random >> 7;
+      _random ^= _random << 17;
+      return static_cast<size_t>(_random);
+    }
+
+    bool test(uint64_t hash) const noexcept {
+      uint16_t f = fingerprint(hash);
+      size_t b1 = first_bucket(hash);
+      size_t b2 = other_bucket(b1, f);
+
+      if (bucket_has(b1, f) || bucket_has(b2, f)) {
+        return true;
+      }
+      return _victim == f && (_victim_bucket == b1 || _victim_bucket == b2);
+    }
+
+    bool add(uint64_t hash) noexcept {
+      if (_victim != 0) {
+        return false;
+      }
+
+      uint16_t f = fingerprint(hash);
+      size_t bucket = first_bucket(hash);
+      if (bucket_put(bucket, f) || bucket_put(bucket = other_bucket(bucket, f), f)) {
+        ++_count;
+        return true;
+      }
+
+      // Both full: evict a random fingerprint and move it to its other
+      // bucket, and so on.
+      for (size_t kick = 0; kick < MAX_KICKS; ++kick) {
+        uint16_t& slot = _buckets[bucket].fingerprints[next_random() % SLOTS];
+        std::swap(f, slot);
+        bucket = other_bucket(bucket, f);
+        if (bucket_put(bucket, f)) {
+          ++_count;
+          return true;
+        }
+      }
+
+      // The key itself is in; what's left over waits as the victim.
+      _victim = f;
+      _victim_bucket = bucket;
+      ++_count;
+      return true;
+    }
+
+  public:
+  // Room for about expected_keys (the table is kept at most 95% full).
+  explicit CuckooFilter(size_t expected_keys) : CuckooFilter(bucket_count(expected_keys), true) {}
+
+  size_t size() const noexcept {
+    return _count;
+  }
+
+  size_t size_in_bytes() const noexcept {
+    return _buckets.size() * sizeof(Bucket);
+  }
+
+  // False when the filter is full (the key is then not in it).
+  bool insert(const SmallString& key) noexcept {
+    return add(hash_string(key));
+  }
+
+  bool contains(const SmallString& key) const noexcept {
+    return test(hash_string(key));
+  }
+
+  // Only for keys that were inserted: erasing anything else may take out
+  // another key's fingerprint.
+  bool erase(const SmallString& key) noexcept {
+    uint64_t hash = hash_string(key);
+    uint16_t f = fingerprint(hash);
+    size_t b1 = first_bucket(hash);
+    size_t b2 = other_bucket(b1, f);
+
+    if (_victim == f && (_victim_bucket == b1 || _victim_bucket == b2)) {
+      _victim = 0;
+      --_count;
+      return true;
+    }
+
+    for (size_t bucket : {b1, b2}) {
+      for (uint16_t& slot : _buckets[bucket].fingerprints) {
+        if (slot == f) {
+          slot = 0;
+          --_count;
+
+          // There may be room for the victim again.
+          if (_victim != 0 && (bucket_put(_victim_bucket, _victim) ||
+                               bucket_put(other_bucket(_victim_bucket, _victim), _victim))) {
+            _victim = 0;
+          }
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  // How many of the keys made it in; it stops at the first one that
+  // doesn't fit.
+  size_t insert(std::span<const SmallString> keys) noexcept {
+    uint64_t hashes[PREFETCH_GROUP];
+
+    for (size_t begin = 0; begin < keys.size(); begin += PREFETCH_GROUP) {
+      size_t count = (keys.size() - begin < PREFETCH_GROUP) ? keys.size() - begin : PREFETCH_GROUP;
+
+      for (size_t i = 0; i < count; ++i) {
+        hashes[i] = hash_string(keys[begin + i]);
+        size_t b1 = first_bucket(hashes[i]);
+        __builtin_prefetch(&_buckets[b1], 1);
+        __builtin_prefetch(&_buckets[other_bucket(b1, fingerprint(hashes[i]))], 1);
+      }
+      for (size_t i = 0; i < count; ++i) {
+        if (!add(hashes[i])) {
+          return begin + i;
+        }
+      }
+    }
+    return keys.size();
+  }
+
+  Bitmap contains(std::span<const SmallString> keys) const {
+    Bitmap result(keys.size());
+    uint64_t hashes[PREFETCH_GROUP];
+
+    for (size_t begin = 0; begin < keys.size(); begin += PREFETCH_GROUP) {
+      size_t count = (keys.size() - begin < PREFETCH_GROUP) ? keys.size() - begin : PREFETCH_GROUP;
+
+      for (size_t i = 0; i < count; ++i) {
+        hashes[i] = hash_string(keys[begin + i]);
+        size_t b1 = first_bucket(hashes[i]);
+        __builtin_prefetch(&_buckets[b1]);
+        __builtin_prefetch(&_buckets[other_bucket(b1, fingerprint(hashes[i]))]);
+      }
+      for (size_t i = 0; i < count; ++i) {
+        if (test(hashes[i])) {
+          result.set(begin + i);
+        }
+      }
+    }
+
+    return result;
+  }
+
+  std::vector<uint8_t> serialize() const {
+    std::vector<uint8_t> out;
+    out.reserve(48 + size_in_bytes());
+
+    put_u32(out, MAGIC);
+    put_u32(out, VERSION);
+    put_u32(out, HASH_VERSION);
+    put_u32(out, _victim);
+    put_u64(out, _victim_bucket);
+    put_u64(out, _count);
+    put_u64(out, _buckets.size());
+
+    for (const Bucket& bucket : _buckets) {
+      for (uint16_t f : bucket.fingerprints) {
+        out.push_back(static_cast<uint8_t>(f));
+        out.push_back(static_cast<uint8_t>(f >> 8));
+      }
+    }
+    return out;
+  }
+
+  static CuckooFilter deserialize(std::span<const uint8_t> image) {
+    ByteReader reader(image);
+    reader.header(MAGIC, VERSION);
+
+    uint32_t victim = reader.u32();
+    uint64_t victim_bucket = reader.u64();
+    uint64_t count = reader.u64();
+    uint64_t buckets = reader.u64();
+    if (buckets == 0 || (buckets & (buckets - 1)) != 0 || victim > 0xFFFF || victim_bucket >= buckets ||
+        reader.remaining() != buckets * sizeof(Bucket)) {
+      throw std::invalid_argument("Corrupt filter image");
+    }
+
+    CuckooFilter filter(buckets, true);
+    filter._victim = static_cast<uint16_t>(victim);
+    filter._victim_bucket = victim_bucket;
+    filter._count = count;
+
+    // Two fingerprints to a u32.
+    for (Bucket& bucket : filter._buckets) {
+      for (size_t i = 0; i < SLOTS; i += 2) {
+        uint32_t pair = reader.u32();
+        bucket.fingerprints[i] = static_cast<uint16_t>(pair);
+        bucket.fingerprints[i + 1] = static_cast<uint16_t>(pair >> 16);
+      }
+    }
+    return filter;
+  }
+
+};
+
+#endif
@@ -0,0 +1,121 @@
+#include <iostream>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "parallel_builder.hpp"
+
+using namespace std;
+
+// TESTS
+
+int main() {
+
+  // resize_for_overwrite, then writing through the segments
+  {
+    SmallString s("something that will be thrown away entirely");
+    s.resize_for_overwrite(30);
+    assert (s.length() == 30 && s.spilled_length() == 8);
+    assert (s.heap_footprint() > 0);
+    for (size_t i = 0; i < s.inline_length(); ++i) {
+      s.inline_data()[i] = 'a';
+    }
+    for (size_t i = 0; i < s.spilled_length(); ++i) {
+      s.spilled_data()[i] = 'b';
+    }
+    assert (s.str() == string(22, 'a') + string(8, 'b'));
+
+    s.resize_for_overwrite(5);
+    assert (s.length() == 5 && s.spilled_data() == nullptr);
+    s.resize_for_overwrite(0);
+    assert (s.length() == 0);
+  }
+
+  // copy_segments across every combination of segments
+  {
+    string text;
+    for (size_t i = 0; i < 100; ++i) {
+      text += char('a' + i % 26);
+    }
+    SmallString from(text.c_str());
+    for (size_t from_at : {0, 5, 21, 22, 40}) {
+      for (size_t to_at : {0, 10, 22, 30}) {
+        for (size_t n : {0, 1, 17, 40}) {
+          SmallString to;
+          to.resize_for_overwrite(80);
+          copy_segments(from, from_at, to, to_at, n);
+          assert (to.str().substr(to_at, n) == text.substr(from_at, n));
+        }
+      }
+    }
+  }
+
+  // splice against repeated +, with empty, inline and spilled parts
+  {
+    vector<SmallString> parts;
+    string expected;
+    for (size_t i = 0; i < 50; ++i) {
+      string part = (i % 7 == 0) ? "" : (i % 3 == 0) ? string(100 + i, char('A' + i % 26)) : to_string(i);
+      parts.push_back(SmallString(part.c_str()));
+      expected += part;
+    }
+    assert (splice(span<const SmallString>(parts)).str() == expected);
+    assert (splice(span<const SmallString>()).length() == 0);
+
+    WorkStealingPool pool(4);
+    assert (splice(span<const SmallString>(parts), pool).str() == expected);
+  }
+
+  // Threads build parts, finish() puts them together in slot order
+  for (size_t threads : {1, 3}) {
+    const size_t PARTS = 8;
+    ParallelBuilder builder(PARTS);
+    WorkStealingPool pool(threads);
+
+    vector<thread> workers;
+    for (size_t p = 0; p < PARTS; ++p) {
+      workers.emplace_back([&, p]() {
+        SmallString& part = builder.part(p);
+        // Big enough parts that the copy splits into several runs
+        for (size_t line = 0; line < 4000; ++line) {
+          string text = "part " + to_string(p) + " line " + to_string(line) + "\n";
+          part.append(text.c_str());
+        }
+      });
+    }
+    for (thread& worker : workers) {
+      worker.join();
+    }
+
+    string expected;
+    for (size_t p = 0; p < PARTS; ++p) {
+      expected += builder.part(p).str();
+    }
+    SmallString result = builder.finish(pool);
+    assert (result.str() == expected);
+    assert (builder.part(0).length() == 0);
+
+    // Reserved slots come in order; running out throws
+    assert (builder.reserve() == 0);
+    builder.part(0).append("first ");
+    assert (builder.reserve() == 1);
+    builder.part(1).append("second");
+    for (size_t p = 2; p < PARTS; ++p) {
+      builder.reserve();
+    }
+    bool thrown = false;
+    try {
+      builder.reserve();
+    }
+    catch (const out_of_range&) {
+      thrown = true;
+    }
+    assert (thrown);
+    assert (builder.finish().str() == "first second");
+  }
+
+  return 0;
+
+}
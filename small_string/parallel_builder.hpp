@@ -0,0 +1,184 @@
+#ifndef PARALLEL_BUILDER_HPP
+#define PARALLEL_BUILDER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "small_string.hpp"
+#include "work_stealing.hpp"
+
+/*
+ParallelBuilder:
+Builds one big SmallString out of parts made by different threads, in
+a fixed order.
+
+Each thread reserves a slot (or is handed one) and appends to its own
+part, with no sharing: slots are a cache line apart. finish() then
+works out every part's offset (prefix sums of the lengths), makes the
+result with resize_for_overwrite (so its storage is allocated once, at
+its final size) and copies the parts into place.
+
+The copy is split into CHUNK-byte runs of the output rather than by
+part, so one huge part doesn't end up on one thread; with a pool, the
+runs are copied in parallel. Each run copies segment to segment with
+memcpy, whichever parts and segments it straddles.
+
+splice() does the same for parts that already exist, e.g. instead of
+a chain of operator+.
+*/
+
+// Copies n bytes of from, starting at from_at, into to at to_at (both
+// ranges within their strings).
+inline void copy_segments(const SmallString& from, size_t from_at, SmallString& to, size_t to_at, size_t n) noexcept {
+  while (n != 0) {
+    const char* source;
+    size_t source_left;
+    if (from_at < BUFFER_LIMIT) {
+      source = from.inline_data() + from_at;
+      source_left = from.inline_length() - from_at;
+    }
+    else {
+      source = from.spilled_data() + (from_at - BUFFER_LIMIT);
+      source_left = from.length() - from_at;
+    }
+
+    char* target;
+    size_t target_left;
+    if (to_at < BUFFER_LIMIT) {
+      target = to.inline_data() + to_at;
+      target_left = to.inline_length() - to_at;
+    }
+    else {
+      target = to.spilled_data() + (to_at - BUFFER_LIMIT);
+      target_left = to.length() - to_at;
+    }
+
+    size_t k = std::min(n, std::min(source_left, target_left));
+    std::memcpy(target, source, k);
+    from_at += k;
+    to_at += k;
+    n -= k;
+  }
+}
+
+namespace builder_detail {
+
+  inline constexpr size_t CHUNK = 64 * 1024;
+
+  // The parts, end to end, in one string; get(i) is part i.
+  template <typename Get>
+  SmallString splice(size_t parts, Get get, WorkStealingPool* pool) {
+    std::vector<size_t> offsets(parts + 1, 0);
+    for (size_t i = 0; i < parts; ++i) {
+      offsets[i + 1] = offsets[i] + get(i).length();
+    }
+
+    SmallString result;
+    size_t total = offsets[parts];
+    result.resize_for_overwrite(total);
+
+    // Output bytes [begin, end), from whichever parts they come from.
+    auto copy_run = [&](size_t begin, size_t end) {
+      size_t i = std::upper_bound(offsets.begin(), offsets.end(), begin) - offsets.begin() - 1;
+      for (; i < parts && offsets[i] < end; ++i) {
+        size_t from = std::max(begin, offsets[i]);
+        size_t to = std::min(end, offsets[i + 1]);
+        if (from < to) {
+          copy_segments(get(i), from - offsets[i], result, from, to - from);
+        }
+      }
+    };
+
+    size_t runs = (total + CHUNK - 1) / CHUNK;
+    if (pool == nullptr || runs <= 1) {
+      copy_run(0, total);
+    }
+    else {
+      pool->parallel_for(runs, [&](size_t first, size_t last) {
+        copy_run(first * CHUNK, std::min(total, last * CHUNK));
+      }, 1);
+    }
+    return result;
+  }
+
+}
+
+class ParallelBuilder {
+
+  struct alignas(64) Slot {
+    SmallString part;
+  };
+
+  private:
+  std::vector<Slot> _slots;
+  std::atomic<size_t> _reserved;
+
+    SmallString finish_with(WorkStealingPool* pool) {
+      SmallString result = builder_detail::splice(_slots.size(), [this](size_t i) -> const SmallString& {
+        return _slots[i].part;
+      }, pool);
+
+      for (Slot& slot : _slots) {
+        slot.part.empty();
+      }
+      _reserved.store(0, std::memory_order_relaxed);
+      return result;
+    }
+
+  public:
+  explicit ParallelBuilder(size_t parts) : _slots(parts), _reserved(0) {}
+
+  ParallelBuilder(const ParallelBuilder&) = delete;
+  ParallelBuilder& operator=(const ParallelBuilder&) = delete;
+
+  size_t parts() const noexcept {
+    return _slots.size();
+  }
+
+  // The next free slot, for threads that don't care where their part
+  // goes (slots are handed out in order, so the order is the order of
+  // reservation).
+  size_t reserve() {
+    size_t slot = _reserved.fetch_add(1, std::memory_order_relaxed);
+    if (slot >= _slots.size()) {
+      throw std::out_of_range("No slots left");
+    }
+    return slot;
+  }
+
+  // Only the thread that owns a slot may touch its part until finish().
+  SmallString& part(size_t slot) {
+    return _slots.at(slot).part;
+  }
+
+  // All the parts, in slot order, in one string; the parts are emptied.
+  // Every thread must be done with its part.
+  SmallString finish() {
+    return finish_with(nullptr);
+  }
+
+  SmallString finish(WorkStealingPool& pool) {
+    return finish_with(&pool);
+  }
+
+};
+
+// The parts, end to end, with the result allocated once.
+inline SmallString splice(std::span<const SmallString> parts) {
+  return builder_detail::splice(parts.size(), [&](size_t i) -> const SmallString& {
+    return parts[i];
+  }, nullptr);
+}
+
+inline SmallString splice(std::span<const SmallString> parts, WorkStealingPool& pool) {
+  return builder_detail::splice(parts.size(), [&](size_t i) -> const SmallString& {
+    return parts[i];
+  }, &pool);
+}
+
+#endif
@@ -0,0 +1,109 @@
+#include <iostream>
+#include <cassert>
+#include <vector>
+
+#include "pattern_matcher.hpp"
+
+using namespace std;
+
+// The slow way: a backtracking LIKE interpreter ('%' and '_' only).
+static bool reference(const char* pattern, const SmallString& s, size_t i) {
+  if (*pattern == '\0') {
+    return i == s.length();
+  }
+  if (*pattern == '%') {
+    for (size_t j = i; j <= s.length(); ++j) {
+      if (reference(pattern + 1, s, j)) {
+        return true;
+      }
+    }
+    return false;
+  }
+  if (i == s.length()) {
+    return false;
+  }
+  return (*pattern == '_' || *pattern == s[i]) && reference(pattern + 1, s, i + 1);
+}
+
+// TESTS
+
+int main() {
+
+  // Literal searches
+  PatternMatcher exact("GET");
+  assert (exact.is_literal_search());
+  assert (exact.matches(SmallString("GET")));
+  assert (!exact.matches(SmallString("GETS")));
+
+  PatternMatcher suffix("*.log", PatternSyntax::GLOB);
+  assert (suffix.is_literal_search());
+  assert (suffix.matches(SmallString("/var/log/some/long/path/server.log")));
+  assert (!suffix.matches(SmallString("server.log.1")));
+
+  PatternMatcher contains("%foo%");
+  assert (contains.is_literal_search());
+  assert (contains.matches(SmallString("a foo b")));
+
+  PatternMatcher everything("%%");
+  assert (everything.matches(SmallString("")));
+  assert (everything.matches(SmallString("anything at all")));
+
+  // General patterns
+  PatternMatcher general("%foo%bar_");
+  assert (!general.is_literal_search());
+  assert (general.matches(SmallString("xxfooyybarz")));
+  assert (!general.matches(SmallString("xxfooyybar")));
+  assert (general.matches(SmallString("foobar!")));
+  assert (general.matches(SmallString("a rather long prefix, then foo and then barX")));
+
+  PatternMatcher escaped("100\\%");
+  assert (escaped.matches(SmallString("100%")));
+  assert (!escaped.matches(SmallString("1000")));
+
+  // Glob classes
+  PatternMatcher klass("file[0-9][!a-c]?.txt", PatternSyntax::GLOB);
+  assert (klass.matches(SmallString("file7dz.txt")));
+  assert (!klass.matches(SmallString("file7az.txt")));
+  assert (!klass.matches(SmallString("filex dz.txt")));
+
+  PatternMatcher bracket("[]a]*", PatternSyntax::GLOB);
+  assert (bracket.matches(SmallString("]")));
+  assert (bracket.matches(SmallString("abc")));
+  assert (!bracket.matches(SmallString("b")));
+
+  // Malformed patterns
+  bool thrown = false;
+  try {
+    PatternMatcher broken("[abc", PatternSyntax::GLOB);
+  }
+  catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  // Against the backtracking interpreter, in batches
+  const char* patterns[] = {"a%b", "%ab%ba%", "_a_%", "%a_b%a", "b%", "%b", "%ab%", "a_%_a%b_", "%%a%%", ""};
+
+  vector<SmallString> rows;
+  for (size_t length = 0; length < 30; ++length) {
+    for (size_t seed = 0; seed < 5; ++seed) {
+      SmallString row;
+      for (size_t i = 0; i < length; ++i) {
+        row.append(((i * 31 + seed * 17 + i * i) % 7) < 3 ? "a" : "b");
+      }
+      rows.push_back(row);
+    }
+  }
+
+  for (const char* pattern : patterns) {
+    PatternMatcher matcher(pattern);
+    Bitmap selected = matcher.matches(rows);
+
+    for (size_t r = 0; r < rows.size(); ++r) {
+      assert (selected.test(r) == reference(pattern, rows[r], 0));
+    }
+  }
+
+  return 0;
+
+}
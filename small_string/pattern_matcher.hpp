@@ -0,0 +1,295 @@
+#ifndef PATTERN_MATCHER_HPP
+#define PATTERN_MATCHER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <span>
+#include <stdexcept>
+#include <vector>
+
+#include "batch_filter.hpp"
+#include "small_string.hpp"
+
+/*
+PatternMatcher:
+SQL LIKE ('%' = any run, '_' = any char) and shell globs ('*', '?',
+'[a-z]', '[!abc]') compiled once, instead of being interpreted again
+for every string.
+
+Patterns that are just a literal with '%'s at the ends ("foo",
+"foo%", "%foo", "%foo%") become batch_filter searches. Everything
+else runs on a bit-parallel (shift-and) NFA: one state per non-'%'
+atom, all of them advanced at once per input char, so matching is
+linear in the length of the string and never backtracks.
+*/
+
+enum class PatternSyntax { LIKE, GLOB };
+
+class PatternMatcher {
+
+  // Bit 0 of the NFA is the start state, so at most 63 atoms fit.
+  static const size_t MAX_ATOMS = 63;
+
+  enum class Kind { EXACT, PREFIX, SUFFIX, CONTAINS, GENERAL };
+
+  // A single pattern position: either a run of anything ('%', '*')
+  // or something that eats exactly one char.
+  struct Atom {
+    bool is_star;
+    bool accepts[256];
+  };
+
+  private:
+  Kind _kind;
+  std::vector<char> _literal;
+  size_t _min_length;
+
+  // The NFA: bit j + 1 of _transitions[c] is set if atom j accepts c,
+  // and bit j of _loops is set if state j may stay put on any char.
+  uint64_t _transitions[256];
+  uint64_t _loops;
+  uint64_t _final;
+
+    static std::vector<Atom> parse(const char* pattern, PatternSyntax syntax, char escape) {
+      std::vector<Atom> atoms;
+      size_t length = std::strlen(pattern);
+
+      for (size_t i = 0; i < length; ++i) {
+        Atom atom;
+        atom.is_star = false;
+        std::memset(atom.accepts, 0, sizeof(atom.accepts));
+
+        char c = pattern[i];
+        bool any_run = (syntax == PatternSyntax::LIKE) ? (c == '%') : (c == '*');
+        bool any_char = (syntax == PatternSyntax::LIKE) ? (c == '_') : (c == '?');
+
+        if (c == escape) {
+          if (i + 1 == length) {
+            throw std::invalid_argument("Pattern ends with an escape character.");
+          }
+          atom.accepts[static_cast<unsigned char>(pattern[++i])] = true;
+        }
+        else if (any_run) {
+          // Consecutive runs mean the same as one.
+          if (!atoms.empty() && atoms.back().is_star) {
+            continue;
+          }
+          atom.is_star = true;
+        }
+        else if (any_char) {
+          std::memset(atom.accepts, 1, sizeof(atom.accepts));
+        }
+        else if (syntax == PatternSyntax::GLOB && c == '[') {
+          i = parse_class(pattern, length, i, atom);
+        }
+        else {
+          atom.accepts[static_cast<unsigned char>(c)] = true;
+        }
+
+        atoms.push_back(atom);
+      }
+
+      return atoms;
+    }
+
+    // Parses "[...]" starting at pattern[open] into atom, and returns the
+    // position of the closing ']'.
+    static size_t parse_class(const char* pattern, size_t length, size_t open, Atom& atom) {
+      size_t i = open + 1;
+      bool negated = (i < length) && (pattern[i] == '!' || pattern[i] == '^');
+      if (negated) {
+        ++i;
+      }
+
+      // A ']' right at the start is a member, not the end.
+      bool first = true;
+      for (; i < length && (first || pattern[i] != ']'); ++i) {
+        first = false;
+        unsigned char low = pattern[i];
+        unsigned char high = low;
+
+        if (i + 2 < length && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+          high = pattern[i + 2];
+          i += 2;
+        }
+
+        for (unsigned int c = low; c <= high; ++c) {
+          atom.accepts[c] = true;
+        }
+      }
+
+      if (i >= length) {
+        throw std::invalid_argument("Unterminated character class in pattern.");
+      }
+
+      if (negated) {
+        for (bool& accepted : atom.accepts) {
+          accepted = !accepted;
+        }
+      }
+
+      return i;
+    }
+
+    // Returns the char if the atom accepts exactly one, or -1.
+    static int single_char(const Atom& atom) noexcept {
+      int found = -1;
+      for (int c = 0; c < 256; ++c) {
+        if (atom.accepts[c]) {
+          if (found != -1) {
+            return -1;
+          }
+          found = c;
+        }
+      }
+      return found;
+    }
+
+    void compile(const std::vector<Atom>& atoms) {
+      size_t first = 0;
+      size_t last = atoms.size();
+      bool leading_star = (first < last) && atoms[first].is_star;
+      if (leading_star) {
+        ++first;
+      }
+      bool trailing_star = (first < last) && atoms[last - 1].is_star;
+      if (trailing_star) {
+        --last;
+      }
+
+      // Is the middle a plain literal?
+      bool literal = true;
+      for (size_t i = first; i < last && literal; ++i) {
+        literal = !atoms[i].is_star && single_char(atoms[i]) != -1;
+      }
+
+      _min_length = 0;
+      for (const Atom& atom : atoms) {
+        _min_length += atom.is_star ? 0 : 1;
+      }
+
+      if (literal) {
+        for (size_t i = first; i < last; ++i) {
+          _literal.push_back(static_cast<char>(single_char(atoms[i])));
+        }
+
+        if (leading_star && trailing_star) {
+          _kind = Kind::CONTAINS;
+        }
+        else if (leading_star) {
+          _kind = Kind::SUFFIX;
+        }
+        else if (trailing_star) {
+          _kind = Kind::PREFIX;
+        }
+        else {
+          _kind = Kind::EXACT;
+        }
+        return;
+      }
+
+      _kind = Kind::GENERAL;
+      if (_min_length > MAX_ATOMS) {
+        throw std::length_error("Pattern has too many atoms for the NFA.");
+      }
+
+      std::memset(_transitions, 0, sizeof(_transitions));
+      _loops = 0;
+
+      size_t state = 0;
+      for (const Atom& atom : atoms) {
+        if (atom.is_star) {
+          _loops |= uint64_t(1) << state;
+          continue;
+        }
+
+        ++state;
+        for (int c = 0; c < 256; ++c) {
+          if (atom.accepts[c]) {
+            _transitions[c] |= uint64_t(1) << state;
+          }
+        }
+      }
+
+      _final = uint64_t(1) << state;
+    }
+
+    // Runs the NFA over one segment; returns the new state set.
+    uint64_t run(uint64_t states, const char* p, size_t n) const noexcept {
+      for (size_t i = 0; i < n && states != 0; ++i) {
+        uint64_t advanced = (states << 1) & _transitions[static_cast<unsigned char>(p[i])];
+        states = advanced | (states & _loops);
+      }
+      return states;
+    }
+
+    Predicate predicate() const noexcept {
+      switch (_kind) {
+        case Kind::EXACT:
+          return Predicate::EQUALS;
+        case Kind::PREFIX:
+          return Predicate::STARTS_WITH;
+        case Kind::SUFFIX:
+          return Predicate::ENDS_WITH;
+        default:
+          return Predicate::CONTAINS;
+      }
+    }
+
+  public:
+  // Compiles the pattern; throws std::invalid_argument if it's malformed,
+  // and std::length_error if it has more than MAX_ATOMS non-run atoms.
+  PatternMatcher(const char* pattern, PatternSyntax syntax = PatternSyntax::LIKE, char escape = '\\') {
+    compile(parse(pattern, syntax, escape));
+  }
+
+  bool matches(const SmallString& s) const noexcept {
+    size_t length = s.length();
+    if (length < _min_length) {
+      return false;
+    }
+
+    const char* literal = _literal.data();
+    size_t n = _literal.size();
+
+    switch (_kind) {
+      case Kind::EXACT:
+        return length == n && matches_at(s, 0, literal, n);
+      case Kind::PREFIX:
+        return matches_at(s, 0, literal, n);
+      case Kind::SUFFIX:
+        return matches_at(s, length - n, literal, n);
+      case Kind::CONTAINS:
+        return find_in(s, literal, n) != NOT_FOUND;
+      default:
+        break;
+    }
+
+    uint64_t states = run(1, s.inline_data(), s.inline_length());
+    states = run(states, s.spilled_data(), s.spilled_length());
+    return (states & _final) != 0;
+  }
+
+  Bitmap matches(std::span<const SmallString> rows) const {
+    if (_kind != Kind::GENERAL) {
+      return batch_filter(rows, _literal.data(), _literal.size(), predicate());
+    }
+
+    Bitmap selected(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+      if (matches(rows[i])) {
+        selected.set(i);
+      }
+    }
+    return selected;
+  }
+
+  // Whether the pattern was reduced to a batch_filter search.
+  bool is_literal_search() const noexcept {
+    return _kind != Kind::GENERAL;
+  }
+
+};
+
+#endif
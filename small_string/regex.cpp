@@ -0,0 +1,170 @@
+#include <iostream>
+#include <cassert>
+#include <regex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "regex.hpp"
+
+using namespace std;
+
+// TESTS
+
+int main() {
+
+  // Token validation
+  Regex identifier("[A-Za-z_]\\w*");
+  assert (identifier.full_match(SmallString("snake_case_42")));
+  assert (!identifier.full_match(SmallString("42_is_not_an_identifier")));
+  assert (identifier.search(SmallString("42_is_not_an_identifier")));
+
+  Regex ip("\\d{1,3}(\\.\\d{1,3}){3}");
+  assert (ip.full_match(SmallString("192.168.0.1")));
+  assert (!ip.full_match(SmallString("192.168.0")));
+  assert (!ip.full_match(SmallString("1920.168.0.1")));
+
+  // Anchors
+  Regex anchored("^GET /");
+  assert (anchored.search(SmallString("GET /index.html")));
+  assert (!anchored.search(SmallString("XGET /index.html")));
+
+  Regex suffix("\\.log$");
+  assert (suffix.search(SmallString("/var/log/a/rather/long/path/server.log")));
+  assert (!suffix.search(SmallString("server.log.1")));
+
+  Regex escaped_dollar("costs 5\\$");
+  assert (escaped_dollar.search(SmallString("it costs 5$ now")));
+
+  // Field extraction
+  Regex number("\\d+");
+  SmallString record("id=12345;name=x");
+  assert (number.match_length(record, 3) == 5);
+  assert (number.match_length(record, 0) == NOT_FOUND);
+
+  // Byte classes: [a-z] and 'x' give {a-w, y-z}, {x} and the rest.
+  Regex classes("[a-z]+x");
+  assert (classes.byte_classes() == 3);
+
+  // Malformed patterns
+  const char* broken[] = {"(ab", "ab)", "*a", "[abc", "a{2,1}", "a^b", "a\\"};
+  for (const char* pattern : broken) {
+    bool thrown = false;
+    try {
+      Regex r(pattern);
+    }
+    catch (const std::invalid_argument&) {
+      thrown = true;
+    }
+    assert (thrown);
+  }
+
+  // Pathological for backtracking engines, but linear for us.
+  Regex evil("(a|a)*(a*)*b");
+  SmallString many_as;
+  for (size_t i = 0; i < 5000; ++i) {
+    many_as.append("a");
+  }
+  assert (!evil.full_match(many_as));
+  assert (!evil.search(many_as));
+
+  // Against std::regex
+  const char* patterns[] = {
+    "a*b", "(ab|ba)+", "a?b?a?b?", "[ab]{2,4}c?", "(a|bc)*d", ".*ab.*", "[^a]+", "(a+|b+)(ab)?",
+    "ab{0,2}a", "^b", "a$", "(?:ab)*", "\\w\\s\\d", "", "^(a|b)", "(ab|b)$", "^(a|bc)+$", "(a|b)|c",
+  };
+
+  vector<SmallString> inputs;
+  const char* chars = "ab cd1";
+  for (size_t length = 0; length < 28; ++length) {
+    for (size_t seed = 0; seed < 4; ++seed) {
+      SmallString input;
+      for (size_t i = 0; i < length; ++i) {
+        char c[2] = {chars[(i * 13 + seed * 7 + i * i * seed) % (seed < 2 ? 2 : 6)], '\0'};
+        input.append(c);
+      }
+      inputs.push_back(input);
+    }
+  }
+
+  for (const char* pattern : patterns) {
+    Regex mine(pattern);
+    std::regex theirs(pattern);
+
+    for (const SmallString& input : inputs) {
+      string copy = input.str();
+      assert (mine.full_match(input) == std::regex_match(copy, theirs));
+      assert (mine.search(input) == std::regex_search(copy, theirs));
+    }
+  }
+
+  // Anchors next to a top-level '|' would anchor the whole pattern, not
+  // just their alternative (std::regex finds "^a|b" in "xb"): they throw
+  for (const char* pattern : {"^a|b", "a|b$", "^a|(b)$", "(x)|^y"}) {
+    bool thrown = false;
+    try {
+      Regex mine(pattern);
+    }
+    catch (const invalid_argument&) {
+      thrown = true;
+    }
+    assert (thrown);
+  }
+  assert (std::regex_search(string("xb"), std::regex("^a|b")));
+  assert (Regex("\\^a|b").search(SmallString("xb")));
+
+  // A tiny cache still gives the right answers (it just gets flushed):
+  // with room for 4 states per DFA, these need many flushes on random
+  // strings of a and b
+  vector<SmallString> random_inputs;
+  unsigned state = 1;
+  for (size_t length = 0; length < 40; ++length) {
+    for (size_t k = 0; k < 8; ++k) {
+      SmallString input;
+      for (size_t i = 0; i < length; ++i) {
+        state = state * 1103515245 + 12345;
+        input.append(((state >> 16) & 1) ? "a" : "b");
+      }
+      random_inputs.push_back(input);
+    }
+  }
+
+  const char* flushed[] = {"[ab]*a[ab]{8}", "(a|b)*a(a|b)(a|b)", "(ab|ba)+", "a[ab]{5}$"};
+  for (const char* pattern : flushed) {
+    Regex tiny(pattern, 4);
+    Regex roomy(pattern);
+    std::regex theirs(pattern);
+    for (const SmallString& input : random_inputs) {
+      string copy = input.str();
+      assert (tiny.search(input) == std::regex_search(copy, theirs));
+      assert (tiny.full_match(input) == std::regex_match(copy, theirs));
+      roomy.search(input);
+      roomy.full_match(input);
+    }
+    assert (tiny.dfa_states() <= 2 * 4 && tiny.dfa_flushes() > 0);
+    assert (roomy.dfa_flushes() == 0);
+  }
+
+  // One that outgrows even the default cache: 2^15 subsets to visit
+  Regex big("[ab]*a[ab]{14}");
+  std::regex big_theirs("[ab]*a[ab]{14}");
+  string text;
+  for (size_t i = 0; i < 100000; ++i) {
+    state = state * 1103515245 + 12345;
+    text += ((state >> 16) & 1) ? 'a' : 'b';
+  }
+  for (size_t length : {15, 500, 2000}) {
+    string copy = text.substr(0, length);
+    SmallString prefix(copy.data(), copy.size());
+    assert (big.full_match(prefix) == std::regex_match(copy, big_theirs));
+    assert (big.search(prefix) == std::regex_search(copy, big_theirs));
+  }
+  // std::regex recurses per byte and can't take the whole text; this
+  // pattern matches exactly when the 15th byte from the end is an 'a'
+  SmallString whole(text.data(), text.size());
+  assert (big.full_match(whole) == (text[text.size() - 15] == 'a'));
+  assert (big.dfa_flushes() > 0 && big.dfa_states() <= 2 * 4096);
+
+  return 0;
+
+}
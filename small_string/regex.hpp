@@ -0,0 +1,676 @@
+#ifndef REGEX_HPP
+#define REGEX_HPP
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "batch_filter.hpp"
+#include "small_string.hpp"
+
+/*
+Regex:
+A small regex engine for the subset that we actually use:
+  - literals, '.', classes ("[a-z_]", "[^0-9]", "\d", "\w", "\s"),
+  - grouping "(...)", alternation '|',
+  - repetition '*', '+', '?', "{m}", "{m,}", "{m,n}",
+  - '^' at the very start and '$' at the very end. They anchor the
+    whole pattern, which isn't what they mean next to a '|' outside
+    any group ("^a|b" is "^a" or "b"), so that throws: group it,
+    "^(a|b)".
+No backreferences and no captures, which is what lets us guarantee
+linear time.
+
+The pattern goes AST -> Thompson NFA -> DFA, but the DFA is built
+lazily: a DFA state (a set of NFA states) and its transitions are only
+computed the first time the input needs them. Transitions are indexed
+by byte *class* (bytes that no part of the pattern can tell apart share
+a class), which keeps the table small.
+
+Matching is not thread-safe, since it fills in the DFA as it goes:
+give each thread its own copy.
+*/
+
+class Regex {
+
+  static constexpr size_t MAX_REPEAT = 1000;
+  static constexpr size_t MAX_NFA_STATES = 100000;
+  static constexpr size_t MAX_DFA_STATES = 4096;
+
+  // AST
+  struct Node {
+    enum Type { SET, EMPTY, CONCAT, ALTERNATE, REPEAT } type;
+    std::bitset<256> set;
+    std::vector<std::unique_ptr<Node>> children;
+    size_t min;
+    size_t max; // REPEAT_FOREVER if unbounded
+
+    explicit Node(Type t) : type(t), min(0), max(0) {}
+  };
+
+  static constexpr size_t REPEAT_FOREVER = static_cast<size_t>(-1);
+
+  // NFA
+  struct NfaState {
+    enum Type { SET, SPLIT, MATCH } type;
+    int set_id;
+    int out;
+    int out1;
+  };
+
+  // A lazily built DFA. floating DFAs re-enter the NFA start state at
+  // every position, i.e. they run ".*(pattern)".
+  struct LazyDfa {
+    static constexpr int UNKNOWN = -1;
+
+    bool floating;
+    std::vector<std::vector<int>> sets;
+    std::map<std::vector<int>, int> ids;
+    std::vector<int> next;
+    std::vector<bool> accepting;
+    int start;
+  };
+
+  class Parser {
+    const char* _p;
+    const char* _end;
+    size_t _depth;
+    bool _top_level_alternation;
+
+    public:
+    Parser(const char* begin, const char* end) : _p(begin), _end(end), _depth(0), _top_level_alternation(false) {}
+
+    // Whether there's a '|' outside of every group.
+    bool top_level_alternation() const noexcept {
+      return _top_level_alternation;
+    }
+
+    std::unique_ptr<Node> parse() {
+      std::unique_ptr<Node> node = alternation();
+      if (_p != _end) {
+        throw std::invalid_argument("Unbalanced ')' in regex.");
+      }
+      return node;
+    }
+
+    private:
+    bool at(char c) const noexcept {
+      return _p != _end && *_p == c;
+    }
+
+    std::unique_ptr<Node> alternation() {
+      std::unique_ptr<Node> first = concatenation();
+      if (!at('|')) {
+        return first;
+      }
+
+      if (_depth == 0) {
+        _top_level_alternation = true;
+      }
+      std::unique_ptr<Node> node(new Node(Node::ALTERNATE));
+      node->children.push_back(std::move(first));
+      while (at('|')) {
+        ++_p;
+        node->children.push_back(concatenation());
+      }
+      return node;
+    }
+
+    std::unique_ptr<Node> concatenation() {
+      std::unique_ptr<Node> node(new Node(Node::CONCAT));
+      while (_p != _end && !at('|') && !at(')')) {
+        node->children.push_back(repetition());
+      }
+
+      if (node->children.empty()) {
+        return std::unique_ptr<Node>(new Node(Node::EMPTY));
+      }
+      if (node->children.size() == 1) {
+        return std::move(node->children[0]);
+      }
+      return node;
+    }
+
+    std::unique_ptr<Node> repetition() {
+      std::unique_ptr<Node> node = atom();
+
+      while (_p != _end) {
+        size_t min;
+        size_t max;
+
+        if (at('*')) {
+          min = 0;
+          max = REPEAT_FOREVER;
+          ++_p;
+        }
+        else if (at('+')) {
+          min = 1;
+          max = REPEAT_FOREVER;
+          ++_p;
+        }
+        else if (at('?')) {
+          min = 0;
+          max = 1;
+          ++_p;
+        }
+        else if (at('{')) {
+          ++_p;
+          min = number();
+          max = min;
+          if (at(',')) {
+            ++_p;
+            max = at('}') ? REPEAT_FOREVER : number();
+          }
+          if (!at('}') || max < min) {
+            throw std::invalid_argument("Malformed {m,n} in regex.");
+          }
+          ++_p;
+        }
+        else {
+          break;
+        }
+
+        if (min > MAX_REPEAT || (max != REPEAT_FOREVER && max > MAX_REPEAT)) {
+          throw std::length_error("Repetition count too large in regex.");
+        }
+
+        std::unique_ptr<Node> repeat(new Node(Node::REPEAT));
+        repeat->min = min;
+        repeat->max = max;
+        repeat->children.push_back(std::move(node));
+        node = std::move(repeat);
+      }
+
+      return node;
+    }
+
+    size_t number() {
+      if (_p == _end || *_p < '0' || *_p > '9') {
+        throw std::invalid_argument("Expected a number in regex.");
+      }
+
+      size_t n = 0;
+      while (_p != _end && *_p >= '0' && *_p <= '9') {
+        n = n * 10 + (*_p++ - '0');
+        if (n > MAX_REPEAT) {
+          throw std::length_error("Repetition count too large in regex.");
+        }
+      }
+      return n;
+    }
+
+    std::unique_ptr<Node> atom() {
+      char c = *_p++;
+      std::unique_ptr<Node> node(new Node(Node::SET));
+
+      switch (c) {
+        case '(':
+          // "(?:" means the same as '(' here, since nothing captures.
+          if (_end - _p >= 2 && _p[0] == '?' && _p[1] == ':') {
+            _p += 2;
+          }
+          ++_depth;
+          node = alternation();
+          if (!at(')')) {
+            throw std::invalid_argument("Unbalanced '(' in regex.");
+          }
+          ++_p;
+          --_depth;
+          return node;
+
+        case '.':
+          node->set.set();
+          node->set.reset('\n');
+          return node;
+
+        case '[':
+          node->set = bracket();
+          return node;
+
+        case '\\':
+          node->set = escape();
+          return node;
+
+        case '*':
+        case '+':
+        case '?':
+        case '{':
+          throw std::invalid_argument("Nothing to repeat in regex.");
+
+        case '^':
+        case '$':
+          throw std::invalid_argument("Anchors are only supported at the ends of a regex.");
+
+        default:
+          break;
+      }
+
+      node->set.set(static_cast<unsigned char>(c));
+      return node;
+    }
+
+    std::bitset<256> escape() {
+      if (_p == _end) {
+        throw std::invalid_argument("Regex ends with '\\'.");
+      }
+
+      char c = *_p++;
+      std::bitset<256> set;
+
+      switch (c) {
+        case 'd':
+        case 'D':
+          for (int b = '0'; b <= '9'; ++b) {
+            set.set(b);
+          }
+          break;
+
+        case 'w':
+        case 'W':
+          for (int b = 0; b < 256; ++b) {
+            if ((b >= 'a' && b <= 'z') || (b >= 'A' && b <= 'Z') || (b >= '0' && b <= '9') || b == '_') {
+              set.set(b);
+            }
+          }
+          break;
+
+        case 's':
+        case 'S':
+          for (char b : {' ', '\t', '\n', '\r', '\f', '\v'}) {
+            set.set(static_cast<unsigned char>(b));
+          }
+          break;
+
+        case 'n':
+          set.set('\n');
+          return set;
+
+        case 't':
+          set.set('\t');
+          return set;
+
+        default:
+          set.set(static_cast<unsigned char>(c));
+          return set;
+      }
+
+      // The uppercase versions are the complements.
+      if (c == 'D' || c == 'W' || c == 'S') {
+        set.flip();
+      }
+      return set;
+    }
+
+    std::bitset<256> bracket() {
+      std::bitset<256> set;
+      bool negated = at('^');
+      if (negated) {
+        ++_p;
+      }
+
+      // A ']' right at the start is a member, not the end.
+      bool first = true;
+      while (_p != _end && (first || *_p != ']')) {
+        first = false;
+
+        unsigned char low = *_p++;
+
+        if (low == '\\') {
+          std::bitset<256> member = escape();
+          if (member.count() != 1) {
+            set |= member;
+            continue;
+          }
+          while (!member.test(low)) {
+            ++low;
+          }
+        }
+
+        unsigned char high = low;
+        if (_end - _p >= 2 && _p[0] == '-' && _p[1] != ']') {
+          high = static_cast<unsigned char>(_p[1]);
+          _p += 2;
+          if (high < low) {
+            throw std::invalid_argument("Reversed range in regex class.");
+          }
+        }
+
+        for (unsigned int b = low; b <= high; ++b) {
+          set.set(b);
+        }
+      }
+
+      if (_p == _end) {
+        throw std::invalid_argument("Unterminated '[' in regex.");
+      }
+      ++_p;
+
+      if (negated) {
+        set.flip();
+      }
+      return set;
+    }
+  };
+
+  private:
+  std::vector<NfaState> _nfa;
+  std::vector<std::bitset<256>> _sets;
+  int _nfa_start;
+
+  uint8_t _classes[256];
+  size_t _num_classes;
+  std::vector<unsigned char> _representatives;
+
+  bool _anchored_start;
+  bool _anchored_end;
+
+  size_t _max_dfa_states; // per DFA, before it's flushed
+  size_t _dfa_flushes;
+
+  LazyDfa _anchored;
+  LazyDfa _floating;
+
+    int add_state(NfaState::Type type, int set_id, int out, int out1) {
+      if (_nfa.size() >= MAX_NFA_STATES) {
+        throw std::length_error("Regex is too large.");
+      }
+      _nfa.push_back(NfaState{type, set_id, out, out1});
+      return static_cast<int>(_nfa.size() - 1);
+    }
+
+    // Thompson construction, built backwards: compiles node so that it
+    // continues at next, and returns its start state.
+    int compile(const Node& node, int next) {
+      switch (node.type) {
+        case Node::SET:
+          _sets.push_back(node.set);
+          return add_state(NfaState::SET, static_cast<int>(_sets.size() - 1), next, -1);
+
+        case Node::EMPTY:
+          return next;
+
+        case Node::CONCAT:
+          for (size_t i = node.children.size(); i-- > 0;) {
+            next = compile(*node.children[i], next);
+          }
+          return next;
+
+        case Node::ALTERNATE: {
+          int start = compile(*node.children.back(), next);
+          for (size_t i = node.children.size() - 1; i-- > 0;) {
+            start = add_state(NfaState::SPLIT, -1, compile(*node.children[i], next), start);
+          }
+          return start;
+        }
+
+        default:
+          break;
+      }
+
+      // REPEAT: x{m,n} is m copies of x followed by n - m nested optionals,
+      // and x{m,} is m copies followed by x*.
+      const Node& body = *node.children[0];
+      int tail;
+
+      if (node.max == REPEAT_FOREVER) {
+        int loop = add_state(NfaState::SPLIT, -1, -1, next);
+        _nfa[loop].out = compile(body, loop);
+        tail = loop;
+      }
+      else {
+        tail = next;
+        for (size_t i = node.min; i < node.max; ++i) {
+          int copy = compile(body, tail);
+          tail = add_state(NfaState::SPLIT, -1, copy, next);
+        }
+      }
+
+      for (size_t i = 0; i < node.min; ++i) {
+        tail = compile(body, tail);
+      }
+      return tail;
+    }
+
+    // Bytes that are in exactly the same sets get the same class.
+    void compute_classes() {
+      std::memset(_classes, 0, sizeof(_classes));
+      _num_classes = 1;
+
+      for (const std::bitset<256>& set : _sets) {
+        std::map<std::pair<int, bool>, int> split;
+        for (int b = 0; b < 256; ++b) {
+          std::pair<int, bool> key(_classes[b], set.test(b));
+          auto found = split.find(key);
+          if (found == split.end()) {
+            found = split.emplace(key, static_cast<int>(split.size())).first;
+          }
+          _classes[b] = static_cast<uint8_t>(found->second);
+        }
+        _num_classes = split.size();
+      }
+
+      _representatives.assign(_num_classes, 0);
+      for (int b = 255; b >= 0; --b) {
+        _representatives[_classes[b]] = static_cast<unsigned char>(b);
+      }
+    }
+
+    // Adds the epsilon closure of state to states.
+    void closure(int state, std::vector<int>& states, std::vector<bool>& seen) const {
+      std::vector<int> stack(1, state);
+
+      while (!stack.empty()) {
+        int s = stack.back();
+        stack.pop_back();
+        if (seen[s]) {
+          continue;
+        }
+        seen[s] = true;
+
+        if (_nfa[s].type == NfaState::SPLIT) {
+          stack.push_back(_nfa[s].out1);
+          stack.push_back(_nfa[s].out);
+        }
+        else {
+          states.push_back(s);
+        }
+      }
+    }
+
+    int intern(LazyDfa& dfa, std::vector<int>&& states) {
+      std::sort(states.begin(), states.end());
+
+      auto found = dfa.ids.find(states);
+      if (found != dfa.ids.end()) {
+        return found->second;
+      }
+
+      bool accepting = false;
+      for (int s : states) {
+        accepting = accepting || (_nfa[s].type == NfaState::MATCH);
+      }
+
+      int id = static_cast<int>(dfa.sets.size());
+      dfa.ids.emplace(states, id);
+      dfa.sets.push_back(std::move(states));
+      dfa.accepting.push_back(accepting);
+      dfa.next.resize(dfa.next.size() + _num_classes, LazyDfa::UNKNOWN);
+      return id;
+    }
+
+    void reset(LazyDfa& dfa, bool floating) {
+      dfa.floating = floating;
+      dfa.sets.clear();
+      dfa.ids.clear();
+      dfa.next.clear();
+      dfa.accepting.clear();
+
+      std::vector<int> states;
+      std::vector<bool> seen(_nfa.size(), false);
+      closure(_nfa_start, states, seen);
+      dfa.start = intern(dfa, std::move(states));
+    }
+
+    // Computes (and caches) the transition of dfa state on byte class k.
+    // Returns the new state, which may live in a freshly flushed cache.
+    int step(LazyDfa& dfa, int state, size_t k) {
+      unsigned char byte = _representatives[k];
+      std::vector<int> states;
+      std::vector<bool> seen(_nfa.size(), false);
+
+      for (int s : dfa.sets[state]) {
+        if (_nfa[s].type == NfaState::SET && _sets[_nfa[s].set_id].test(byte)) {
+          closure(_nfa[s].out, states, seen);
+        }
+      }
+      if (dfa.floating) {
+        closure(_nfa_start, states, seen);
+      }
+
+      // The cache is full: start over, keeping only where we are now.
+      // Each byte still costs at most one NFA step, so we stay linear.
+      if (dfa.sets.size() >= _max_dfa_states) {
+        ++_dfa_flushes;
+        reset(dfa, dfa.floating);
+        return intern(dfa, std::move(states));
+      }
+
+      int target = intern(dfa, std::move(states));
+      dfa.next[state * _num_classes + k] = target;
+      return target;
+    }
+
+    // Runs dfa over s[from, length) starting at state. If stop_early is set,
+    // returns as soon as an accepting state is reached; longest, if not
+    // null, is set to the end of the longest match seen.
+    // Returns the final state, or -1 if it stopped early.
+    int run(LazyDfa& dfa, int state, const SmallString& s, size_t from, bool stop_early, size_t* longest) {
+      if (dfa.accepting[state]) {
+        if (stop_early) {
+          return -1;
+        }
+        if (longest != nullptr) {
+          *longest = from;
+        }
+      }
+
+      size_t length = s.length();
+      size_t i = from;
+
+      while (i < length) {
+        const char* segment = (i < BUFFER_LIMIT) ? s.inline_data() + i : s.spilled_data() + (i - BUFFER_LIMIT);
+        size_t segment_end = (i < BUFFER_LIMIT) ? s.inline_length() : length;
+
+        for (; i < segment_end; ++i) {
+          size_t k = _classes[static_cast<unsigned char>(*segment++)];
+          int target = dfa.next[state * _num_classes + k];
+          state = (target == LazyDfa::UNKNOWN) ? step(dfa, state, k) : target;
+
+          if (dfa.sets[state].empty()) {
+            return state;
+          }
+          if (dfa.accepting[state]) {
+            if (stop_early) {
+              return -1;
+            }
+            if (longest != nullptr) {
+              *longest = i + 1;
+            }
+          }
+        }
+      }
+
+      return state;
+    }
+
+  public:
+  // Compiles the pattern; throws std::invalid_argument if it's malformed,
+  // and std::length_error if it's unreasonably large. Each of the two
+  // lazy DFAs is flushed when it reaches max_dfa_states states.
+  explicit Regex(const char* pattern, size_t max_dfa_states = MAX_DFA_STATES) : _max_dfa_states(max_dfa_states), _dfa_flushes(0) {
+    if (max_dfa_states == 0) {
+      throw std::invalid_argument("A regex needs room for at least one DFA state.");
+    }
+
+    const char* begin = pattern;
+    const char* end = pattern + std::strlen(pattern);
+
+    _anchored_start = (begin != end && *begin == '^');
+    if (_anchored_start) {
+      ++begin;
+    }
+
+    // A trailing '$' is an anchor unless it's escaped.
+    _anchored_end = false;
+    if (begin != end && end[-1] == '$') {
+      size_t backslashes = 0;
+      for (const char* p = end - 1; p != begin && p[-1] == '\\'; --p) {
+        ++backslashes;
+      }
+      if (backslashes % 2 == 0) {
+        _anchored_end = true;
+        --end;
+      }
+    }
+
+    Parser parser(begin, end);
+    std::unique_ptr<Node> ast = parser.parse();
+    if ((_anchored_start || _anchored_end) && parser.top_level_alternation()) {
+      throw std::invalid_argument("An anchored regex can't have a '|' outside a group: write \"^(a|b)\".");
+    }
+
+    int match = add_state(NfaState::MATCH, -1, -1, -1);
+    _nfa_start = compile(*ast, match);
+
+    compute_classes();
+    reset(_anchored, false);
+    reset(_floating, true);
+  }
+
+  // Whether the whole string matches (as if the pattern were "^...$").
+  bool full_match(const SmallString& s) {
+    int state = run(_anchored, _anchored.start, s, 0, false, nullptr);
+    return _anchored.accepting[state];
+  }
+
+  // Whether the pattern matches somewhere in s, honoring '^' and '$'.
+  bool search(const SmallString& s) {
+    LazyDfa& dfa = _anchored_start ? _anchored : _floating;
+    int state = run(dfa, dfa.start, s, 0, !_anchored_end, nullptr);
+    return state == -1 || dfa.accepting[state];
+  }
+
+  // The length of the longest match starting exactly at pos, or NOT_FOUND;
+  // this is what field extraction needs. '$' is honored, '^' is ignored.
+  size_t match_length(const SmallString& s, size_t pos = 0) {
+    size_t longest = NOT_FOUND;
+    int state = run(_anchored, _anchored.start, s, pos, false, &longest);
+
+    if (_anchored_end) {
+      return _anchored.accepting[state] ? s.length() - pos : NOT_FOUND;
+    }
+    return (longest == NOT_FOUND) ? NOT_FOUND : longest - pos;
+  }
+
+  // For curiosity's sake (and for the tests): how much of the DFA exists.
+  size_t dfa_states() const noexcept {
+    return _anchored.sets.size() + _floating.sets.size();
+  }
+
+  size_t dfa_flushes() const noexcept {
+    return _dfa_flushes;
+  }
+
+  size_t byte_classes() const noexcept {
+    return _num_classes;
+  }
+
+};
+
+#endif
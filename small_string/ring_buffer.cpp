@@ -0,0 +1,244 @@
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "ring_buffer.hpp"
+
+using namespace std;
+
+static string item(size_t producer, size_t i) {
+  string s = to_string(producer) + ":" + to_string(i);
+  if (i % 4 == 0) {
+    s += " with a tail long enough to spill";
+  }
+  return s;
+}
+
+// Counts Fallback allocations (and frees) on the threads that install it.
+static atomic<size_t> allocations(0);
+static atomic<size_t> releases(0);
+
+static char* counting_allocate(void*, size_t n) {
+  ++allocations;
+  return new char[n];
+}
+
+static void counting_release(void*, char* p, size_t) noexcept {
+  ++releases;
+  delete[] p;
+}
+
+static const CharHooks COUNTING{nullptr, counting_allocate, counting_release};
+
+// TESTS
+
+int main() {
+
+  static_assert(is_nothrow_move_constructible<SmallString>::value);
+  static_assert(is_nothrow_move_assignable<SmallString>::value);
+
+  // Relocation
+  {
+    SmallString a("relocated, and long enough to spill");
+    alignas(SmallString) unsigned char bytes[sizeof(SmallString)];
+    a.relocate_to(bytes);
+    assert (a.length() == 0 && a.spilled_data() == nullptr);
+    SmallString b;
+    b.relocate_from(bytes);
+    assert (b.str() == "relocated, and long enough to spill");
+  }
+
+  // Popping into a cleared string that still owns a fallback frees it
+  {
+    char_hooks = &COUNTING;
+    size_t allocated = allocations;
+    size_t released = releases;
+    {
+      SpscRing spsc(4);
+      MpscRing mpsc(4);
+      SmallString out("a consumer buffer long enough to spill");
+      out.clear();
+
+      assert (spsc.try_push(SmallString("pushed, and long enough to spill too")));
+      assert (spsc.try_pop(out) && out.str() == "pushed, and long enough to spill too");
+      out.clear();
+      assert (mpsc.try_push(SmallString("and through the MPSC ring as well")));
+      assert (mpsc.try_pop(out) && out.str() == "and through the MPSC ring as well");
+
+      vector<SmallString> batch(1);
+      batch[0].append("a batch slot long enough to spill");
+      batch[0].clear();
+      assert (spsc.try_push(SmallString("one more, and long enough to spill")));
+      assert (spsc.pop_batch(span<SmallString>(batch)) == 1);
+      assert (batch[0].str() == "one more, and long enough to spill");
+    }
+    assert (allocations - allocated == releases - released);
+    char_hooks = nullptr;
+  }
+
+  // SPSC, single threaded
+  {
+    SpscRing ring(3);
+    assert (ring.capacity() == 4 && ring.size() == 0);
+
+    SmallString out;
+    assert (!ring.try_pop(out));
+
+    for (size_t i = 0; i < 4; ++i) {
+      SmallString s(item(0, i).c_str());
+      assert (ring.try_push(std::move(s)));
+      assert (s.length() == 0);
+    }
+    SmallString extra("left alone when full");
+    assert (!ring.try_push(std::move(extra)));
+    assert (extra.str() == "left alone when full");
+
+    assert (ring.try_pop(out) && out.str() == item(0, 0));
+    out.empty();
+
+    vector<SmallString> batch(5);
+    assert (ring.pop_batch(span<SmallString>(batch)) == 3);
+    for (size_t i = 0; i < 3; ++i) {
+      assert (batch[i].str() == item(0, i + 1));
+    }
+
+    vector<SmallString> many;
+    for (size_t i = 0; i < 6; ++i) {
+      many.push_back(SmallString(item(1, i).c_str()));
+    }
+    assert (ring.push_batch(span<SmallString>(many)) == 4);
+    assert (many[3].length() == 0 && many[4].str() == item(1, 4));
+    // The destructor frees what's left
+  }
+
+  // MPSC, single threaded
+  {
+    MpscRing ring(4);
+    vector<SmallString> many;
+    for (size_t i = 0; i < 3; ++i) {
+      many.push_back(SmallString(item(2, i).c_str()));
+    }
+    assert (ring.push_batch(span<SmallString>(many)) == 3);
+    SmallString s(item(2, 3).c_str());
+    assert (ring.try_push(std::move(s)));
+    SmallString t("full");
+    assert (!ring.try_push(std::move(t)) && t.str() == "full");
+    assert (ring.size() == 4);
+
+    vector<SmallString> out(2);
+    assert (ring.pop_batch(span<SmallString>(out)) == 2);
+    assert (out[0].str() == item(2, 0) && out[1].str() == item(2, 1));
+
+    // Wraps around
+    many.clear();
+    for (size_t i = 0; i < 3; ++i) {
+      many.push_back(SmallString(item(3, i).c_str()));
+    }
+    assert (ring.push_batch(span<SmallString>(many)) == 2);
+  }
+
+  // SPSC across threads: everything arrives, in order; inline strings
+  // cost no allocation on either side
+  {
+    const size_t N = 200000;
+    SpscRing ring(1024);
+    allocations = 0;
+
+    thread producer([&]() {
+      vector<SmallString> made;
+      for (size_t i = 0; i < N; ++i) {
+        made.push_back(SmallString(to_string(i).c_str()));
+      }
+      char_hooks = &COUNTING;
+      size_t sent = 0;
+      while (sent < N) {
+        size_t n = ring.push_batch(span<SmallString>(made).subspan(sent, min<size_t>(64, N - sent)));
+        if (n == 0) {
+          this_thread::yield();
+        }
+        sent += n;
+      }
+      char_hooks = nullptr;
+    });
+
+    char_hooks = &COUNTING;
+    SmallString out;
+    for (size_t i = 0; i < N;) {
+      if (ring.try_pop(out)) {
+        assert (out.str() == to_string(i));
+        out = SmallString();
+        ++i;
+      }
+      else {
+        this_thread::yield();
+      }
+    }
+    char_hooks = nullptr;
+    producer.join();
+    assert (allocations == 0);
+  }
+
+  // MPSC across threads: each producer's items arrive in its order
+  {
+    const size_t PRODUCERS = 4;
+    const size_t N = 50000;
+    MpscRing ring(256);
+
+    vector<thread> producers;
+    for (size_t p = 0; p < PRODUCERS; ++p) {
+      producers.emplace_back([&, p]() {
+        for (size_t i = 0; i < N;) {
+          if (i % 2 == 0) {
+            SmallString s(item(p, i).c_str());
+            if (ring.try_push(std::move(s))) {
+              ++i;
+            }
+            else {
+              this_thread::yield();
+            }
+          }
+          else {
+            vector<SmallString> batch;
+            for (size_t j = i; j < i + 8 && j < N; ++j) {
+              batch.push_back(SmallString(item(p, j).c_str()));
+            }
+            size_t n = ring.push_batch(span<SmallString>(batch));
+            if (n == 0) {
+              this_thread::yield();
+            }
+            i += n;
+          }
+        }
+      });
+    }
+
+    vector<size_t> next(PRODUCERS, 0);
+    vector<SmallString> out(16);
+    size_t received = 0;
+    while (received < PRODUCERS * N) {
+      size_t n = ring.pop_batch(span<SmallString>(out));
+      for (size_t i = 0; i < n; ++i) {
+        string s = out[i].str();
+        size_t p = stoul(s.substr(0, s.find(':')));
+        assert (s == item(p, next[p]));
+        ++next[p];
+        out[i].empty();
+      }
+      received += n;
+      if (n == 0) {
+        this_thread::yield();
+      }
+    }
+    for (thread& t : producers) {
+      t.join();
+    }
+    assert (ring.size() == 0);
+  }
+
+  return 0;
+
+}
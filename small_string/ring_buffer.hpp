@@ -0,0 +1,283 @@
+#ifndef RING_BUFFER_HPP
+#define RING_BUFFER_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <span>
+#include <stdexcept>
+
+#include "small_string.hpp"
+
+/*
+Ring buffers:
+Bounded lock-free queues for handing SmallStrings from thread to
+thread: SpscRing for one producer and one consumer, MpscRing for many
+producers and one consumer.
+
+Strings are relocated, not moved: push memcpys the SmallString's bytes
+into a slot and leaves the source empty, pop memcpys them back out. The
+Fallback (if any) just changes hands, so an inline string crosses with
+no allocation at all, and nothing runs but two memcpys. Slots are 64
+bytes each, so neighbouring pushes and pops don't share cache lines.
+
+SpscRing: the producer owns the tail, the consumer the head, each on its
+own cache line; each side keeps a stale copy of the other's index and
+only rereads it when the ring looks full (or empty). Batch operations
+publish the whole batch with one store.
+
+MpscRing: producers claim positions by CAS on the tail, and every slot
+has a sequence number that says whose turn it is (Vyukov's bounded
+queue): position p can be written when the slot's sequence is p, read
+when it is p + 1, and reading sets it to p + capacity. A batch push
+claims a run of positions with one CAS, going by the consumer's head.
+
+try_push takes its string by rvalue reference, and leaves it alone if
+the ring was full. Capacities are rounded up to a power of two.
+*/
+
+namespace ring_detail {
+
+  inline size_t round_capacity(size_t capacity) {
+    if (capacity == 0 || capacity > (size_t(1) << 40)) {
+      throw std::invalid_argument("Invalid ring capacity");
+    }
+    size_t size = 1;
+    while (size < capacity) {
+      size <<= 1;
+    }
+    return size;
+  }
+
+}
+
+class SpscRing {
+
+  struct alignas(64) Slot {
+    unsigned char bytes[sizeof(SmallString)];
+  };
+
+  private:
+  std::unique_ptr<Slot[]> _slots;
+  size_t _mask;
+
+  alignas(64) std::atomic<size_t> _tail;
+  size_t _cached_head; // The producer's copy.
+
+  alignas(64) std::atomic<size_t> _head;
+  size_t _cached_tail; // The consumer's copy.
+
+    // Producer: room for up to n more, rereading the head if need be.
+    size_t room(size_t tail, size_t n) noexcept {
+      size_t capacity = _mask + 1;
+      if (capacity - (tail - _cached_head) < n) {
+        _cached_head = _head.load(std::memory_order_acquire);
+      }
+      return capacity - (tail - _cached_head);
+    }
+
+    // Consumer: how many are ready, rereading the tail if need be.
+    size_t ready(size_t head, size_t n) noexcept {
+      if (_cached_tail - head < n) {
+        _cached_tail = _tail.load(std::memory_order_acquire);
+      }
+      return _cached_tail - head;
+    }
+
+  public:
+  explicit SpscRing(size_t capacity)
+    : _slots(new Slot[ring_detail::round_capacity(capacity)]), _mask(ring_detail::round_capacity(capacity) - 1),
+      _tail(0), _cached_head(0), _head(0), _cached_tail(0) {}
+
+  SpscRing(const SpscRing&) = delete;
+  SpscRing& operator=(const SpscRing&) = delete;
+
+  // Whatever is still queued is freed.
+  ~SpscRing() noexcept {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    for (size_t i = _head.load(std::memory_order_relaxed); i != tail; ++i) {
+      SmallString dropped;
+      dropped.relocate_from(_slots[i & _mask].bytes);
+    }
+  }
+
+  size_t capacity() const noexcept {
+    return _mask + 1;
+  }
+
+  // Only exact when neither side is busy.
+  size_t size() const noexcept {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+  }
+
+  // Producer only.
+  bool try_push(SmallString&& s) noexcept {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    if (room(tail, 1) == 0) {
+      return false;
+    }
+    s.relocate_to(_slots[tail & _mask].bytes);
+    _tail.store(tail + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Producer only: pushes a prefix of items (as much as fits), leaving
+  // those strings empty; returns its length.
+  size_t push_batch(std::span<SmallString> items) noexcept {
+    size_t tail = _tail.load(std::memory_order_relaxed);
+    size_t n = room(tail, items.size());
+    n = (n < items.size()) ? n : items.size();
+    for (size_t i = 0; i < n; ++i) {
+      items[i].relocate_to(_slots[(tail + i) & _mask].bytes);
+    }
+    _tail.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  // Consumer only. Whatever out held is dropped.
+  bool try_pop(SmallString& out) noexcept {
+    size_t head = _head.load(std::memory_order_relaxed);
+    if (ready(head, 1) == 0) {
+      return false;
+    }
+    out.relocate_from(_slots[head & _mask].bytes);
+    _head.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only: overwrites a prefix of out; returns its length.
+  size_t pop_batch(std::span<SmallString> out) noexcept {
+    size_t head = _head.load(std::memory_order_relaxed);
+    size_t n = ready(head, out.size());
+    n = (n < out.size()) ? n : out.size();
+    for (size_t i = 0; i < n; ++i) {
+      out[i].relocate_from(_slots[(head + i) & _mask].bytes);
+    }
+    _head.store(head + n, std::memory_order_release);
+    return n;
+  }
+
+};
+
+class MpscRing {
+
+  struct alignas(64) Slot {
+    std::atomic<size_t> sequence;
+    unsigned char bytes[sizeof(SmallString)];
+  };
+
+  private:
+  std::unique_ptr<Slot[]> _slots;
+  size_t _mask;
+
+  alignas(64) std::atomic<size_t> _tail;
+  alignas(64) std::atomic<size_t> _head;
+
+  public:
+  explicit MpscRing(size_t capacity)
+    : _slots(new Slot[ring_detail::round_capacity(capacity)]), _mask(ring_detail::round_capacity(capacity) - 1),
+      _tail(0), _head(0) {
+    for (size_t i = 0; i <= _mask; ++i) {
+      _slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+  }
+
+  MpscRing(const MpscRing&) = delete;
+  MpscRing& operator=(const MpscRing&) = delete;
+
+  ~MpscRing() noexcept {
+    SmallString dropped;
+    while (try_pop(dropped)) {
+      dropped.empty();
+    }
+  }
+
+  size_t capacity() const noexcept {
+    return _mask + 1;
+  }
+
+  // Only exact when nobody is busy.
+  size_t size() const noexcept {
+    return _tail.load(std::memory_order_acquire) - _head.load(std::memory_order_acquire);
+  }
+
+  // Any producer.
+  bool try_push(SmallString&& s) noexcept {
+    size_t position = _tail.load(std::memory_order_relaxed);
+    while (true) {
+      Slot& slot = _slots[position & _mask];
+      size_t sequence = slot.sequence.load(std::memory_order_acquire);
+      intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+
+      if (diff == 0) {
+        if (_tail.compare_exchange_weak(position, position + 1, std::memory_order_relaxed)) {
+          s.relocate_to(slot.bytes);
+          slot.sequence.store(position + 1, std::memory_order_release);
+          return true;
+        }
+      }
+      else if (diff < 0) {
+        return false; // Full.
+      }
+      else {
+        position = _tail.load(std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Any producer: claims a run of positions in one go and pushes a prefix
+  // of items into it; returns its length. The consumer frees positions in
+  // order and publishes its head after their sequences, so everything
+  // below head + capacity is free.
+  size_t push_batch(std::span<SmallString> items) noexcept {
+    size_t position = _tail.load(std::memory_order_relaxed);
+    size_t n = 0;
+    while (true) {
+      size_t limit = _head.load(std::memory_order_acquire) + capacity();
+      if (limit <= position) {
+        return 0; // Full.
+      }
+      n = (items.size() < limit - position) ? items.size() : limit - position;
+      if (n == 0) {
+        return 0;
+      }
+      if (_tail.compare_exchange_weak(position, position + n, std::memory_order_relaxed)) {
+        break;
+      }
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      Slot& slot = _slots[(position + i) & _mask];
+      items[i].relocate_to(slot.bytes);
+      slot.sequence.store(position + i + 1, std::memory_order_release);
+    }
+    return n;
+  }
+
+  // Consumer only. Whatever out held is dropped.
+  bool try_pop(SmallString& out) noexcept {
+    size_t position = _head.load(std::memory_order_relaxed);
+    Slot& slot = _slots[position & _mask];
+    if (slot.sequence.load(std::memory_order_acquire) != position + 1) {
+      return false;
+    }
+    out.relocate_from(slot.bytes);
+    slot.sequence.store(position + capacity(), std::memory_order_release);
+    _head.store(position + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Consumer only: overwrites a prefix of out, stopping at the
+  // first position not yet written; returns its length.
+  size_t pop_batch(std::span<SmallString> out) noexcept {
+    size_t n = 0;
+    while (n < out.size() && try_pop(out[n])) {
+      ++n;
+    }
+    return n;
+  }
+
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include <iostream>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "ring_buffer.hpp"
+
+using namespace std;
+
+/*
+A parser thread handing N records to a worker thread: SpscRing (one at
+a time, and in batches of 64) vs a mutex around a std::queue with a
+condition variable. Records are mostly inline, one in eight spills.
+*/
+
+static volatile size_t sink;
+
+static vector<SmallString> records(size_t n) {
+  vector<SmallString> out;
+  for (size_t i = 0; i < n; ++i) {
+    string s = "record-" + to_string(i);
+    if (i % 8 == 0) {
+      s += "/with/a/path/long/enough/to/spill";
+    }
+    out.push_back(SmallString(s.c_str()));
+  }
+  return out;
+}
+
+template <typename Producer, typename Consumer>
+static double time_ms(Producer produce, Consumer consume) {
+  auto start = chrono::steady_clock::now();
+  thread producer(produce);
+  consume();
+  producer.join();
+  return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+int main() {
+
+  const size_t N = 2000000;
+  const size_t BATCH = 64;
+
+  {
+    vector<SmallString> in = records(N);
+    SpscRing ring(4096);
+    double ms = time_ms([&]() {
+      for (size_t i = 0; i < N;) {
+        if (ring.try_push(std::move(in[i]))) {
+          ++i;
+        }
+        else {
+          this_thread::yield();
+        }
+      }
+    }, [&]() {
+      size_t total = 0;
+      SmallString out;
+      for (size_t i = 0; i < N;) {
+        if (ring.try_pop(out)) {
+          total += out.length();
+          out.empty();
+          ++i;
+        }
+        else {
+          this_thread::yield();
+        }
+      }
+      sink = total;
+    });
+    cout << "SpscRing, one by one:    " << ms << " ms (" << ms * 1e6 / N << " ns/record)" << endl;
+  }
+
+  {
+    vector<SmallString> in = records(N);
+    SpscRing ring(4096);
+    double ms = time_ms([&]() {
+      for (size_t i = 0; i < N;) {
+        size_t n = ring.push_batch(span<SmallString>(in).subspan(i, min(BATCH, N - i)));
+        if (n == 0) {
+          this_thread::yield();
+        }
+        i += n;
+      }
+    }, [&]() {
+      size_t total = 0;
+      vector<SmallString> out(BATCH);
+      for (size_t i = 0; i < N;) {
+        size_t n = ring.pop_batch(span<SmallString>(out));
+        for (size_t j = 0; j < n; ++j) {
+          total += out[j].length();
+          out[j].empty();
+        }
+        if (n == 0) {
+          this_thread::yield();
+        }
+        i += n;
+      }
+      sink = total;
+    });
+    cout << "SpscRing, batches of 64: " << ms << " ms (" << ms * 1e6 / N << " ns/record)" << endl;
+  }
+
+  {
+    vector<SmallString> in = records(N);
+    mutex lock;
+    condition_variable ready;
+    queue<SmallString> shared;
+    double ms = time_ms([&]() {
+      for (size_t i = 0; i < N; ++i) {
+        {
+          lock_guard<mutex> guard(lock);
+          shared.push(std::move(in[i]));
+        }
+        ready.notify_one();
+      }
+    }, [&]() {
+      size_t total = 0;
+      for (size_t i = 0; i < N; ++i) {
+        unique_lock<mutex> guard(lock);
+        ready.wait(guard, [&]() {
+          return !shared.empty();
+        });
+        SmallString out = std::move(shared.front());
+        shared.pop();
+        guard.unlock();
+        total += out.length();
+      }
+      sink = total;
+    });
+    cout << "mutex + std::queue:      " << ms << " ms (" << ms * 1e6 / N << " ns/record)" << endl;
+  }
+
+  return 0;
+}
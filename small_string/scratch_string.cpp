@@ -0,0 +1,116 @@
+#include <iostream>
+#include <cassert>
+#include <string>
+#include <thread>
+
+#include "scratch_string.hpp"
+
+using namespace std;
+
+// Counts Fallback allocations on this thread.
+static size_t allocations = 0;
+
+static char* counting_allocate(void*, size_t n) {
+  ++allocations;
+  return new char[n];
+}
+
+static void counting_release(void*, char* p, size_t) noexcept {
+  delete[] p;
+}
+
+static const CharHooks COUNTING{nullptr, counting_allocate, counting_release};
+
+static string format(size_t id) {
+  ScratchString line;
+  line->append("request ");
+  line->append(to_string(id).c_str());
+  line->append(" handled by a worker with a long enough name");
+  return line->str();
+}
+
+// TESTS
+
+int main() {
+
+  // clear() keeps the fallback, empty() doesn't
+  {
+    SmallString s("long enough to need a fallback of its own");
+    size_t footprint = s.heap_footprint();
+    s.clear();
+    assert (s.length() == 0 && s.heap_footprint() == footprint);
+    s.append("short");
+    assert (s.str() == "short");
+    s.append(" and then long enough again to spill");
+    assert (s.str() == "short and then long enough again to spill");
+    assert (s.heap_footprint() == footprint);
+    s.empty();
+    assert (s.heap_footprint() == 0);
+
+    // Moves and copies of a cleared string
+    SmallString t("another one long enough to need a fallback");
+    t.clear();
+    t.append("abc");
+    SmallString u = std::move(t);
+    assert (u.str() == "abc");
+    SmallString v = u;
+    assert (v.str() == "abc" && v.heap_footprint() == 0);
+  }
+
+  // Steady state: no allocations at all
+  {
+    char_hooks = &COUNTING;
+    assert (format(1) == "request 1 handled by a worker with a long enough name");
+    size_t warm = allocations;
+    assert (warm > 0 && ScratchPool::pooled() == 1);
+
+    for (size_t i = 0; i < 1000; ++i) {
+      assert (format(i) == "request " + to_string(i) + " handled by a worker with a long enough name");
+    }
+    assert (allocations == warm);
+
+    // Nested temporaries borrow different strings
+    {
+      ScratchString a;
+      ScratchString b;
+      a->append("a");
+      b->append("b");
+      assert (a->str() == "a" && b.get().str() == "b");
+    }
+    assert (ScratchPool::pooled() == 2);
+    char_hooks = nullptr;
+  }
+
+  // Bounded: strings that grew too much are freed, not kept
+  {
+    size_t before = ScratchPool::pooled();
+    {
+      ScratchString huge;
+      huge->append(string(100000, 'x').c_str());
+    }
+    assert (ScratchPool::pooled() == before - 1);
+    assert (ScratchPool::pooled_bytes() <= 64 * 1024);
+
+    // And never more than MAX_STRINGS
+    {
+      ScratchString many[40];
+      for (ScratchString& s : many) {
+        s->append("a scratch string that spills into a fallback");
+      }
+    }
+    assert (ScratchPool::pooled() == 16);
+    assert (ScratchPool::pooled_bytes() <= 64 * 1024);
+  }
+
+  // Every thread has its own pool
+  thread other([]() {
+    assert (ScratchPool::pooled() == 0);
+    format(7);
+    assert (ScratchPool::pooled() == 1);
+  });
+  other.join();
+  assert (ScratchPool::pooled() == 16);
+
+  return 0;
+
+}
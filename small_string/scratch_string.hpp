@@ -0,0 +1,115 @@
+#ifndef SCRATCH_STRING_HPP
+#define SCRATCH_STRING_HPP
+
+#include <cstddef>
+#include <utility>
+#include <vector>
+
+#include "small_string.hpp"
+
+/*
+ScratchString:
+A temporary SmallString borrowed from a per-thread pool, for formatting
+and the like. It is handed back on scope exit, cleared with clear(), so
+it keeps its fallback: once the pool's strings have grown to what the
+thread's temporaries need, borrowing and returning them never touches
+the allocator (inline temporaries never did).
+
+The pool is bounded: at most MAX_STRINGS strings, holding at most
+MAX_BYTES on the heap between them (by heap_footprint). A string that
+would break either bound is freed instead of kept, and so is one that
+grew past MAX_STRING_BYTES on its own, so one odd huge temporary isn't
+kept around for good.
+
+Assigning a whole new value to the string (operator=) drops what it
+kept; append to it instead.
+*/
+
+class ScratchPool {
+
+  static constexpr size_t MAX_STRINGS = 16;
+  static constexpr size_t MAX_BYTES = 64 * 1024;
+  static constexpr size_t MAX_STRING_BYTES = 16 * 1024;
+
+  friend class ScratchString;
+
+  private:
+  std::vector<SmallString> _free;
+  size_t _bytes;
+
+    ScratchPool() : _bytes(0) {
+      _free.reserve(MAX_STRINGS);
+    }
+
+    static ScratchPool& local() {
+      static thread_local ScratchPool pool;
+      return pool;
+    }
+
+    SmallString take() noexcept {
+      if (_free.empty()) {
+        return SmallString();
+      }
+      SmallString s = std::move(_free.back());
+      _free.pop_back();
+      _bytes -= s.heap_footprint();
+      return s;
+    }
+
+    // Never allocates: _free has its room reserved.
+    void give_back(SmallString& s) noexcept {
+      size_t footprint = s.heap_footprint();
+      if (_free.size() == MAX_STRINGS || footprint > MAX_STRING_BYTES || _bytes + footprint > MAX_BYTES) {
+        s.empty();
+        return;
+      }
+      s.clear();
+      _bytes += footprint;
+      _free.push_back(std::move(s));
+    }
+
+  public:
+  ScratchPool(const ScratchPool&) = delete;
+  ScratchPool& operator=(const ScratchPool&) = delete;
+
+  // This thread's pool, as it stands.
+  static size_t pooled() {
+    return local()._free.size();
+  }
+
+  static size_t pooled_bytes() {
+    return local()._bytes;
+  }
+
+};
+
+class ScratchString {
+
+  private:
+  SmallString _string;
+
+  public:
+  ScratchString() : _string(ScratchPool::local().take()) {}
+
+  ScratchString(const ScratchString&) = delete;
+  ScratchString& operator=(const ScratchString&) = delete;
+
+  ~ScratchString() noexcept {
+    ScratchPool::local().give_back(_string);
+  }
+
+  SmallString& get() noexcept {
+    return _string;
+  }
+
+  SmallString& operator*() noexcept {
+    return _string;
+  }
+
+  SmallString* operator->() noexcept {
+    return &_string;
+  }
+
+};
+
+#endif
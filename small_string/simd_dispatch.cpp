@@ -0,0 +1,179 @@
+#include <iostream>
+#include <cassert>
+#include <cctype>
+#include <cstdlib>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "simd_dispatch.hpp"
+
+using namespace std;
+
+// Every kernel of `level` against the scalar one, over lengths and
+// offsets that cover whole vectors, tails and misalignment, with bytes
+// around the case ranges and above 0x7F.
+static void differential(const SimdKernels& tested) {
+  const SimdKernels& reference = kernels_for(SimdLevel::SCALAR);
+  mt19937 random(1234);
+  const char interesting[] = {'@', 'A', 'M', 'Z', '[', '`', 'a', 'm', 'z', '{', '\0', '\x7f', '\x80', '\xc1', '\xff'};
+
+  for (size_t n = 0; n <= 200; ++n) {
+    for (size_t offset = 0; offset < 4; ++offset) {
+      vector<char> a(n + offset + 64);
+      for (char& c : a) {
+        c = (random() % 2) ? interesting[random() % sizeof(interesting)] : char(random());
+      }
+      vector<char> b = a;
+      const char* p = a.data() + offset;
+
+      // equal: same, and differing at every position
+      assert (tested.equal(p, b.data() + offset, n));
+      for (size_t i = 0; i < n; i += 1 + n / 16) {
+        b[offset + i] ^= 1;
+        assert (tested.equal(p, b.data() + offset, n) == reference.equal(p, b.data() + offset, n));
+        assert (!tested.equal(p, b.data() + offset, n));
+        b[offset + i] ^= 1;
+      }
+
+      // find_byte: present, absent, and only past the end
+      for (char c : interesting) {
+        assert (tested.find_byte(p, n, c) == reference.find_byte(p, n, c));
+      }
+      vector<char> zeros(n + 64, 'x');
+      zeros[n] = 'y';
+      assert (tested.find_byte(zeros.data(), n, 'y') == n);
+
+      // Case conversion; the bytes past n must not be touched
+      vector<char> lower_tested = a;
+      vector<char> lower_reference = a;
+      tested.to_lower(lower_tested.data() + offset, n);
+      reference.to_lower(lower_reference.data() + offset, n);
+      assert (lower_tested == lower_reference);
+
+      vector<char> upper_tested = a;
+      vector<char> upper_reference = a;
+      tested.to_upper(upper_tested.data() + offset, n);
+      reference.to_upper(upper_reference.data() + offset, n);
+      assert (upper_tested == upper_reference);
+    }
+  }
+}
+
+// The SmallString operations through `k`: strings inline (spilled
+// segment nullptr), spilled, and split at every place around the buffer
+// limit, against std::string.
+static void check_small_strings(const SimdKernels& k) {
+  SmallString a("Mixed Case, and long enough to SPILL into the fallback");
+  SmallString b("Mixed Case, and long enough to SPILL into the fallback");
+  SmallString c("Mixed Case, and long enough to SPILL into the fallbacK");
+  assert (simd_equals(k, a, b) && !simd_equals(k, a, c));
+  assert (!simd_equals(k, a, SmallString("Mixed")));
+  assert (simd_find(k, a, 'M') == 0 && simd_find(k, a, 'S') == 31 && simd_find(k, a, 'k') == 53);
+  assert (simd_find(k, a, 'q') == SIZE_MAX);
+  simd_to_lower(k, a);
+  assert (a.str() == "mixed case, and long enough to spill into the fallback");
+  simd_to_upper(k, a);
+  assert (a.str() == "MIXED CASE, AND LONG ENOUGH TO SPILL INTO THE FALLBACK");
+
+  SmallString inline_only("Short, Inline");
+  assert (inline_only.spilled_data() == nullptr && inline_only.spilled_length() == 0);
+  assert (simd_equals(k, inline_only, SmallString("Short, Inline")));
+  assert (!simd_equals(k, inline_only, SmallString("Short, InlinE")));
+  assert (simd_find(k, inline_only, 'I') == 7 && simd_find(k, inline_only, 'x') == SIZE_MAX);
+  simd_to_upper(k, inline_only);
+  assert (inline_only == "SHORT, INLINE");
+  simd_to_lower(k, inline_only);
+  assert (inline_only == "short, inline");
+
+  SmallString empty_string;
+  simd_to_lower(k, empty_string);
+  simd_to_upper(k, empty_string);
+  assert (simd_find(k, empty_string, 'a') == SIZE_MAX && simd_equals(k, empty_string, SmallString()));
+
+  for (size_t n = 0; n <= 2 * BUFFER_LIMIT + 40; ++n) {
+    string text;
+    for (size_t i = 0; i < n; ++i) {
+      text += "aBcDeFgHiJ"[i % 10];
+    }
+    SmallString s(text.data(), text.size());
+    assert ((s.spilled_data() == nullptr) == (n <= BUFFER_LIMIT));
+
+    // A byte that only shows up at i, on either side of the limit
+    for (size_t i = 0; i < n; ++i) {
+      string marked = text;
+      marked[i] = '#';
+      SmallString t(marked.data(), marked.size());
+      assert (simd_find(k, t, '#') == i);
+      assert (!simd_equals(k, s, t) && !simd_equals(k, t, s));
+    }
+    assert (simd_find(k, s, '#') == SIZE_MAX);
+    assert (simd_equals(k, s, SmallString(text.data(), text.size())));
+
+    string lower = text;
+    string upper = text;
+    for (size_t i = 0; i < n; ++i) {
+      lower[i] = static_cast<char>(tolower(static_cast<unsigned char>(lower[i])));
+      upper[i] = static_cast<char>(toupper(static_cast<unsigned char>(upper[i])));
+    }
+    simd_to_lower(k, s);
+    assert (s.str() == lower);
+    simd_to_upper(k, s);
+    assert (s.str() == upper);
+  }
+}
+
+// TESTS
+
+int main() {
+
+  // Forced before first use, so it decides the table in use
+  setenv("SMALL_STRING_SIMD", "scalar", 1);
+  assert (simd_kernels().level == SimdLevel::SCALAR);
+  assert (&simd_kernels() == &kernels_for(SimdLevel::SCALAR));
+
+  assert (parse_simd_level("avx2") == SimdLevel::AVX2);
+  assert (parse_simd_level("sse4.2") == SimdLevel::SSE42);
+  bool thrown = false;
+  try {
+    parse_simd_level("mmx");
+  }
+  catch (const invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  // Every level this machine has, against the scalar reference, and the
+  // SmallString operations through each
+  SimdLevel best = detected_simd_level();
+  size_t checked = 0;
+  for (SimdLevel level : {SimdLevel::SCALAR, SimdLevel::SSE42, SimdLevel::AVX2, SimdLevel::AVX512}) {
+    if (level > best) {
+      thrown = false;
+      try {
+        kernels_for(level);
+      }
+      catch (const invalid_argument&) {
+        thrown = true;
+      }
+      assert (thrown);
+      continue;
+    }
+    differential(kernels_for(level));
+    check_small_strings(kernels_for(level));
+    ++checked;
+  }
+  assert (checked == static_cast<size_t>(best) + 1);
+
+  // Without a table: the one in use
+  SmallString spilled("long enough to spill into the fallback, Mixed Case");
+  assert (simd_equals(spilled, SmallString(spilled)) && simd_find(spilled, 'M') == 40);
+  simd_to_upper(spilled);
+  assert (spilled.str() == "LONG ENOUGH TO SPILL INTO THE FALLBACK, MIXED CASE");
+  simd_to_lower(spilled);
+  assert (spilled.str() == "long enough to spill into the fallback, mixed case");
+
+  return 0;
+
+}
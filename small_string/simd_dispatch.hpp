@@ -0,0 +1,376 @@
+#ifndef SIMD_DISPATCH_HPP
+#define SIMD_DISPATCH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SMALL_STRING_X86 1
+#include <immintrin.h>
+#endif
+
+#include "small_string.hpp"
+
+/*
+SIMD dispatch:
+Byte kernels for SmallString segments (equality, finding a byte, ASCII
+case conversion) in a scalar reference version and, on x86, SSE4.2,
+AVX2 and AVX-512BW versions, picked at run time so that one binary runs
+on any of them.
+
+Each level is a table of function pointers. The vector versions are
+compiled with GCC's target attribute, so the rest of the program needs
+no -m flags, and only ever called once CPUID (__builtin_cpu_supports)
+says the machine has the instructions.
+
+The table is picked on first use: the best level the machine supports,
+or the one in the SMALL_STRING_SIMD environment variable (scalar,
+sse4.2, avx2 or avx512), if the machine supports that. kernels_for()
+hands out any supported level's table, which is how the vector versions
+get tested against the scalar one on the same machine.
+
+The SIMD loops do whole vectors and leave the tail to the scalar code,
+except AVX-512, which does the tail with a masked load.
+*/
+
+enum class SimdLevel { SCALAR, SSE42, AVX2, AVX512 };
+
+struct SimdKernels {
+  SimdLevel level;
+  const char* name;
+  bool (*equal)(const char* a, const char* b, size_t n);
+  // The index of the first c, or n.
+  size_t (*find_byte)(const char* p, size_t n, char c);
+  void (*to_lower)(char* p, size_t n);
+  void (*to_upper)(char* p, size_t n);
+};
+
+namespace simd_detail {
+
+  inline bool equal_scalar(const char* a, const char* b, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      if (a[i] != b[i]) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  inline size_t find_byte_scalar(const char* p, size_t n, char c) {
+    for (size_t i = 0; i < n; ++i) {
+      if (p[i] == c) {
+        return i;
+      }
+    }
+    return n;
+  }
+
+  inline void to_lower_scalar(char* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      if (p[i] >= 'A' && p[i] <= 'Z') {
+        p[i] = static_cast<char>(p[i] + ('a' - 'A'));
+      }
+    }
+  }
+
+  inline void to_upper_scalar(char* p, size_t n) {
+    for (size_t i = 0; i < n; ++i) {
+      if (p[i] >= 'a' && p[i] <= 'z') {
+        p[i] = static_cast<char>(p[i] - ('a' - 'A'));
+      }
+    }
+  }
+
+#ifdef SMALL_STRING_X86
+
+  // SSE4.2 (all of it SSE2, really, but that's the level we sort by).
+
+  __attribute__((target("sse4.2"))) inline bool equal_sse42(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(a + i));
+      __m128i y = _mm_loadu_si128(reinterpret_cast<const __m128i*>(b + i));
+      if (_mm_movemask_epi8(_mm_cmpeq_epi8(x, y)) != 0xFFFF) {
+        return false;
+      }
+    }
+    return equal_scalar(a + i, b + i, n - i);
+  }
+
+  __attribute__((target("sse4.2"))) inline size_t find_byte_sse42(const char* p, size_t n, char c) {
+    __m128i needle = _mm_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 16 <= n; i += 16) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(x, needle));
+      if (mask != 0) {
+        return i + __builtin_ctz(mask);
+      }
+    }
+    return i + find_byte_scalar(p + i, n - i, c);
+  }
+
+  // Bytes in [low, high] get bit 0x20 flipped. The compares are signed,
+  // so bytes from 0x80 up (negative) are never in range.
+  __attribute__((target("sse4.2"))) inline void flip_case_sse42(char* p, size_t n, char low, char high) {
+    __m128i below = _mm_set1_epi8(static_cast<char>(low - 1));
+    __m128i above = _mm_set1_epi8(static_cast<char>(high + 1));
+    __m128i bit = _mm_set1_epi8(0x20);
+    for (size_t i = 0; i + 16 <= n; i += 16) {
+      __m128i x = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + i));
+      __m128i in_range = _mm_and_si128(_mm_cmpgt_epi8(x, below), _mm_cmplt_epi8(x, above));
+      _mm_storeu_si128(reinterpret_cast<__m128i*>(p + i), _mm_xor_si128(x, _mm_and_si128(in_range, bit)));
+    }
+  }
+
+  __attribute__((target("sse4.2"))) inline void to_lower_sse42(char* p, size_t n) {
+    flip_case_sse42(p, n, 'A', 'Z');
+    to_lower_scalar(p + (n & ~size_t(15)), n & 15);
+  }
+
+  __attribute__((target("sse4.2"))) inline void to_upper_sse42(char* p, size_t n) {
+    flip_case_sse42(p, n, 'a', 'z');
+    to_upper_scalar(p + (n & ~size_t(15)), n & 15);
+  }
+
+  // AVX2: the same, 32 bytes at a time.
+
+  __attribute__((target("avx2"))) inline bool equal_avx2(const char* a, const char* b, size_t n) {
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(a + i));
+      __m256i y = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(b + i));
+      if (static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, y))) != 0xFFFFFFFFu) {
+        return false;
+      }
+    }
+    return equal_sse42(a + i, b + i, n - i);
+  }
+
+  __attribute__((target("avx2"))) inline size_t find_byte_avx2(const char* p, size_t n, char c) {
+    __m256i needle = _mm256_set1_epi8(c);
+    size_t i = 0;
+    for (; i + 32 <= n; i += 32) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      uint32_t mask = static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(x, needle)));
+      if (mask != 0) {
+        return i + __builtin_ctz(mask);
+      }
+    }
+    return i + find_byte_sse42(p + i, n - i, c);
+  }
+
+  __attribute__((target("avx2"))) inline void flip_case_avx2(char* p, size_t n, char low, char high) {
+    __m256i below = _mm256_set1_epi8(static_cast<char>(low - 1));
+    __m256i above = _mm256_set1_epi8(static_cast<char>(high + 1));
+    __m256i bit = _mm256_set1_epi8(0x20);
+    for (size_t i = 0; i + 32 <= n; i += 32) {
+      __m256i x = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p + i));
+      __m256i in_range = _mm256_and_si256(_mm256_cmpgt_epi8(x, below), _mm256_cmpgt_epi8(above, x));
+      _mm256_storeu_si256(reinterpret_cast<__m256i*>(p + i), _mm256_xor_si256(x, _mm256_and_si256(in_range, bit)));
+    }
+  }
+
+  __attribute__((target("avx2"))) inline void to_lower_avx2(char* p, size_t n) {
+    flip_case_avx2(p, n, 'A', 'Z');
+    to_lower_sse42(p + (n & ~size_t(31)), n & 31);
+  }
+
+  __attribute__((target("avx2"))) inline void to_upper_avx2(char* p, size_t n) {
+    flip_case_avx2(p, n, 'a', 'z');
+    to_upper_sse42(p + (n & ~size_t(31)), n & 31);
+  }
+
+  // AVX-512BW: 64 bytes at a time, and the tail through a mask.
+
+  __attribute__((target("avx512f,avx512bw"))) inline __mmask64 tail_mask(size_t left) {
+    return (left >= 64) ? ~__mmask64(0) : (__mmask64(1) << left) - 1;
+  }
+
+  __attribute__((target("avx512f,avx512bw"))) inline bool equal_avx512(const char* a, const char* b, size_t n) {
+    for (size_t i = 0; i < n; i += 64) {
+      __mmask64 live = tail_mask(n - i);
+      __m512i x = _mm512_maskz_loadu_epi8(live, a + i);
+      __m512i y = _mm512_maskz_loadu_epi8(live, b + i);
+      if (_mm512_cmpneq_epi8_mask(x, y) != 0) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  __attribute__((target("avx512f,avx512bw"))) inline size_t find_byte_avx512(const char* p, size_t n, char c) {
+    __m512i needle = _mm512_set1_epi8(c);
+    for (size_t i = 0; i < n; i += 64) {
+      __mmask64 live = tail_mask(n - i);
+      __m512i x = _mm512_maskz_loadu_epi8(live, p + i);
+      __mmask64 found = _mm512_mask_cmpeq_epi8_mask(live, x, needle);
+      if (found != 0) {
+        return i + __builtin_ctzll(found);
+      }
+    }
+    return n;
+  }
+
+  __attribute__((target("avx512f,avx512bw"))) inline void flip_case_avx512(char* p, size_t n, char low, char high) {
+    __m512i from = _mm512_set1_epi8(low);
+    __m512i to = _mm512_set1_epi8(high);
+    __m512i bit = _mm512_set1_epi8(0x20);
+    for (size_t i = 0; i < n; i += 64) {
+      __mmask64 live = tail_mask(n - i);
+      __m512i x = _mm512_maskz_loadu_epi8(live, p + i);
+      __mmask64 in_range = _mm512_mask_cmpge_epi8_mask(live, x, from) & _mm512_cmple_epi8_mask(x, to);
+      _mm512_mask_storeu_epi8(p + i, in_range, _mm512_xor_si512(x, bit));
+    }
+  }
+
+  __attribute__((target("avx512f,avx512bw"))) inline void to_lower_avx512(char* p, size_t n) {
+    flip_case_avx512(p, n, 'A', 'Z');
+  }
+
+  __attribute__((target("avx512f,avx512bw"))) inline void to_upper_avx512(char* p, size_t n) {
+    flip_case_avx512(p, n, 'a', 'z');
+  }
+
+#endif
+
+  inline const SimdKernels SCALAR_KERNELS{SimdLevel::SCALAR, "scalar", equal_scalar, find_byte_scalar,
+                                          to_lower_scalar, to_upper_scalar};
+
+#ifdef SMALL_STRING_X86
+  inline const SimdKernels SSE42_KERNELS{SimdLevel::SSE42, "sse4.2", equal_sse42, find_byte_sse42, to_lower_sse42,
+                                         to_upper_sse42};
+  inline const SimdKernels AVX2_KERNELS{SimdLevel::AVX2, "avx2", equal_avx2, find_byte_avx2, to_lower_avx2,
+                                        to_upper_avx2};
+  inline const SimdKernels AVX512_KERNELS{SimdLevel::AVX512, "avx512", equal_avx512, find_byte_avx512,
+                                          to_lower_avx512, to_upper_avx512};
+#endif
+
+}
+
+// The best level this machine has.
+inline SimdLevel detected_simd_level() noexcept {
+#ifdef SMALL_STRING_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+    return SimdLevel::AVX512;
+  }
+  if (__builtin_cpu_supports("avx2")) {
+    return SimdLevel::AVX2;
+  }
+  if (__builtin_cpu_supports("sse4.2")) {
+    return SimdLevel::SSE42;
+  }
+#endif
+  return SimdLevel::SCALAR;
+}
+
+// A level by name (as in SMALL_STRING_SIMD); throws on anything else.
+inline SimdLevel parse_simd_level(std::string_view name) {
+  if (name == "scalar") {
+    return SimdLevel::SCALAR;
+  }
+  if (name == "sse4.2" || name == "sse42") {
+    return SimdLevel::SSE42;
+  }
+  if (name == "avx2") {
+    return SimdLevel::AVX2;
+  }
+  if (name == "avx512") {
+    return SimdLevel::AVX512;
+  }
+  throw std::invalid_argument("Unknown SIMD level");
+}
+
+// The table for a level; throws if this machine can't run it.
+inline const SimdKernels& kernels_for(SimdLevel level) {
+  if (level > detected_simd_level()) {
+    throw std::invalid_argument("SIMD level not supported by this CPU");
+  }
+
+  switch (level) {
+#ifdef SMALL_STRING_X86
+    case SimdLevel::AVX512:
+      return simd_detail::AVX512_KERNELS;
+    case SimdLevel::AVX2:
+      return simd_detail::AVX2_KERNELS;
+    case SimdLevel::SSE42:
+      return simd_detail::SSE42_KERNELS;
+#endif
+    default:
+      return simd_detail::SCALAR_KERNELS;
+  }
+}
+
+// The table in use, picked on first call. A bad or unsupported
+// SMALL_STRING_SIMD is ignored (the best level is used).
+inline const SimdKernels& simd_kernels() {
+  static const SimdKernels& chosen = []() -> const SimdKernels& {
+    SimdLevel level = detected_simd_level();
+    const char* forced = std::getenv("SMALL_STRING_SIMD");
+    if (forced != nullptr) {
+      try {
+        SimdLevel wanted = parse_simd_level(forced);
+        level = (wanted <= level) ? wanted : level;
+      }
+      catch (const std::invalid_argument&) {
+      }
+    }
+    return kernels_for(level);
+  }();
+  return chosen;
+}
+
+// SmallString operations, segment by segment, through a given table
+// (kernels_for) or the one in use. An inline string's spilled segment is
+// empty (and may be nullptr).
+
+inline bool simd_equals(const SimdKernels& k, const SmallString& a, const SmallString& b) {
+  if (a.length() != b.length()) {
+    return false;
+  }
+  return k.equal(a.inline_data(), b.inline_data(), a.inline_length()) &&
+         k.equal(a.spilled_data(), b.spilled_data(), a.spilled_length());
+}
+
+inline bool simd_equals(const SmallString& a, const SmallString& b) {
+  return simd_equals(simd_kernels(), a, b);
+}
+
+// The index of the first c, or SIZE_MAX.
+inline size_t simd_find(const SimdKernels& k, const SmallString& s, char c) {
+  size_t i = k.find_byte(s.inline_data(), s.inline_length(), c);
+  if (i != s.inline_length()) {
+    return i;
+  }
+  size_t j = k.find_byte(s.spilled_data(), s.spilled_length(), c);
+  return (j != s.spilled_length()) ? BUFFER_LIMIT + j : SIZE_MAX;
+}
+
+inline size_t simd_find(const SmallString& s, char c) {
+  return simd_find(simd_kernels(), s, c);
+}
+
+inline void simd_to_lower(const SimdKernels& k, SmallString& s) {
+  k.to_lower(s.inline_data(), s.inline_length());
+  k.to_lower(s.spilled_data(), s.spilled_length());
+}
+
+inline void simd_to_lower(SmallString& s) {
+  simd_to_lower(simd_kernels(), s);
+}
+
+inline void simd_to_upper(const SimdKernels& k, SmallString& s) {
+  k.to_upper(s.inline_data(), s.inline_length());
+  k.to_upper(s.spilled_data(), s.spilled_length());
+}
+
+inline void simd_to_upper(SmallString& s) {
+  simd_to_upper(simd_kernels(), s);
+}
+
+#endif
@@ -0,0 +1,176 @@
+#include <iostream>
+#include <cassert>
+#include <cmath>
+#include <map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "sketches.hpp"
+
+using namespace std;
+
+// A skewed stream: key k shows up about 1/k as often as key 1.
+static vector<SmallString> make_stream(size_t n, size_t keys, uint64_t seed) {
+  vector<SmallString> stream;
+  uint64_t x = seed;
+  for (size_t i = 0; i < n; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    double u = static_cast<double>(x >> 11) / 9007199254740992.0;
+    size_t k = static_cast<size_t>(std::pow(static_cast<double>(keys), u));
+    string key = (k % 2 ? "event/" : "a rather long event name, number ") + to_string(k);
+    stream.push_back(SmallString(key.c_str()));
+  }
+  return stream;
+}
+
+// TESTS
+
+int main() {
+
+  vector<SmallString> stream = make_stream(200000, 50000, 1);
+  map<string, uint64_t> exact;
+  for (const SmallString& s : stream) {
+    ++exact[s.str()];
+  }
+
+  // Space-Saving
+  SpaceSaving top(200);
+  for (const SmallString& s : stream) {
+    top.update(s);
+  }
+  assert (top.total() == stream.size());
+
+  vector<HeavyHitter> hitters = top.top(20);
+  assert (hitters.size() == 20);
+  for (size_t i = 0; i < hitters.size(); ++i) {
+    uint64_t real = exact[hitters[i].key.str()];
+    assert (hitters[i].count >= real && hitters[i].count - hitters[i].error <= real);
+    assert (i == 0 || hitters[i - 1].count >= hitters[i].count);
+  }
+
+  // Everything above N / capacity is in there
+  for (const auto& entry : exact) {
+    if (entry.second > stream.size() / 200) {
+      assert (top.count(SmallString(entry.first.c_str())) >= entry.second);
+    }
+  }
+  assert (top.count(SmallString("never seen")) == 0);
+
+  // Keys with '\0' in them come back whole
+  SpaceSaving binary(4);
+  binary.update(SmallString("a\0b", 3), 5);
+  binary.update(SmallString("a"), 1);
+  assert (binary.top(1)[0].key.length() == 3);
+  assert (binary.count(SmallString("a")) == 1);
+
+  // Weighted updates and evictions keep the guarantees: the counts add
+  // up to the total, and bound the real counts from both sides
+  {
+    SpaceSaving weighted(16);
+    map<string, uint64_t> real;
+    uint64_t x = 7;
+    for (size_t i = 0; i < 20000; ++i) {
+      x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+      string key = "k" + to_string((x >> 33) % ((i % 3 == 0) ? 8 : 200));
+      uint64_t weight = (x >> 20) % 4;
+      weighted.update(SmallString(key.c_str()), weight);
+      real[key] += weight;
+    }
+    uint64_t sum = 0;
+    for (const HeavyHitter& hit : weighted.top(16)) {
+      sum += hit.count;
+      assert (hit.count >= real[hit.key.str()] && hit.count - hit.error <= real[hit.key.str()]);
+    }
+    assert (sum == weighted.total());
+  }
+
+  // Count-min
+  CountMinSketch counts(2048, 4);
+  assert (counts.width() == 2048);
+  for (const SmallString& s : stream) {
+    counts.update(s);
+  }
+  size_t off = 0;
+  for (const auto& entry : exact) {
+    uint64_t estimate = counts.estimate(SmallString(entry.first.c_str()));
+    assert (estimate >= entry.second);
+    off += (estimate - entry.second > 2 * stream.size() / counts.width());
+  }
+  assert (off < exact.size() / 10);
+
+  // HyperLogLog
+  HyperLogLog distinct(12);
+  for (const SmallString& s : stream) {
+    distinct.add(s);
+  }
+  double error = std::fabs(distinct.estimate() - static_cast<double>(exact.size())) / exact.size();
+  assert (error < 3 * 1.04 / 64);
+
+  HyperLogLog few(12);
+  for (size_t i = 0; i < 100; ++i) {
+    few.add(SmallString(to_string(i).c_str()));
+  }
+  assert (std::fabs(few.estimate() - 100) < 5);
+
+  // One sketch per thread, merged at the end
+  vector<vector<SmallString>> parts = {
+    make_stream(100000, 50000, 2), make_stream(100000, 50000, 3), make_stream(100000, 50000, 4)};
+
+  vector<SpaceSaving> tops(parts.size(), SpaceSaving(200));
+  vector<CountMinSketch> sketches(parts.size(), CountMinSketch(2048, 4));
+  vector<HyperLogLog> logs(parts.size(), HyperLogLog(12));
+  vector<thread> threads;
+  for (size_t t = 0; t < parts.size(); ++t) {
+    threads.emplace_back([&, t]() {
+      for (const SmallString& s : parts[t]) {
+        tops[t].update(s);
+        sketches[t].update(s);
+        logs[t].add(s);
+      }
+    });
+  }
+  for (thread& t : threads) {
+    t.join();
+  }
+
+  map<string, uint64_t> merged_exact;
+  for (const auto& part : parts) {
+    for (const SmallString& s : part) {
+      ++merged_exact[s.str()];
+    }
+  }
+
+  for (size_t t = 1; t < parts.size(); ++t) {
+    tops[0].merge(tops[t]);
+    sketches[0].merge(sketches[t]);
+    logs[0].merge(logs[t]);
+  }
+  assert (tops[0].total() == 300000);
+
+  for (const HeavyHitter& hit : tops[0].top(10)) {
+    uint64_t real = merged_exact[hit.key.str()];
+    assert (hit.count >= real && hit.count - hit.error <= real);
+  }
+  for (const auto& entry : merged_exact) {
+    SmallString key(entry.first.c_str());
+    assert (sketches[0].estimate(key) >= entry.second);
+    if (entry.second > 300000 / 200 * 3) {
+      assert (tops[0].count(key) >= entry.second);
+    }
+  }
+  error = std::fabs(logs[0].estimate() - static_cast<double>(merged_exact.size())) / merged_exact.size();
+  assert (error < 3 * 1.04 / 64);
+
+  bool thrown = false;
+  try {
+    logs[0].merge(HyperLogLog(10));
+  }
+  catch (const std::invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  return 0;
+
+}
@@ -0,0 +1,526 @@
+#ifndef SKETCHES_HPP
+#define SKETCHES_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <stdexcept>
+#include <string_view>
+#include <vector>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+Stream sketches:
+Summaries of an unbounded stream of SmallStrings in a fixed amount of
+memory. Every update hashes the string in place (hash_string) once,
+and never copies it unless it has to be kept.
+
+SpaceSaving: the (approximate) top-K. It tracks `capacity` keys; a new
+key takes over the least counted one, inheriting its count as error.
+Counts are overestimates by at most `error`, and any key seen more than
+N / capacity times is guaranteed to be tracked. The tracked keys are
+interned in one byte arena, which is compacted once it's mostly garbage.
+Counters are kept in a Stream-Summary: a list of buckets of equal count,
+smallest first, so the least counted key is always at the head and a
+unit increment just moves a counter to the next bucket (O(1); a weight
+w walks at most w buckets).
+
+An update of a tracked key takes a few tens of ns, but one that evicts
+doesn't: it misses in the index, deletes the victim from it, copies the
+new key into the arena and moves the counter, and takes about 130 ns
+(sketches_bench.cpp, 1000 counters). Each of those steps costs 20 to
+30 ns of it, so there's no single thing left to cut.
+
+CountMinSketch: an overestimate of any key's count, off by at most
+2N / width with probability 1 - 2^-depth.
+
+HyperLogLog: the number of distinct keys, with a standard error of
+about 1.04 / sqrt(2^precision).
+
+All three merge with a sketch of the same shape, so every thread can
+keep its own and they get combined at the end.
+*/
+
+struct HeavyHitter {
+  SmallString key;
+  uint64_t count;
+  // count - error is a lower bound on the real count.
+  uint64_t error;
+};
+
+class SpaceSaving {
+
+  static constexpr uint32_t EMPTY = UINT32_MAX;
+
+  struct Counter {
+    uint64_t count;
+    uint64_t error;
+    uint64_t hash;
+    size_t offset; // of the key in the arena
+    size_t length;
+    // Its bucket, and its neighbours there (EMPTY at the ends).
+    uint32_t bucket;
+    uint32_t prev;
+    uint32_t next;
+  };
+
+  // The counters with one count; buckets are linked by increasing count.
+  struct Bucket {
+    uint64_t count;
+    uint32_t first;
+    uint32_t prev;
+    uint32_t next;
+  };
+
+  private:
+  size_t _capacity;
+  std::vector<Counter> _counters;
+  std::vector<Bucket> _buckets;
+  std::vector<uint32_t> _free_buckets;
+  uint32_t _smallest;
+  uint32_t _largest;
+  // Linear probing from the key's hash to its counter.
+  std::vector<uint32_t> _table;
+  size_t _mask;
+  std::vector<char> _arena;
+  size_t _dead_bytes;
+  uint64_t _total;
+
+    std::string_view key_of(const Counter& counter) const noexcept {
+      return std::string_view(_arena.data() + counter.offset, counter.length);
+    }
+
+    size_t find_slot(const SmallString& key, uint64_t hash) const noexcept {
+      size_t slot = hash & _mask;
+      while (_table[slot] != EMPTY) {
+        const Counter& counter = _counters[_table[slot]];
+        if (counter.hash == hash && equals(key, key_of(counter))) {
+          return slot;
+        }
+        slot = (slot + 1) & _mask;
+      }
+      return slot;
+    }
+
+    // Backward-shift deletion: pulls later entries of the probe run into
+    // the hole, so lookups never need tombstones.
+    void erase_slot(size_t hole) noexcept {
+      size_t next = (hole + 1) & _mask;
+      while (_table[next] != EMPTY) {
+        size_t home = _counters[_table[next]].hash & _mask;
+        if (((next - home) & _mask) >= ((next - hole) & _mask)) {
+          _table[hole] = _table[next];
+          hole = next;
+        }
+        next = (next + 1) & _mask;
+      }
+      _table[hole] = EMPTY;
+    }
+
+    void store_key(Counter& counter, const SmallString& key) {
+      _dead_bytes += counter.length;
+
+      // Mostly garbage: copy the live keys to a fresh arena.
+      if (_dead_bytes > 4096 && _dead_bytes * 2 > _arena.size()) {
+        std::vector<char> compacted;
+        compacted.reserve(_arena.size() - _dead_bytes + key.length());
+        for (Counter& other : _counters) {
+          if (&other != &counter) {
+            std::string_view bytes = key_of(other);
+            other.offset = compacted.size();
+            compacted.insert(compacted.end(), bytes.begin(), bytes.end());
+          }
+        }
+        _arena.swap(compacted);
+        _dead_bytes = 0;
+      }
+
+      counter.offset = _arena.size();
+      counter.length = key.length();
+      _arena.insert(_arena.end(), key.inline_data(), key.inline_data() + key.inline_length());
+      if (key.spilled_length() != 0) {
+        _arena.insert(_arena.end(), key.spilled_data(), key.spilled_data() + key.spilled_length());
+      }
+    }
+
+    // A bucket for count between prev and next (either may be EMPTY).
+    uint32_t new_bucket(uint64_t count, uint32_t prev, uint32_t next) {
+      uint32_t b;
+      if (_free_buckets.empty()) {
+        b = static_cast<uint32_t>(_buckets.size());
+        _buckets.push_back(Bucket{count, EMPTY, prev, next});
+      }
+      else {
+        b = _free_buckets.back();
+        _free_buckets.pop_back();
+        _buckets[b] = Bucket{count, EMPTY, prev, next};
+      }
+
+      if (prev == EMPTY) {
+        _smallest = b;
+      }
+      else {
+        _buckets[prev].next = b;
+      }
+      if (next == EMPTY) {
+        _largest = b;
+      }
+      else {
+        _buckets[next].prev = b;
+      }
+      return b;
+    }
+
+    // Takes a counter out of its bucket, dropping the bucket if that
+    // leaves it empty.
+    void detach(uint32_t index) noexcept {
+      Counter& counter = _counters[index];
+      Bucket& bucket = _buckets[counter.bucket];
+
+      if (counter.prev == EMPTY) {
+        bucket.first = counter.next;
+      }
+      else {
+        _counters[counter.prev].next = counter.next;
+      }
+      if (counter.next != EMPTY) {
+        _counters[counter.next].prev = counter.prev;
+      }
+
+      if (bucket.first == EMPTY) {
+        if (bucket.prev == EMPTY) {
+          _smallest = bucket.next;
+        }
+        else {
+          _buckets[bucket.prev].next = bucket.next;
+        }
+        if (bucket.next == EMPTY) {
+          _largest = bucket.prev;
+        }
+        else {
+          _buckets[bucket.next].prev = bucket.prev;
+        }
+        _free_buckets.push_back(counter.bucket);
+      }
+    }
+
+    // Puts a detached counter in the bucket for its count, looking from
+    // after (a bucket with a smaller count, or EMPTY for the start).
+    void place(uint32_t index, uint32_t after) {
+      uint64_t count = _counters[index].count;
+      uint32_t next = (after == EMPTY) ? _smallest : _buckets[after].next;
+      while (next != EMPTY && _buckets[next].count < count) {
+        after = next;
+        next = _buckets[next].next;
+      }
+
+      uint32_t b = (next != EMPTY && _buckets[next].count == count) ? next : new_bucket(count, after, next);
+      Counter& counter = _counters[index];
+      counter.bucket = b;
+      counter.prev = EMPTY;
+      counter.next = _buckets[b].first;
+      if (counter.next != EMPTY) {
+        _counters[counter.next].prev = index;
+      }
+      _buckets[b].first = index;
+    }
+
+    void raise(uint32_t index, uint64_t by) {
+      if (by == 0) {
+        return;
+      }
+
+      // Where to look from: this bucket, unless it goes away with the
+      // counter, in which case the one before it.
+      Counter& counter = _counters[index];
+      uint32_t after = (counter.prev == EMPTY && counter.next == EMPTY) ? _buckets[counter.bucket].prev : counter.bucket;
+      detach(index);
+      counter.count += by;
+      place(index, after);
+    }
+
+    void add(const SmallString& key, uint64_t hash, uint64_t count, uint64_t error) {
+      size_t slot = find_slot(key, hash);
+
+      if (_table[slot] != EMPTY) {
+        uint32_t index = _table[slot];
+        _counters[index].error += error;
+        raise(index, count);
+        return;
+      }
+
+      if (_counters.size() < _capacity) {
+        uint32_t index = static_cast<uint32_t>(_counters.size());
+        _counters.push_back(Counter{count, error, hash, 0, 0, EMPTY, EMPTY, EMPTY});
+        store_key(_counters.back(), key);
+        _table[slot] = index;
+
+        // Counts no bigger than the smallest go at the start (merge adds
+        // them in decreasing order, so that's all of them there); bigger
+        // ones are looked for from the end.
+        uint32_t after = EMPTY;
+        if (_smallest != EMPTY && count > _buckets[_smallest].count) {
+          after = _largest;
+          while (_buckets[after].count >= count) {
+            after = _buckets[after].prev;
+          }
+        }
+        place(index, after);
+        return;
+      }
+
+      // Take over a smallest counter.
+      uint32_t index = _buckets[_smallest].first;
+      Counter& victim = _counters[index];
+      erase_slot(find_slot_of(index));
+
+      victim.error = victim.count + error;
+      victim.hash = hash;
+      store_key(victim, key);
+
+      _table[find_slot(key, hash)] = index;
+      raise(index, count);
+    }
+
+    size_t find_slot_of(uint32_t index) const noexcept {
+      size_t slot = _counters[index].hash & _mask;
+      while (_table[slot] != index) {
+        slot = (slot + 1) & _mask;
+      }
+      return slot;
+    }
+
+    const Counter* lookup(const SmallString& key) const noexcept {
+      size_t slot = find_slot(key, hash_string(key));
+      return (_table[slot] == EMPTY) ? nullptr : &_counters[_table[slot]];
+    }
+
+    uint64_t min_count() const noexcept {
+      return (_counters.size() < _capacity) ? 0 : _buckets[_smallest].count;
+    }
+
+  public:
+  explicit SpaceSaving(size_t capacity)
+    : _capacity(capacity), _smallest(EMPTY), _largest(EMPTY), _dead_bytes(0), _total(0) {
+    if (capacity == 0 || capacity >= EMPTY / 2) {
+      throw std::invalid_argument("Invalid capacity");
+    }
+
+    size_t table_size = 1;
+    while (table_size < 2 * capacity) {
+      table_size <<= 1;
+    }
+    _table.assign(table_size, EMPTY);
+    _mask = table_size - 1;
+
+    _counters.reserve(capacity);
+    _buckets.reserve(capacity);
+  }
+
+  size_t capacity() const noexcept {
+    return _capacity;
+  }
+
+  // The sum of all the updates.
+  uint64_t total() const noexcept {
+    return _total;
+  }
+
+  void update(const SmallString& key, uint64_t weight = 1) {
+    _total += weight;
+    add(key, hash_string(key), weight, 0);
+  }
+
+  // The estimated count of a key (0 if it isn't tracked).
+  uint64_t count(const SmallString& key) const noexcept {
+    const Counter* counter = lookup(key);
+    return (counter == nullptr) ? 0 : counter->count;
+  }
+
+  // The n most counted keys, most counted first.
+  std::vector<HeavyHitter> top(size_t n) const {
+    std::vector<uint32_t> order(_counters.size());
+    for (uint32_t i = 0; i < order.size(); ++i) {
+      order[i] = i;
+    }
+
+    size_t keep = (n < order.size()) ? n : order.size();
+    std::partial_sort(order.begin(), order.begin() + keep, order.end(), [this](uint32_t a, uint32_t b) {
+      return _counters[a].count > _counters[b].count;
+    });
+
+    std::vector<HeavyHitter> result;
+    result.reserve(keep);
+    for (size_t i = 0; i < keep; ++i) {
+      const Counter& counter = _counters[order[i]];
+      std::string_view bytes = key_of(counter);
+      result.push_back(HeavyHitter{SmallString(bytes.data(), bytes.size()), counter.count, counter.error});
+    }
+    return result;
+  }
+
+  /*
+  Merging: a key missing from one side may still have been seen there,
+  up to that side's smallest count, so that's what it gets charged (as
+  count and as error). The capacity largest results are kept.
+  */
+  void merge(const SpaceSaving& other) {
+    if (other._capacity != _capacity) {
+      throw std::invalid_argument("Sketches of different capacities");
+    }
+
+    uint64_t own_min = min_count();
+    uint64_t other_min = other.min_count();
+
+    std::vector<HeavyHitter> all = top(_counters.size());
+    for (HeavyHitter& hit : all) {
+      const Counter* seen = other.lookup(hit.key);
+      hit.count += (seen != nullptr) ? seen->count : other_min;
+      hit.error += (seen != nullptr) ? seen->error : other_min;
+    }
+    for (const HeavyHitter& hit : other.top(other._counters.size())) {
+      if (lookup(hit.key) == nullptr) {
+        all.push_back(HeavyHitter{hit.key, hit.count + own_min, hit.error + own_min});
+      }
+    }
+
+    size_t keep = (_capacity < all.size()) ? _capacity : all.size();
+    std::partial_sort(all.begin(), all.begin() + keep, all.end(), [](const HeavyHitter& a, const HeavyHitter& b) {
+      return a.count > b.count;
+    });
+
+    uint64_t total = _total + other._total;
+    *this = SpaceSaving(_capacity);
+    _total = total;
+    for (size_t i = 0; i < keep; ++i) {
+      add(all[i].key, hash_string(all[i].key), all[i].count, all[i].error);
+    }
+  }
+
+};
+
+class CountMinSketch {
+
+  private:
+  size_t _width;
+  size_t _depth;
+  std::vector<uint64_t> _counters;
+
+    // Row i uses h1 + i * h2, with the two halves of the hash.
+    size_t cell(uint64_t hash, size_t row) const noexcept {
+      uint32_t h1 = static_cast<uint32_t>(hash);
+      uint32_t h2 = static_cast<uint32_t>(hash >> 32) | 1;
+      return row * _width + ((h1 + static_cast<uint32_t>(row) * h2) & (_width - 1));
+    }
+
+  public:
+  // width is rounded up to a power of two.
+  CountMinSketch(size_t width, size_t depth) : _width(1), _depth(depth) {
+    if (width == 0 || depth == 0 || width > (size_t(1) << 31)) {
+      throw std::invalid_argument("Invalid sketch shape");
+    }
+    while (_width < width) {
+      _width <<= 1;
+    }
+    _counters.assign(_width * _depth, 0);
+  }
+
+  size_t width() const noexcept {
+    return _width;
+  }
+
+  size_t depth() const noexcept {
+    return _depth;
+  }
+
+  void update(const SmallString& key, uint64_t weight = 1) noexcept {
+    uint64_t hash = hash_string(key);
+    for (size_t row = 0; row < _depth; ++row) {
+      _counters[cell(hash, row)] += weight;
+    }
+  }
+
+  uint64_t estimate(const SmallString& key) const noexcept {
+    uint64_t hash = hash_string(key);
+    uint64_t result = UINT64_MAX;
+    for (size_t row = 0; row < _depth; ++row) {
+      result = std::min(result, _counters[cell(hash, row)]);
+    }
+    return result;
+  }
+
+  void merge(const CountMinSketch& other) {
+    if (other._width != _width || other._depth != _depth) {
+      throw std::invalid_argument("Sketches of different shapes");
+    }
+    for (size_t i = 0; i < _counters.size(); ++i) {
+      _counters[i] += other._counters[i];
+    }
+  }
+
+};
+
+class HyperLogLog {
+
+  private:
+  size_t _precision;
+  std::vector<uint8_t> _registers;
+
+  public:
+  // 2^precision one-byte registers; precision goes from 4 to 18.
+  explicit HyperLogLog(size_t precision = 14) : _precision(precision) {
+    if (precision < 4 || precision > 18) {
+      throw std::invalid_argument("Precision must be between 4 and 18");
+    }
+    _registers.assign(size_t(1) << precision, 0);
+  }
+
+  size_t precision() const noexcept {
+    return _precision;
+  }
+
+  // The top bits pick the register; it keeps the longest run of leading
+  // zeros seen in the rest.
+  void add(const SmallString& key) noexcept {
+    uint64_t hash = hash_string(key);
+    size_t index = hash >> (64 - _precision);
+    uint64_t rest = (hash << _precision) | (uint64_t(1) << (_precision - 1));
+    uint8_t rank = static_cast<uint8_t>(__builtin_clzll(rest) + 1);
+    _registers[index] = std::max(_registers[index], rank);
+  }
+
+  double estimate() const noexcept {
+    double m = static_cast<double>(_registers.size());
+    double sum = 0;
+    size_t zeros = 0;
+    for (uint8_t r : _registers) {
+      sum += std::ldexp(1.0, -static_cast<int>(r));
+      zeros += (r == 0);
+    }
+
+    double alpha = (_precision == 4) ? 0.673 : (_precision == 5) ? 0.697 : (_precision == 6) ? 0.709
+                                                                                              : 0.7213 / (1 + 1.079 / m);
+    double raw = alpha * m * m / sum;
+
+    // Small cardinalities: linear counting is a lot more accurate.
+    if (raw <= 2.5 * m && zeros != 0) {
+      return m * std::log(m / static_cast<double>(zeros));
+    }
+    return raw;
+  }
+
+  void merge(const HyperLogLog& other) {
+    if (other._precision != _precision) {
+      throw std::invalid_argument("Sketches of different precisions");
+    }
+    for (size_t i = 0; i < _registers.size(); ++i) {
+      _registers[i] = std::max(_registers[i], other._registers[i]);
+    }
+  }
+
+};
+
+#endif
@@ -0,0 +1,99 @@
+#include <iostream>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+
+#include "sketches.hpp"
+
+using namespace std;
+
+/*
+Update costs of the three sketches over 1M keys: Space-Saving (1000
+counters) on a skewed stream, on keys that are all tracked (hits only)
+and on keys that are all new (every update evicts); count-min (2048 x 4)
+and HyperLogLog (2^12 registers) on the skewed stream.
+*/
+
+static volatile size_t sink;
+
+// Key k shows up about 1/k as often as key 1.
+static vector<SmallString> skewed(size_t n, size_t keys) {
+  vector<SmallString> stream;
+  uint64_t x = 1;
+  for (size_t i = 0; i < n; ++i) {
+    x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    double u = static_cast<double>(x >> 11) / 9007199254740992.0;
+    size_t k = static_cast<size_t>(std::pow(static_cast<double>(keys), u));
+    stream.push_back(SmallString(("event/" + to_string(k)).c_str()));
+  }
+  return stream;
+}
+
+static vector<SmallString> numbered(size_t n, size_t modulo) {
+  vector<SmallString> stream;
+  for (size_t i = 0; i < n; ++i) {
+    stream.push_back(SmallString(("event/" + to_string(i % modulo)).c_str()));
+  }
+  return stream;
+}
+
+template <typename Body>
+static void time_ns(const char* name, size_t operations, Body body) {
+  auto start = chrono::steady_clock::now();
+  body();
+  double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << ns / operations << " ns/update" << endl;
+}
+
+int main() {
+
+  const size_t N = 1000000;
+  const size_t CAPACITY = 1000;
+
+  vector<SmallString> stream = skewed(N, 1000000);
+  vector<SmallString> tracked = numbered(N, CAPACITY);
+  vector<SmallString> distinct = numbered(N, N);
+
+  time_ns("space-saving, skewed", N, [&]() {
+    SpaceSaving top(CAPACITY);
+    for (const SmallString& s : stream) {
+      top.update(s);
+    }
+    sink = top.top(1)[0].count;
+  });
+
+  time_ns("space-saving, hits only", N, [&]() {
+    SpaceSaving top(CAPACITY);
+    for (const SmallString& s : tracked) {
+      top.update(s);
+    }
+    sink = top.top(1)[0].count;
+  });
+
+  time_ns("space-saving, evictions only", N, [&]() {
+    SpaceSaving top(CAPACITY);
+    for (const SmallString& s : distinct) {
+      top.update(s);
+    }
+    sink = top.top(1)[0].count;
+  });
+
+  time_ns("count-min", N, [&]() {
+    CountMinSketch counts(2048, 4);
+    for (const SmallString& s : stream) {
+      counts.update(s);
+    }
+    sink = counts.estimate(stream[0]);
+  });
+
+  time_ns("hyperloglog", N, [&]() {
+    HyperLogLog distinct_keys(12);
+    for (const SmallString& s : stream) {
+      distinct_keys.add(s);
+    }
+    sink = static_cast<size_t>(distinct_keys.estimate());
+  });
+
+  return 0;
+}
@@ -0,0 +1,561 @@
+#ifndef SMALL_STRING_HPP
+#define SMALL_STRING_HPP
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include "small_string_accounting.hpp"
+#include "small_string_probes.hpp"
+
+/*
+SmallString:
+A class where small strings are optimized.
+
+Invariant: the bytes of _buffer past the end of the string are always
+zero. So an inline string can be read as whole words (inline_word),
+and ==, <=> and hashing do a fixed number of word operations instead
+of a loop up to the length.
+*/
+
+const size_t BUFFER_LIMIT = 22;
+const size_t FALLBACK_INITIAL_CAP = 10;
+
+class FrozenString; // frozen_string.hpp
+
+// Everything a Fallback allocates (itself and its chars) goes through
+// these, so that a thread can keep its own cache of freed blocks (see
+// SpillArena in work_stealing.hpp) instead of going to the heap. Hooks
+// must hand out blocks that delete[] could free, and may be given back
+// blocks they never handed out, since strings move between threads.
+struct CharHooks {
+  void* context;
+  char* (*allocate)(void* context, size_t n);
+  void (*release)(void* context, char* p, size_t n) noexcept;
+};
+
+inline thread_local const CharHooks* char_hooks = nullptr;
+
+inline char* allocate_chars(size_t n) {
+  return (char_hooks == nullptr) ? new char[n] : char_hooks->allocate(char_hooks->context, n);
+}
+
+inline void release_chars(char* p, size_t n) noexcept {
+  if (char_hooks == nullptr) {
+    delete[] p;
+  }
+  else {
+    char_hooks->release(char_hooks->context, p, n);
+  }
+}
+
+class SMALL_STRING_ABI_TAG SmallString {
+
+  // A helper class for the dynamically allocated fallback;
+  // it's just a vector.
+  struct Fallback {
+    // First, so it's charged for the Fallback before anything else
+    // and refunds whatever is left after ~Fallback.
+    [[no_unique_address]] AllocationAccount account{sizeof(Fallback)};
+    char* fallback;
+    size_t size;
+    size_t capacity;
+
+    char* take_chars(size_t n) {
+      char* p = allocate_chars(n);
+      account.charge(n);
+      return p;
+    }
+
+    void give_chars(char* p, size_t n) noexcept {
+      release_chars(p, n);
+      account.refund(n);
+    }
+
+    static void* operator new(size_t n) {
+      return allocate_chars(n);
+    }
+
+    static void operator delete(void* p, size_t n) noexcept {
+      release_chars(static_cast<char*>(p), n);
+    }
+    
+    // Initializes the fallback with a default capacity.
+    Fallback() {
+      // If anything happens, we must make sure this is destroyed!
+      fallback = take_chars(FALLBACK_INITIAL_CAP);
+      size = 0;
+      capacity = FALLBACK_INITIAL_CAP;
+    }
+
+    ~Fallback() noexcept {
+      // We must delete the allocated chars manually since fallback is
+      // a raw pointer.
+      give_chars(fallback, capacity);
+      fallback = nullptr;
+    }
+
+    // Initializes the fallback with one character.
+    Fallback(const char* c) {
+      if (FALLBACK_INITIAL_CAP == 0) {
+        throw std::out_of_range("Fallback initial capacity is non-positive.");
+      }
+
+      fallback = take_chars(FALLBACK_INITIAL_CAP);
+      fallback[0] = *c;
+
+      size = 1;
+      capacity = FALLBACK_INITIAL_CAP;
+
+    }
+
+    // Initializes the fallback with n chars (not yet written), and room
+    // for exactly those.
+    explicit Fallback(size_t n) {
+      fallback = take_chars(n);
+      size = n;
+      capacity = n;
+    }
+
+    static void copy_chars(size_t n, char* from, char* to) noexcept {
+      for (std::size_t i = 0; i < n; ++i) {
+        to[i] = from[i];
+      }
+    }
+
+    // Handle with care: may throw!
+    void double_capacity() {
+
+      char* new_fallback = take_chars(capacity * 2);
+      size_t old_capacity = capacity;
+
+      capacity *= 2;
+      SMALL_STRING_PROBE2(grow, old_capacity, capacity);
+
+      /*
+      WRONG! If the following line were to throw — God forbid — we'd be left with the wrong capacity!
+      char* new_fallback = new char[capacity]; // May throw std::bad_alloc in bad weather...
+      */
+
+      copy_chars(size, fallback, new_fallback);
+
+      give_chars(fallback, old_capacity);
+      fallback = new_fallback; // The object now has ownership of the pointer, so we're safe.
+
+    }
+
+    // Given a pointer to a read-only char,
+    // attempts to append at the end of the fallback.
+    void append_char(const char* c) {
+
+      if (size == capacity) {
+        double_capacity();
+      }
+
+      fallback[size++] = *c;
+
+    }
+
+  };
+
+  private:
+  size_t _size;
+  char _buffer[BUFFER_LIMIT];
+  Fallback* _fb;
+
+    // Given a pointer to a read-only char, 
+    // appends it at the end of the string.
+    void append_char(const char* c) {
+      // If the buffer has been exhausted:
+      if (_size == BUFFER_LIMIT) {
+
+        // A fallback kept by clear() is reused as it is.
+        if (_fb != nullptr) {
+          _fb->append_char(c);
+        }
+        else {
+          _fb = new Fallback(c);
+          SMALL_STRING_PROBE2(spill, _size + 1, _fb->capacity);
+        }
+        ++_size;
+      }
+      else if (_size > BUFFER_LIMIT) {
+        _fb->append_char(c);
+        ++_size;
+      }
+      else {
+        _buffer[_size++] = *c;
+      }
+    }
+
+  public:
+  // Default constructor: makes sure that _fb is nullptr (important)!
+  SmallString() noexcept {
+    _size = 0;
+    _fb = nullptr;
+    std::memset(_buffer, 0, BUFFER_LIMIT);
+  }
+
+  // Destructor!
+  ~SmallString() noexcept {
+    delete _fb;
+    _fb = nullptr;
+  }
+
+  const char& operator[](size_t i) const {
+
+    if (i >= _size) {
+      throw std::out_of_range("Index outside of the bounds!");
+    }
+
+    if (i < BUFFER_LIMIT) {
+      return _buffer[i];
+    }
+    else {
+      return _fb->fallback[i - BUFFER_LIMIT];
+    }
+  }
+
+  // Empties the string.
+  void empty() noexcept {
+    if (_fb != nullptr) {
+      SMALL_STRING_PROBE2(shrink, _size, _fb->capacity);
+    }
+    delete _fb;
+    _fb = nullptr;
+
+    std::memset(_buffer, 0, inline_length());
+    _size = 0;
+  }
+
+  // Empties the string but keeps its fallback (and its capacity), so
+  // that refilling it allocates nothing until it outgrows it.
+  void clear() noexcept {
+    if (_fb != nullptr) {
+      _fb->size = 0;
+    }
+
+    std::memset(_buffer, 0, inline_length());
+    _size = 0;
+  }
+
+  // Appends the given literal at the end of the word.
+  void append(const char* literal) {
+    append(literal, strlen(literal));
+  }
+
+
+  // Appends n bytes (which may include '\0').
+  void append(const char* p, size_t n) {
+    // Whatever still fits in the buffer goes in one copy.
+    if (_size < BUFFER_LIMIT && n != 0) {
+      size_t fits = (n < BUFFER_LIMIT - _size) ? n : BUFFER_LIMIT - _size;
+      std::memcpy(_buffer + _size, p, fits);
+      _size += fits;
+      p += fits;
+      n -= fits;
+    }
+
+    for (size_t i = 0; i < n; ++i) {
+      append_char(p + i);
+    }
+  }
+
+  // To the constructor, we pass a pointer to the read-only literal.
+  SmallString(const char* literal) : SmallString() {
+    append(literal);
+  }
+
+  SmallString(const char* p, size_t n) : SmallString() {
+    append(p, n);
+  }
+
+  size_t length() const {
+    return _size;
+  }
+
+  // The characters live in two segments: the first (at most BUFFER_LIMIT)
+  // ones in _buffer, and the rest (if any) in the fallback. These let
+  // algorithms read the segments directly instead of going char by char
+  // through operator[].
+  const char* inline_data() const noexcept {
+    return _buffer;
+  }
+
+  size_t inline_length() const noexcept {
+    return (_size < BUFFER_LIMIT) ? _size : BUFFER_LIMIT;
+  }
+
+  const char* spilled_data() const noexcept {
+    return (_fb == nullptr) ? nullptr : _fb->fallback;
+  }
+
+  size_t spilled_length() const noexcept {
+    return (_size > BUFFER_LIMIT) ? _size - BUFFER_LIMIT : 0;
+  }
+
+  // A copy, as one contiguous std::string.
+  std::string str() const {
+    std::string out(inline_data(), inline_length());
+    if (spilled_length() != 0) {
+      out.append(spilled_data(), spilled_length());
+    }
+    return out;
+  }
+
+  // Writable segments, for filling in a string made by
+  // resize_for_overwrite (or patching one in place). Only the first
+  // inline_length() bytes of the buffer may be written: the rest must
+  // stay zero.
+  char* inline_data() noexcept {
+    return _buffer;
+  }
+
+  char* spilled_data() noexcept {
+    return (_fb == nullptr) ? nullptr : _fb->fallback;
+  }
+
+  // Makes this a string of n bytes whose contents are left to the caller
+  // to write, with a fallback (if it needs one) of exactly the right
+  // capacity, so nothing is ever doubled and copied.
+  void resize_for_overwrite(size_t n) {
+    empty();
+    if (n > BUFFER_LIMIT) {
+      _fb = new Fallback(n - BUFFER_LIMIT);
+      SMALL_STRING_PROBE2(spill, n, _fb->capacity);
+    }
+    _size = n;
+  }
+
+  // The bytes this string owns on the heap: the Fallback and its chars
+  // (sizeof(SmallString) itself not included).
+  size_t heap_footprint() const noexcept {
+    return (_fb == nullptr) ? 0 : sizeof(Fallback) + _fb->capacity;
+  }
+
+  // The size of the block a Fallback itself takes (its chars apart).
+  static constexpr size_t fallback_bytes() noexcept {
+    return sizeof(Fallback);
+  }
+
+  bool is_inline() const noexcept {
+    return _size <= BUFFER_LIMIT;
+  }
+
+  // The buffer as three little-endian words, [0, 8), [8, 16) and
+  // [14, 22): the last one overlaps the second so as not to read past
+  // the buffer. Thanks to the zeroed tail, these are the whole inline
+  // string, padding included.
+  uint64_t inline_word(size_t i) const noexcept {
+    uint64_t word;
+    std::memcpy(&word, _buffer + ((i == 2) ? BUFFER_LIMIT - 8 : 8 * i), 8);
+    return word;
+  }
+
+  // Like operator[], but without the bounds check: the caller
+  // must make sure that i < length().
+  char at_unchecked(size_t i) const noexcept {
+    return (i < BUFFER_LIMIT) ? _buffer[i] : _fb->fallback[i - BUFFER_LIMIT];
+  }
+
+  // Copy
+  SmallString(const SmallString& other) : SmallString() {
+    
+    size_t length = other.length();
+    char c;
+
+    if (length > BUFFER_LIMIT) {
+      SMALL_STRING_PROBE1(copy, length);
+    }
+    
+    for (size_t i = 0; i < length; ++i) {
+      c = other[i];
+      append_char(&c);
+    }
+
+  }
+
+  // Move (never throws, so containers move rather than copy)
+  SmallString(SmallString&& other) noexcept {
+    _size = other._size;
+    std::memcpy(_buffer, other._buffer, BUFFER_LIMIT); // The zeroed tail too
+    _fb = other._fb;
+
+    std::memset(other._buffer, 0, other.inline_length());
+    other._size = 0;
+    other._fb = nullptr;
+  }
+
+  /*
+  Problem:
+  At this point, if we were to do copy-assignment, such as:
+  SmallString a("copy");
+  SmallString b = a;
+  Given that there's no copy-assignment operator, this would
+  default to shallow-copy. This is dangerous, since now both
+  b and a will have the pointer to the same Fallback (and you
+  get double delete!)
+  */
+
+  // Copy-assignment operator
+
+  SmallString& operator=(const SmallString& rhs) {
+
+    empty();
+    char c;
+
+    size_t length = rhs.length();
+    if (length > BUFFER_LIMIT) {
+      SMALL_STRING_PROBE1(copy, length);
+    }
+
+    for (size_t i = 0; i < length; ++i) {
+      c = rhs[i];
+      append_char(&c);
+    }
+
+    return *this;
+
+  }
+
+  // Move-assignment operator (we must make sure that the
+  // moved object is left in a graceful state!)
+
+  SmallString& operator=(SmallString&& rhs) noexcept {
+
+    // The fallback we had must go, or it leaks (and self-assignment
+    // must leave the string alone).
+    if (this == &rhs) {
+      return *this;
+    }
+    delete _fb;
+
+    _size = rhs._size;
+    std::memcpy(_buffer, rhs._buffer, BUFFER_LIMIT);
+    _fb = rhs._fb;
+
+    std::memset(rhs._buffer, 0, rhs.inline_length());
+    rhs._size = 0;
+    rhs._fb = nullptr;
+
+    return *this;
+
+  }
+
+  // Nothing in a SmallString points into itself, so its bytes can be
+  // moved elsewhere with memcpy (relocated). relocate_to leaves this
+  // empty, with the bytes at to owning what it had; relocate_from takes
+  // over such bytes, dropping what this had (a cleared string may still
+  // own a fallback).
+  void relocate_to(void* to) noexcept {
+    std::memcpy(to, static_cast<const void*>(this), sizeof(SmallString));
+    std::memset(_buffer, 0, inline_length());
+    _size = 0;
+    _fb = nullptr;
+  }
+
+  void relocate_from(const void* from) noexcept {
+    delete _fb;
+    std::memcpy(static_cast<void*>(this), from, sizeof(SmallString));
+  }
+
+  // An immutable, shareable copy (defined in frozen_string.hpp).
+  FrozenString freeze() const;
+
+  friend SmallString operator+(SmallString, SmallString);
+
+};
+
+// Concatenation:
+  // Which incidentally shows the need for move/copy
+  // constructors.
+  inline SmallString operator+(SmallString lhs, SmallString rhs) {
+
+    size_t length = rhs.length();
+    char c;
+
+    if (lhs.length() + length > BUFFER_LIMIT) {
+      SMALL_STRING_PROBE2(concat, lhs.length(), length);
+    }
+    
+    for (size_t i = 0; i < length; ++i) {
+      c = rhs[i];
+      lhs.append_char(&c);
+    }
+
+    return lhs;
+  }
+
+// Three-way comparison (< 0, 0, > 0), byte by byte as unsigned chars;
+// a proper prefix comes first. Both strings split into segments at the
+// same place, so this is one memcmp per segment.
+inline int compare(const SmallString& lhs, const SmallString& rhs) noexcept {
+  size_t common = (lhs.length() < rhs.length()) ? lhs.length() : rhs.length();
+  size_t in_buffer = (common < BUFFER_LIMIT) ? common : BUFFER_LIMIT;
+
+  int result = (in_buffer == 0) ? 0 : std::memcmp(lhs.inline_data(), rhs.inline_data(), in_buffer);
+  if (result == 0 && common > BUFFER_LIMIT) {
+    result = std::memcmp(lhs.spilled_data(), rhs.spilled_data(), common - BUFFER_LIMIT);
+  }
+
+  if (result != 0) {
+    return result;
+  }
+  return (lhs.length() < rhs.length()) ? -1 : (lhs.length() > rhs.length()) ? 1 : 0;
+}
+
+// Equality for literals and SmallStrings
+inline bool operator==(const SmallString& lhs, const SmallString& rhs) noexcept {
+  if (lhs.length() != rhs.length()) {
+    return false;
+  }
+
+  // Inline: three words, no loop, no branch on the contents.
+  if (lhs.is_inline()) {
+    return ((lhs.inline_word(0) ^ rhs.inline_word(0)) | (lhs.inline_word(1) ^ rhs.inline_word(1)) |
+            (lhs.inline_word(2) ^ rhs.inline_word(2))) == 0;
+  }
+
+  return compare(lhs, rhs) == 0;
+}
+
+inline bool operator==(const SmallString& lhs, const char* rhs) {
+  size_t length = lhs.length();
+
+  for (size_t i = 0; i < length; ++i) {
+    if (lhs[i] != rhs[i] || rhs[i] == '\0') {
+      return false;
+    }
+  }
+
+  // The literal must end where the string does.
+  return rhs[length] == '\0';
+}
+
+inline bool operator==(const char* lhs, const SmallString& rhs) {
+  return (rhs == lhs);
+}
+
+// Ordering, as compare(). Two inline strings compare as byteswapped
+// (big-endian) words: the first differing word decides, and the zeroed
+// tails make a proper prefix come out first, or equal up to the
+// lengths, which then decide.
+inline std::strong_ordering operator<=>(const SmallString& lhs, const SmallString& rhs) noexcept {
+  if (lhs.is_inline() && rhs.is_inline()) {
+    for (size_t i = 0; i < 3; ++i) {
+      uint64_t a = __builtin_bswap64(lhs.inline_word(i));
+      uint64_t b = __builtin_bswap64(rhs.inline_word(i));
+      if (a != b) {
+        return a <=> b;
+      }
+    }
+    return lhs.length() <=> rhs.length();
+  }
+
+  return compare(lhs, rhs) <=> 0;
+}
+
+#endif
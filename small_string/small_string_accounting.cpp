@@ -0,0 +1,145 @@
+#include <iostream>
+#include <cassert>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <sys/wait.h>
+#include <unistd.h>
+
+// The report at exit as well (which turns the accounting on).
+#ifndef SMALL_STRING_ACCOUNTING_REPORT
+#define SMALL_STRING_ACCOUNTING_REPORT
+#endif
+#include "small_string.hpp"
+
+using namespace std;
+
+static AllocationTag parser("parser");
+static AllocationTag cache("cache");
+
+// Still reachable at exit, so the report has something to say.
+static SmallString* left_behind = nullptr;
+
+static SmallString spilled(size_t n) {
+  return SmallString(string(n, 'x').c_str());
+}
+
+// TESTS
+
+int main() {
+
+  AllocationStats start = allocation_stats();
+  assert (start.bytes == 0 && start.spilled == 0);
+
+  // Inline strings cost nothing
+  {
+    SmallString a("short");
+    SmallString b = a;
+    assert (allocation_stats().allocations == 0);
+  }
+
+  // A spilled string is charged for its Fallback and its chars, and
+  // gives all of it back
+  {
+    SmallString s = spilled(100);
+    AllocationStats stats = allocation_stats();
+    assert (stats.spilled == 1);
+    assert (stats.bytes == static_cast<int64_t>(s.heap_footprint()));
+    assert (stats.peak_bytes >= stats.bytes);
+  }
+  assert (allocation_stats().bytes == 0 && allocation_stats().spilled == 0);
+  int64_t peak = allocation_stats().peak_bytes;
+  assert (peak > 0);
+
+  // Move assignment used to leak the fallback it overwrote
+  {
+    SmallString a = spilled(50);
+    SmallString b = spilled(60);
+    a = std::move(b);
+    assert (allocation_stats().spilled == 1);
+    assert (a.length() == 60 && b.length() == 0);
+
+    a = std::move(a);
+    assert (a.length() == 60);
+  }
+  assert (allocation_stats().bytes == 0 && allocation_stats().spilled == 0);
+
+  // Tags: charged where made, refunded wherever freed
+  vector<SmallString> kept;
+  {
+    AllocationTagScope scope(parser);
+    kept.push_back(spilled(40));
+    {
+      AllocationTagScope inner(cache);
+      kept.push_back(spilled(40));
+      kept.push_back(spilled(40));
+    }
+    kept.push_back(spilled(40));
+  }
+  kept.push_back(spilled(40));
+  assert (parser.stats().spilled == 2 && cache.stats().spilled == 2);
+  assert (untagged_allocations().stats().spilled == 1);
+  assert (allocation_stats().spilled == 5);
+  assert (parser.stats().bytes == cache.stats().bytes);
+  assert (parser.stats().allocations > 2);
+
+  // Freed on another thread
+  thread other([&]() {
+    kept.erase(kept.begin());
+  });
+  other.join();
+  assert (parser.stats().spilled == 1);
+
+  // The report lists what's left, by tag
+  FILE* out = tmpfile();
+  assert (report_outstanding(out) == 4);
+  rewind(out);
+  string report;
+  for (int c = fgetc(out); c != EOF; c = fgetc(out)) {
+    report += char(c);
+  }
+  fclose(out);
+  assert (report.find("4 spilled strings outstanding") != string::npos);
+  assert (report.find("parser: 1 strings") != string::npos);
+  assert (report.find("cache: 2 strings") != string::npos);
+
+  kept.clear();
+  assert (allocation_stats().bytes == 0 && allocation_stats().spilled == 0);
+  assert (parser.stats().peak_bytes > parser.stats().bytes);
+
+  out = tmpfile();
+  assert (report_outstanding(out) == 0 && ftell(out) == 0);
+  fclose(out);
+
+  // The report at exit: a child exits with a spilled string alive and
+  // its stderr comes back through a pipe
+  int pipe_ends[2];
+  assert (pipe(pipe_ends) == 0);
+  pid_t child = fork();
+  assert (child >= 0);
+  if (child == 0) {
+    dup2(pipe_ends[1], STDERR_FILENO);
+    close(pipe_ends[0]);
+    AllocationTagScope scope(cache);
+    left_behind = new SmallString(spilled(64));
+    exit(0);
+  }
+  close(pipe_ends[1]);
+  string at_exit;
+  char buffer[256];
+  for (ssize_t n = read(pipe_ends[0], buffer, sizeof(buffer)); n > 0; n = read(pipe_ends[0], buffer, sizeof(buffer))) {
+    at_exit.append(buffer, n);
+  }
+  close(pipe_ends[0]);
+  int status;
+  waitpid(child, &status, 0);
+  assert (at_exit.find("1 spilled strings outstanding") != string::npos);
+  assert (at_exit.find("cache: 1 strings") != string::npos);
+  assert (left_behind == nullptr);
+
+  return 0;
+
+}
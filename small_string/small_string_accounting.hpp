@@ -0,0 +1,295 @@
+#ifndef SMALL_STRING_ACCOUNTING_HPP
+#define SMALL_STRING_ACCOUNTING_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+
+/*
+SmallString accounting:
+Counts what the Fallbacks of SmallStrings take from the allocator (the
+Fallback itself and its chars): bytes held now, the most ever held at
+once, allocations made, and spilled strings alive. Totals are kept for
+the process, and per tag: an AllocationTag names a call site (or a
+subsystem), and while an AllocationTagScope is alive, the Fallbacks its
+thread makes are charged to its tag, for as long as they live, wherever
+they end up being freed.
+
+It's compiled out unless SMALL_STRING_ACCOUNTING is defined (before the
+first include of small_string.hpp, in every translation unit): then the
+tags and scopes are still there, but do nothing and the stats are all
+zero. When on, an allocation or a free is a few relaxed atomic adds on
+its tag and on the totals (plus a CAS when it sets a new peak).
+
+With SMALL_STRING_ACCOUNTING_REPORT defined as well, the spilled strings
+still alive when the program exits are reported on stderr, by tag (see
+report_outstanding).
+
+The macro changes the layout of a Fallback, so translation units that
+disagree on it must not share SmallStrings. To make that a link error
+rather than silent corruption, SmallString carries an ABI tag when the
+accounting is on (SMALL_STRING_ABI_TAG): its mangled name, and that of
+every function taking or returning one, differ between the two modes.
+*/
+
+#if defined(SMALL_STRING_ACCOUNTING_REPORT) && !defined(SMALL_STRING_ACCOUNTING)
+#define SMALL_STRING_ACCOUNTING
+#endif
+
+#ifdef SMALL_STRING_ACCOUNTING
+#define SMALL_STRING_ABI_TAG [[gnu::abi_tag("accounting")]]
+#else
+#define SMALL_STRING_ABI_TAG
+#endif
+
+struct AllocationStats {
+  int64_t bytes = 0;
+  int64_t peak_bytes = 0;
+  uint64_t allocations = 0;
+  int64_t spilled = 0;
+};
+
+#ifdef SMALL_STRING_ACCOUNTING
+
+class AllocationCounters {
+
+  private:
+  std::atomic<int64_t> _bytes{0};
+  std::atomic<int64_t> _peak_bytes{0};
+  std::atomic<uint64_t> _allocations{0};
+  std::atomic<int64_t> _spilled{0};
+
+  public:
+  constexpr AllocationCounters() noexcept = default;
+
+  // bytes < 0 for frees; an allocation is counted when bytes > 0.
+  void add(int64_t bytes, int64_t spilled) noexcept {
+    int64_t now = _bytes.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+    if (bytes > 0) {
+      _allocations.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (spilled != 0) {
+      _spilled.fetch_add(spilled, std::memory_order_relaxed);
+    }
+
+    int64_t peak = _peak_bytes.load(std::memory_order_relaxed);
+    while (now > peak && !_peak_bytes.compare_exchange_weak(peak, now, std::memory_order_relaxed)) {}
+  }
+
+  AllocationStats stats() const noexcept {
+    AllocationStats out;
+    out.bytes = _bytes.load(std::memory_order_relaxed);
+    out.peak_bytes = _peak_bytes.load(std::memory_order_relaxed);
+    out.allocations = _allocations.load(std::memory_order_relaxed);
+    out.spilled = _spilled.load(std::memory_order_relaxed);
+    return out;
+  }
+
+};
+
+inline AllocationCounters allocation_totals;
+
+class AllocationTag {
+
+  private:
+  const char* _name;
+  AllocationCounters _counters;
+  AllocationTag* _next;
+
+    // Every tag ever made, newest first, so they can all be reported.
+    static std::atomic<AllocationTag*>& registered() noexcept {
+      static std::atomic<AllocationTag*> first{nullptr};
+      return first;
+    }
+
+  public:
+  // Tags are never unregistered: give them static storage duration.
+  explicit AllocationTag(const char* name) noexcept : _name(name), _next(registered().load(std::memory_order_relaxed)) {
+    while (!registered().compare_exchange_weak(_next, this, std::memory_order_release, std::memory_order_relaxed)) {}
+  }
+
+  AllocationTag(const AllocationTag&) = delete;
+  AllocationTag& operator=(const AllocationTag&) = delete;
+
+  const char* name() const noexcept {
+    return _name;
+  }
+
+  AllocationStats stats() const noexcept {
+    return _counters.stats();
+  }
+
+  void add(int64_t bytes, int64_t spilled) noexcept {
+    _counters.add(bytes, spilled);
+    allocation_totals.add(bytes, spilled);
+  }
+
+  template <typename F>
+  static void for_each(F f) {
+    for (AllocationTag* tag = registered().load(std::memory_order_acquire); tag != nullptr; tag = tag->_next) {
+      f(*tag);
+    }
+  }
+
+};
+
+// What no scope claimed. Made on first use, so that strings made
+// during static initialization are charged to a tag that's ready.
+inline AllocationTag& untagged_allocations() noexcept {
+  static AllocationTag untagged("untagged");
+  return untagged;
+}
+
+inline thread_local AllocationTag* allocation_tag = nullptr;
+
+class AllocationTagScope {
+
+  private:
+  AllocationTag* _previous;
+
+  public:
+  explicit AllocationTagScope(AllocationTag& tag) noexcept : _previous(allocation_tag) {
+    allocation_tag = &tag;
+  }
+
+  AllocationTagScope(const AllocationTagScope&) = delete;
+  AllocationTagScope& operator=(const AllocationTagScope&) = delete;
+
+  ~AllocationTagScope() noexcept {
+    allocation_tag = _previous;
+  }
+
+};
+
+// A Fallback's account: the tag current when it was made, charged for
+// everything the Fallback holds (itself included) until it's destroyed,
+// when whatever is left is refunded.
+class AllocationAccount {
+
+  private:
+  AllocationTag* _tag;
+  int64_t _bytes;
+
+  public:
+  explicit AllocationAccount(size_t object_bytes) noexcept
+    : _tag((allocation_tag == nullptr) ? &untagged_allocations() : allocation_tag),
+      _bytes(static_cast<int64_t>(object_bytes)) {
+    _tag->add(_bytes, 1);
+  }
+
+  AllocationAccount(const AllocationAccount&) = delete;
+  AllocationAccount& operator=(const AllocationAccount&) = delete;
+
+  ~AllocationAccount() noexcept {
+    _tag->add(-_bytes, -1);
+  }
+
+  void charge(size_t n) noexcept {
+    _bytes += static_cast<int64_t>(n);
+    _tag->add(static_cast<int64_t>(n), 0);
+  }
+
+  void refund(size_t n) noexcept {
+    _bytes -= static_cast<int64_t>(n);
+    _tag->add(-static_cast<int64_t>(n), 0);
+  }
+
+};
+
+inline AllocationStats allocation_stats() noexcept {
+  return allocation_totals.stats();
+}
+
+// Writes the spilled strings still alive, by tag; writes nothing if
+// there are none. Returns how many there are.
+inline int64_t report_outstanding(std::FILE* out) {
+  AllocationStats totals = allocation_stats();
+  if (totals.spilled == 0) {
+    return 0;
+  }
+
+  std::fprintf(out, "SmallString: %lld spilled strings outstanding (%lld bytes, peak %lld)\n",
+               static_cast<long long>(totals.spilled), static_cast<long long>(totals.bytes),
+               static_cast<long long>(totals.peak_bytes));
+  AllocationTag::for_each([out](const AllocationTag& tag) {
+    AllocationStats stats = tag.stats();
+    if (stats.spilled != 0) {
+      std::fprintf(out, "  %s: %lld strings, %lld bytes\n", tag.name(), static_cast<long long>(stats.spilled),
+                   static_cast<long long>(stats.bytes));
+    }
+  });
+  return totals.spilled;
+}
+
+#ifdef SMALL_STRING_ACCOUNTING_REPORT
+// Constant initialized, so it's destroyed (and reports) after every
+// static string, not just those defined after it.
+struct OutstandingReport {
+  ~OutstandingReport() {
+    report_outstanding(stderr);
+  }
+};
+
+inline OutstandingReport outstanding_report;
+#endif
+
+#else
+
+class AllocationTag {
+
+  private:
+  const char* _name;
+
+  public:
+  explicit constexpr AllocationTag(const char* name) noexcept : _name(name) {}
+
+  AllocationTag(const AllocationTag&) = delete;
+  AllocationTag& operator=(const AllocationTag&) = delete;
+
+  const char* name() const noexcept {
+    return _name;
+  }
+
+  AllocationStats stats() const noexcept {
+    return AllocationStats();
+  }
+
+};
+
+class AllocationTagScope {
+
+  public:
+  explicit AllocationTagScope(AllocationTag&) noexcept {}
+
+  AllocationTagScope(const AllocationTagScope&) = delete;
+  AllocationTagScope& operator=(const AllocationTagScope&) = delete;
+
+};
+
+// Empty: a Fallback doesn't grow by it.
+class AllocationAccount {
+
+  public:
+  explicit AllocationAccount(size_t) noexcept {}
+
+  AllocationAccount(const AllocationAccount&) = delete;
+  AllocationAccount& operator=(const AllocationAccount&) = delete;
+
+  void charge(size_t) noexcept {}
+
+  void refund(size_t) noexcept {}
+
+};
+
+inline AllocationStats allocation_stats() noexcept {
+  return AllocationStats();
+}
+
+inline int64_t report_outstanding(std::FILE*) {
+  return 0;
+}
+
+#endif
+
+#endif
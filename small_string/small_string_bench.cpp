@@ -0,0 +1,138 @@
+#include <iostream>
+#include <chrono>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+using namespace std;
+
+/*
+==, hash and ordering on inline SmallStrings (keys of 4 to 22 bytes,
+random lengths, so the old loops can't be predicted): the word-at-a-time
+versions vs the byte loop, StringHasher over the segments, and memcmp
+by segment (compare()).
+*/
+
+static volatile size_t sink;
+
+static vector<SmallString> keys(size_t n) {
+  vector<SmallString> out;
+  unsigned state = 12345;
+  for (size_t i = 0; i < n; ++i) {
+    state = state * 1103515245 + 12345;
+    size_t length = 4 + (state >> 16) % 19;
+    string s = "key:" + to_string(i % 97);
+    s.resize(length, 'k');
+    out.push_back(SmallString(s.c_str()));
+  }
+  return out;
+}
+
+// What == used to be.
+static bool bytewise_equals(const SmallString& a, const SmallString& b) {
+  if (a.length() != b.length()) {
+    return false;
+  }
+  for (size_t i = 0; i < a.length(); ++i) {
+    if (a[i] != b[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// What hash_string used to be.
+static uint64_t streamed_hash(const SmallString& s) {
+  StringHasher hasher;
+  hasher.update(s.inline_data(), s.inline_length());
+  if (s.spilled_length() != 0) {
+    hasher.update(s.spilled_data(), s.spilled_length());
+  }
+  return hasher.finish();
+}
+
+template <typename Body>
+static void time_ns(const char* name, size_t operations, Body body) {
+  auto start = chrono::steady_clock::now();
+  body();
+  double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << ns / operations << " ns/op" << endl;
+}
+
+int main() {
+
+  const size_t N = 4096;
+  const size_t ROUNDS = 2000;
+
+  vector<SmallString> a = keys(N);
+  vector<SmallString> b = keys(N);
+  // Pairs equal about one time in 97
+  for (size_t i = 0; i < N; ++i) {
+    b[i] = a[(i * 31) % N];
+  }
+
+  time_ns("== bytewise", N * ROUNDS, [&]() {
+    size_t hits = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        hits += bytewise_equals(a[i], b[(i + r) % N]);
+      }
+    }
+    sink = hits;
+  });
+
+  time_ns("== by words", N * ROUNDS, [&]() {
+    size_t hits = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        hits += (a[i] == b[(i + r) % N]);
+      }
+    }
+    sink = hits;
+  });
+
+  time_ns("hash streamed", N * ROUNDS, [&]() {
+    uint64_t total = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        total += streamed_hash(a[i]);
+      }
+    }
+    sink = total;
+  });
+
+  time_ns("hash by words", N * ROUNDS, [&]() {
+    uint64_t total = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        total += hash_string(a[i]);
+      }
+    }
+    sink = total;
+  });
+
+  time_ns("compare (memcmp)", N * ROUNDS, [&]() {
+    size_t less = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        less += (compare(a[i], b[(i + r) % N]) < 0);
+      }
+    }
+    sink = less;
+  });
+
+  time_ns("<=> by words", N * ROUNDS, [&]() {
+    size_t less = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        less += (a[i] < b[(i + r) % N]);
+      }
+    }
+    sink = less;
+  });
+
+  return 0;
+}
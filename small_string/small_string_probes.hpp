@@ -0,0 +1,35 @@
+#ifndef SMALL_STRING_PROBES_HPP
+#define SMALL_STRING_PROBES_HPP
+
+/*
+SmallString probes:
+USDT (statically defined tracing) probes on the paths that allocate or
+free a fallback, so perf or bpftrace can find the call sites causing
+them on a live process, without a rebuild:
+
+  small_string:spill   (length, capacity)       a string leaves its buffer
+  small_string:grow    (old_capacity, capacity) double_capacity
+  small_string:shrink  (length, capacity)       a fallback is freed
+  small_string:copy    (length)                 a spilled string is copied
+  small_string:concat  (lhs_length, rhs_length) operator+ that spills
+
+e.g. bpftrace -e 'usdt:./a.out:small_string:grow { @[ustack] = sum(arg1); }'
+
+An unattached probe is a single nop (plus an ELF note), so they are on
+whenever <sys/sdt.h> (systemtap-sdt-dev) is there. Define
+SMALL_STRING_NO_PROBES to leave them out; without the header they are
+always left out.
+*/
+
+#if !defined(SMALL_STRING_NO_PROBES) && __has_include(<sys/sdt.h>)
+#include <sys/sdt.h>
+#define SMALL_STRING_PROBES 1
+#define SMALL_STRING_PROBE1(name, a) DTRACE_PROBE1(small_string, name, a)
+#define SMALL_STRING_PROBE2(name, a, b) DTRACE_PROBE2(small_string, name, a, b)
+#else
+#define SMALL_STRING_PROBES 0
+#define SMALL_STRING_PROBE1(name, a) ((void)0)
+#define SMALL_STRING_PROBE2(name, a, b) ((void)0)
+#endif
+
+#endif
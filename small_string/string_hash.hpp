@@ -0,0 +1,177 @@
+#ifndef STRING_HASH_HPP
+#define STRING_HASH_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+#include "small_string.hpp"
+
+/*
+String hashing:
+A fast 64-bit hash that reads a SmallString in place (no copy into a
+contiguous buffer first). The bytes are consumed as little-endian
+8-byte words (the last one zero padded), each folded in with a single
+128-bit multiply; the length goes in at the end.
+
+The hash only depends on the bytes, not on how they are split into
+segments, so a SmallString, a string_view and anything else with the
+same contents all hash the same. That's what makes heterogeneous
+lookups work.
+
+HASH_VERSION changes whenever the values do, so that anything that
+stores hashes (serialized filters, say) can tell.
+*/
+
+const uint32_t HASH_VERSION = 1;
+
+// Multiplies, then folds the 128-bit product onto itself.
+inline uint64_t hash_mix(uint64_t a, uint64_t b) noexcept {
+  __uint128_t product = static_cast<__uint128_t>(a) * b;
+  return static_cast<uint64_t>(product) ^ static_cast<uint64_t>(product >> 64);
+}
+
+// Hashes bytes that arrive in pieces.
+class StringHasher {
+
+  static constexpr uint64_t SEED_KEY = 0xa0761d6478bd642fULL;
+  static constexpr uint64_t WORD_KEY = 0xe7037ed1a0b428dbULL;
+  static constexpr uint64_t FINAL_KEY = 0x8ebc6af09c88c6e3ULL;
+  static constexpr uint64_t FINAL_MULTIPLIER = 0x589965cc75374cc3ULL;
+
+  private:
+  uint64_t _state;
+  uint64_t _pending;
+  size_t _pending_bytes;
+  size_t _length;
+
+    void word(uint64_t w) noexcept {
+      _state = hash_mix(_state ^ w, WORD_KEY);
+    }
+
+  public:
+  explicit StringHasher(uint64_t seed = 0) noexcept
+    : _state(seed ^ SEED_KEY), _pending(0), _pending_bytes(0), _length(0) {}
+
+  void update(const char* p, size_t n) noexcept {
+    _length += n;
+
+    // Top up a word left over from the previous piece.
+    while (_pending_bytes != 0 && n != 0) {
+      _pending |= static_cast<uint64_t>(static_cast<unsigned char>(*p++)) << (8 * _pending_bytes);
+      --n;
+      if (++_pending_bytes == 8) {
+        word(_pending);
+        _pending = 0;
+        _pending_bytes = 0;
+      }
+    }
+
+    for (; n >= 8; n -= 8, p += 8) {
+      uint64_t w;
+      std::memcpy(&w, p, 8);
+      word(w);
+    }
+
+    // The tail waits for the next piece (or for finish). If there is
+    // one, the pending word was used up above.
+    if (n != 0) {
+      std::memcpy(&_pending, p, n);
+      _pending_bytes = n;
+    }
+  }
+
+  uint64_t finish() const noexcept {
+    uint64_t state = _state;
+    if (_pending_bytes != 0) {
+      state = hash_mix(state ^ _pending, WORD_KEY);
+    }
+    return hash_mix(state ^ _length ^ FINAL_KEY, FINAL_MULTIPLIER);
+  }
+
+  // The same hash for n <= 24 bytes given as three zero-padded words,
+  // without the loop: word k is mixed in only if n > 8k, by selects
+  // rather than branches.
+  static uint64_t hash_words(uint64_t w0, uint64_t w1, uint64_t w2, size_t n, uint64_t seed = 0) noexcept {
+    uint64_t state = seed ^ SEED_KEY;
+    uint64_t mixed = hash_mix(state ^ w0, WORD_KEY);
+    state = (n > 0) ? mixed : state;
+    mixed = hash_mix(state ^ w1, WORD_KEY);
+    state = (n > 8) ? mixed : state;
+    mixed = hash_mix(state ^ w2, WORD_KEY);
+    state = (n > 16) ? mixed : state;
+    return hash_mix(state ^ n ^ FINAL_KEY, FINAL_MULTIPLIER);
+  }
+
+};
+
+inline uint64_t hash_bytes(const char* p, size_t n, uint64_t seed = 0) noexcept {
+  StringHasher hasher(seed);
+  hasher.update(p, n);
+  return hasher.finish();
+}
+
+inline uint64_t hash_string(const SmallString& s, uint64_t seed = 0) noexcept {
+  // Inline strings are three words with a zeroed tail; the last one
+  // (bytes 14 to 21) shifted down is bytes 16 to 23, zero padded.
+  if (s.is_inline()) {
+    return StringHasher::hash_words(s.inline_word(0), s.inline_word(1), s.inline_word(2) >> 16, s.length(), seed);
+  }
+
+  StringHasher hasher(seed);
+  hasher.update(s.inline_data(), s.inline_length());
+  if (s.spilled_length() != 0) {
+    hasher.update(s.spilled_data(), s.spilled_length());
+  }
+  return hasher.finish();
+}
+
+inline uint64_t hash_string(std::string_view s, uint64_t seed = 0) noexcept {
+  return hash_bytes(s.data(), s.size(), seed);
+}
+
+// Whether s holds exactly the bytes of view, compared in place.
+inline bool equals(const SmallString& s, std::string_view view) noexcept {
+  if (s.length() != view.size()) {
+    return false;
+  }
+
+  size_t in_buffer = s.inline_length();
+  if (in_buffer != 0 && std::memcmp(s.inline_data(), view.data(), in_buffer) != 0) {
+    return false;
+  }
+  return s.spilled_length() == 0 || std::memcmp(s.spilled_data(), view.data() + in_buffer, s.spilled_length()) == 0;
+}
+
+// For unordered containers; both are transparent, so lookups by
+// string_view don't have to build a SmallString.
+struct SmallStringHash {
+  using is_transparent = void;
+
+  size_t operator()(const SmallString& s) const noexcept {
+    return hash_string(s);
+  }
+
+  size_t operator()(std::string_view s) const noexcept {
+    return hash_string(s);
+  }
+};
+
+struct SmallStringEqual {
+  using is_transparent = void;
+
+  bool operator()(const SmallString& a, const SmallString& b) const noexcept {
+    return a == b;
+  }
+
+  bool operator()(const SmallString& a, std::string_view b) const noexcept {
+    return equals(a, b);
+  }
+
+  bool operator()(std::string_view a, const SmallString& b) const noexcept {
+    return equals(b, a);
+  }
+};
+
+#endif
@@ -0,0 +1,67 @@
+#include <iostream>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "tiny_key.hpp"
+
+using namespace std;
+
+// TESTS
+
+int main() {
+
+  // Literals, known at compile time
+  constexpr TinyKey get("GET");
+  static_assert(get.length() == 3);
+  static_assert(get == TinyKey::from_word(0x544547));
+  static_assert(TinyKey("").length() == 0 && TinyKey("12345678").length() == 8);
+  static_assert(TinyKey("ab") < TinyKey("abc") && TinyKey("abc") < TinyKey("abd"));
+
+  // Every length from pointer and length, and back
+  string text = "abcdefgh";
+  for (size_t n = 0; n <= 8; ++n) {
+    TinyKey key(text.data(), n);
+    assert (key.length() == n);
+    assert (key.to_small_string().str() == text.substr(0, n));
+    assert (TinyKey(SmallString(text.substr(0, n).c_str())) == key);
+  }
+
+  // Middle '\0' is fine, a final one isn't; nor is anything too long
+  assert (TinyKey("a\0b", 3).length() == 3);
+  assert (!TinyKey::fits("ab\0", 3) && !TinyKey::fits("123456789", 9));
+  bool thrown = false;
+  try {
+    TinyKey key(SmallString("longer than eight"));
+  }
+  catch (const invalid_argument&) {
+    thrown = true;
+  }
+  assert (thrown);
+
+  // Ordering is lexicographic, unsigned
+  assert (TinyKey("\xff") > TinyKey("a"));
+  assert (TinyKey("US") < TinyKey("USA") && TinyKey("USA") < TinyKey("UT"));
+  assert ((TinyKey("DE") <=> TinyKey("DE")) == 0);
+
+  // As a hash key
+  unordered_map<TinyKey, int, TinyKeyHash> methods;
+  methods[TinyKey("GET")] = 1;
+  methods[TinyKey("POST")] = 2;
+  methods[TinyKey("DELETE")] = 3;
+  assert (methods.at(TinyKey(SmallString("POST"))) == 2);
+  assert (methods.find(TinyKey("PUT")) == methods.end());
+
+  // No collisions among a few thousand short IDs
+  unordered_set<uint64_t> hashes;
+  for (size_t i = 0; i < 5000; ++i) {
+    string id = "id" + to_string(i);
+    hashes.insert(TinyKey(id.data(), id.size()).hash());
+  }
+  assert (hashes.size() == 5000);
+
+  return 0;
+
+}
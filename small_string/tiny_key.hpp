@@ -0,0 +1,146 @@
+#ifndef TINY_KEY_HPP
+#define TINY_KEY_HPP
+
+#include <compare>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+
+#include "small_string.hpp"
+#include "string_hash.hpp"
+
+/*
+TinyKey:
+A string of at most 8 bytes held in one uint64_t (little-endian, zero
+padded), so it lives in a register: == is one compare, the hash one
+multiply-mix, and ordering one byteswap and compare. Meant for the
+many keys that are this short ("GET", country codes, short IDs).
+
+The length isn't stored, it's where the zero padding starts, so a key
+can't end in '\0' (fits() says whether a string can be one). Bytes of
+'\0' in the middle are fine.
+
+The hash is its own, not hash_string's: a TinyKey and a SmallString
+with the same bytes hash differently, so don't mix them in one table.
+*/
+
+class TinyKey {
+
+  static constexpr size_t CAPACITY = 8;
+  static constexpr uint64_t HASH_KEY = 0x9e3779b97f4a7c15ULL;
+  static constexpr uint64_t HASH_MULTIPLIER = 0xd6e8feb86659fd93ULL;
+
+  private:
+  uint64_t _word;
+
+    // n <= 8 bytes into a zero-padded word, without reading past p + n:
+    // two overlapping 4-byte loads, or for fewer than 4 bytes the first,
+    // middle and last ones.
+    static uint64_t load(const char* p, size_t n) noexcept {
+      if (n >= 4) {
+        uint32_t low;
+        uint32_t high;
+        std::memcpy(&low, p, 4);
+        std::memcpy(&high, p + n - 4, 4);
+        return low | (static_cast<uint64_t>(high) << (8 * (n - 4)));
+      }
+      if (n == 0) {
+        return 0;
+      }
+      return static_cast<uint64_t>(static_cast<unsigned char>(p[0])) |
+             (static_cast<uint64_t>(static_cast<unsigned char>(p[n / 2])) << (8 * (n / 2))) |
+             (static_cast<uint64_t>(static_cast<unsigned char>(p[n - 1])) << (8 * (n - 1)));
+    }
+
+    explicit constexpr TinyKey(uint64_t word, int) noexcept : _word(word) {}
+
+  public:
+  constexpr TinyKey() noexcept : _word(0) {}
+
+  // From a literal; too long a literal doesn't compile (nor does one
+  // ending in '\0' when the key is constexpr).
+  template <size_t N>
+  constexpr TinyKey(const char (&literal)[N]) : _word(0) {
+    static_assert(N - 1 <= CAPACITY, "TinyKey holds at most 8 bytes");
+    if (N > 1 && literal[N - 2] == '\0') {
+      throw std::invalid_argument("A TinyKey can't end in '\\0'!");
+    }
+    for (size_t i = 0; i + 1 < N; ++i) {
+      _word |= static_cast<uint64_t>(static_cast<unsigned char>(literal[i])) << (8 * i);
+    }
+  }
+
+  TinyKey(const char* p, size_t n) {
+    if (!fits(p, n)) {
+      throw std::invalid_argument("Doesn't fit in a TinyKey!");
+    }
+    _word = load(p, n);
+  }
+
+  // An inline SmallString's first word is already zero padded.
+  explicit TinyKey(const SmallString& s) {
+    if (!fits(s)) {
+      throw std::invalid_argument("Doesn't fit in a TinyKey!");
+    }
+    _word = s.inline_word(0);
+  }
+
+  static bool fits(const char* p, size_t n) noexcept {
+    return n <= CAPACITY && (n == 0 || p[n - 1] != '\0');
+  }
+
+  static bool fits(const SmallString& s) noexcept {
+    return s.length() <= CAPACITY && (s.length() == 0 || s.inline_data()[s.length() - 1] != '\0');
+  }
+
+  // The key whose bytes are word's (little-endian); word's last nonzero
+  // byte ends it.
+  static constexpr TinyKey from_word(uint64_t word) noexcept {
+    return TinyKey(word, 0);
+  }
+
+  constexpr uint64_t word() const noexcept {
+    return _word;
+  }
+
+  constexpr size_t length() const noexcept {
+    return (_word == 0) ? 0 : CAPACITY - static_cast<size_t>(__builtin_clzll(_word)) / 8;
+  }
+
+  // Copies the bytes to out (room for 8), returning how many.
+  size_t copy_to(char* out) const noexcept {
+    std::memcpy(out, &_word, CAPACITY);
+    return length();
+  }
+
+  SmallString to_small_string() const {
+    char bytes[CAPACITY];
+    size_t n = copy_to(bytes);
+    return SmallString(bytes, n);
+  }
+
+  uint64_t hash() const noexcept {
+    return hash_mix(_word ^ HASH_KEY, HASH_MULTIPLIER);
+  }
+
+  friend constexpr bool operator==(TinyKey lhs, TinyKey rhs) noexcept {
+    return lhs._word == rhs._word;
+  }
+
+  // Byteswapped, the first byte is the most significant and the zero
+  // padding makes a prefix come first: lexicographic order, unsigned.
+  friend constexpr std::strong_ordering operator<=>(TinyKey lhs, TinyKey rhs) noexcept {
+    return __builtin_bswap64(lhs._word) <=> __builtin_bswap64(rhs._word);
+  }
+
+};
+
+// For unordered containers keyed by TinyKey.
+struct TinyKeyHash {
+  size_t operator()(TinyKey key) const noexcept {
+    return key.hash();
+  }
+};
+
+#endif
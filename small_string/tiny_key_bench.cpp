@@ -0,0 +1,118 @@
+#include <iostream>
+#include <chrono>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "tiny_key.hpp"
+
+using namespace std;
+
+/*
+Keys of 2 to 8 bytes (method names, country codes, short IDs) as
+TinyKey vs SmallString: ==, hash, and lookups in an unordered_map.
+*/
+
+static volatile size_t sink;
+
+static vector<string> texts(size_t n) {
+  const char* prefixes[] = {"GET", "US", "de", "id", "POST", "x"};
+  vector<string> out;
+  for (size_t i = 0; i < n; ++i) {
+    string s = prefixes[i % 6] + to_string(i % 1000);
+    s.resize((s.size() > 8) ? 8 : s.size());
+    out.push_back(s);
+  }
+  return out;
+}
+
+template <typename Body>
+static void time_ns(const char* name, size_t operations, Body body) {
+  auto start = chrono::steady_clock::now();
+  body();
+  double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+  cout << name << ": " << ns / operations << " ns/op" << endl;
+}
+
+int main() {
+
+  const size_t N = 4096;
+  const size_t ROUNDS = 2000;
+
+  vector<string> text = texts(N);
+  vector<TinyKey> tiny;
+  vector<SmallString> small;
+  for (const string& s : text) {
+    tiny.push_back(TinyKey(s.data(), s.size()));
+    small.push_back(SmallString(s.c_str()));
+  }
+
+  time_ns("SmallString ==", N * ROUNDS, [&]() {
+    size_t hits = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        hits += (small[i] == small[(i + r) % N]);
+      }
+    }
+    sink = hits;
+  });
+
+  time_ns("TinyKey ==", N * ROUNDS, [&]() {
+    size_t hits = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        hits += (tiny[i] == tiny[(i + r) % N]);
+      }
+    }
+    sink = hits;
+  });
+
+  time_ns("SmallString hash", N * ROUNDS, [&]() {
+    uint64_t total = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        total += hash_string(small[i]);
+      }
+    }
+    sink = total;
+  });
+
+  time_ns("TinyKey hash", N * ROUNDS, [&]() {
+    uint64_t total = 0;
+    for (size_t r = 0; r < ROUNDS; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        total += tiny[i].hash();
+      }
+    }
+    sink = total;
+  });
+
+  unordered_map<SmallString, size_t, SmallStringHash, SmallStringEqual> small_map;
+  unordered_map<TinyKey, size_t, TinyKeyHash> tiny_map;
+  for (size_t i = 0; i < N; ++i) {
+    small_map[small[i]] = i;
+    tiny_map[tiny[i]] = i;
+  }
+
+  time_ns("SmallString lookup", N * ROUNDS / 10, [&]() {
+    size_t total = 0;
+    for (size_t r = 0; r < ROUNDS / 10; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        total += small_map.find(small[(i * 7 + r) % N])->second;
+      }
+    }
+    sink = total;
+  });
+
+  time_ns("TinyKey lookup", N * ROUNDS / 10, [&]() {
+    size_t total = 0;
+    for (size_t r = 0; r < ROUNDS / 10; ++r) {
+      for (size_t i = 0; i < N; ++i) {
+        total += tiny_map.find(tiny[(i * 7 + r) % N])->second;
+      }
+    }
+    sink = total;
+  });
+
+  return 0;
+}
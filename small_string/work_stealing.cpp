@@ -0,0 +1,171 @@
+#include <iostream>
+#include <atomic>
+#include <cassert>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "work_stealing.hpp"
+
+using namespace std;
+
+static SmallString lowercase(const SmallString& s) {
+  SmallString out;
+  for (size_t i = 0; i < s.length(); ++i) {
+    char c = s[i];
+    c = (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+    out.append(&c, 1);
+  }
+  return out;
+}
+
+// TESTS
+
+int main() {
+
+  // The deque on its own
+  {
+    RangeDeque deque;
+    uint64_t range;
+    assert (deque.empty() && !deque.pop(range) && !deque.steal(range));
+
+    assert (deque.push(RangeDeque::pack(0, 10)));
+    assert (deque.push(RangeDeque::pack(10, 20)));
+    assert (deque.steal(range) && RangeDeque::begin_of(range) == 0 && RangeDeque::end_of(range) == 10);
+    assert (deque.pop(range) && RangeDeque::begin_of(range) == 10 && RangeDeque::end_of(range) == 20);
+    assert (deque.empty());
+
+    for (size_t i = 0; i < 64; ++i) {
+      assert (deque.push(RangeDeque::pack(i, i + 1)));
+    }
+    assert (!deque.push(RangeDeque::pack(0, 1)));
+  }
+
+  // The arena hands back what was freed on the same thread
+  {
+    SpillArena arena;
+    SpillScope scope(arena);
+
+    SmallString s("a string long enough for the fallback");
+    s.empty();
+    assert (arena.cached_bytes() > 0);
+    size_t cached = arena.cached_bytes();
+    SmallString t("another string long enough for the fallback");
+    assert (arena.cached_bytes() < cached);
+    assert (t.str() == "another string long enough for the fallback");
+  }
+  // Exact capacities neither take bins for good nor crowd the usual
+  // sizes out
+  {
+    SpillArena arena;
+    SpillScope scope(arena);
+    for (size_t n = 0; n < 40; ++n) {
+      SmallString exact;
+      exact.resize_for_overwrite(BUFFER_LIMIT + 100 + 7 * n);
+    }
+    size_t cached = arena.cached_bytes();
+    {
+      SmallString s(string(48, 'x').c_str());
+    }
+    // Its chars, of capacity 40 and the 10 and 20 it outgrew (its
+    // Fallback came from the arena, and went back)
+    assert (arena.cached_bytes() == cached + 10 + 20 + 40);
+  }
+  // Strings made under an arena outlive it
+  SmallString survivor;
+  {
+    SpillArena arena;
+    SpillScope scope(arena);
+    survivor = SmallString("made while the arena was installed, freed after");
+  }
+  assert (survivor.str() == "made while the arena was installed, freed after");
+  assert (char_hooks == nullptr);
+
+  for (size_t threads : {1, 2, 4}) {
+    WorkStealingPool pool(threads);
+    assert (pool.threads() == threads);
+
+    // Every index exactly once, at every grain
+    for (size_t n : {0, 1, 7, 1000, 100000}) {
+      for (size_t grain : {0, 1, 64}) {
+        vector<atomic<int>> seen(n);
+        pool.parallel_for(n, [&](size_t begin, size_t end) {
+          assert (begin < end && end <= n);
+          for (size_t i = begin; i < end; ++i) {
+            ++seen[i];
+          }
+        }, grain);
+        for (size_t i = 0; i < n; ++i) {
+          assert (seen[i] == 1);
+        }
+      }
+    }
+
+    // A pipeline over strings, some of which grow past the buffer
+    const size_t N = 20000;
+    vector<SmallString> in;
+    vector<string> expected;
+    for (size_t i = 0; i < N; ++i) {
+      string s = "Key-" + to_string(i);
+      if (i % 3 == 0) {
+        s += "-WITH-A-TAIL-THAT-SPILLS";
+      }
+      in.push_back(SmallString(s.c_str()));
+      for (char& c : s) {
+        c = (c >= 'A' && c <= 'Z') ? char(c - 'A' + 'a') : c;
+      }
+      expected.push_back(s + "!");
+    }
+
+    vector<SmallString> out(N);
+    parallel_transform(pool, span<const SmallString>(in), span<SmallString>(out), lowercase);
+    parallel_for_each(pool, span<SmallString>(out), [](SmallString& s) {
+      s.append("!");
+    });
+    for (size_t i = 0; i < N; ++i) {
+      assert (out[i].str() == expected[i]);
+    }
+
+    // Nested loops run serially instead of deadlocking
+    atomic<size_t> total(0);
+    pool.parallel_for(100, [&](size_t begin, size_t end) {
+      pool.parallel_for(end - begin, [&](size_t b, size_t e) {
+        total += e - b;
+      });
+    });
+    assert (total == 100);
+
+    // The first exception comes back, and the pool is still usable
+    bool thrown = false;
+    try {
+      pool.parallel_for(10000, [](size_t begin, size_t) {
+        if (begin >= 5000) {
+          throw runtime_error("boom");
+        }
+      }, 16);
+    }
+    catch (const runtime_error&) {
+      thrown = true;
+    }
+    assert (thrown);
+
+    atomic<size_t> count(0);
+    pool.parallel_for(1000, [&](size_t begin, size_t end) {
+      count += end - begin;
+    });
+    assert (count == 1000);
+
+    // Lengths must match
+    thrown = false;
+    try {
+      parallel_transform(pool, span<const SmallString>(in), span<SmallString>(out).first(1), lowercase);
+    }
+    catch (const invalid_argument&) {
+      thrown = true;
+    }
+    assert (thrown);
+  }
+
+  return 0;
+
+}
@@ -0,0 +1,475 @@
+#ifndef WORK_STEALING_HPP
+#define WORK_STEALING_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <stdexcept>
+#include <thread>
+#include <vector>
+
+#include "small_string.hpp"
+
+/*
+WorkStealingPool:
+A fixed set of threads for data-parallel loops over big arrays (the
+usual case being a pipeline of transforms over millions of
+SmallStrings).
+
+parallel_for(n, body) calls body(begin, end) over disjoint ranges that
+cover [0, n). The calling thread takes part, as participant 0.
+
+Every participant has a Chase-Lev deque of ranges: the owner pushes and
+pops at the bottom, everybody else steals from the top. The whole range
+starts in participant 0's deque; ranges are split lazily (lazy binary
+splitting): a participant works through its range grain by grain, and
+only while its own deque is empty does it split off the upper half of
+what's left and push it for others to steal. So a loop is split into as
+many pieces as the load balancing actually asks for, and no more.
+
+Each participant also installs its own SpillArena, a cache of freed
+Fallback blocks, so transforms that grow strings mostly recycle blocks
+within the thread rather than go to the shared heap.
+
+One loop runs at a time; a parallel_for from inside a body just runs
+serially. The first exception a body throws is rethrown by
+parallel_for, once the loop has drained (the rest is skipped).
+*/
+
+/*
+SpillArena:
+Freed Fallback blocks, kept by size up to MAX_CACHED bytes in all. Only
+the sizes that strings grown by appending use are kept: the Fallback
+itself, and capacities of FALLBACK_INITIAL_CAP times a power of two, so
+a few bins cover them. Exact capacities (resize_for_overwrite, splice)
+are rarely asked for twice, so they go straight to the heap rather
+than take a bin. A bin that's emptied can be taken by another size.
+Blocks are plain heap blocks: a string can be freed by any thread, into
+that thread's arena or the heap.
+*/
+class SpillArena {
+
+  static constexpr size_t BINS = 16;
+  static constexpr size_t DEPTH = 64;
+  static constexpr size_t MAX_CACHED = 1 << 20;
+
+  struct Bin {
+    size_t size = 0;
+    size_t count = 0;
+    char* blocks[DEPTH];
+  };
+
+  private:
+  Bin _bins[BINS];
+  size_t _cached;
+  CharHooks _hooks;
+
+    static bool cacheable(size_t n) noexcept {
+      if (n == SmallString::fallback_bytes()) {
+        return true;
+      }
+      size_t doublings = n / FALLBACK_INITIAL_CAP;
+      return n % FALLBACK_INITIAL_CAP == 0 && doublings != 0 && (doublings & (doublings - 1)) == 0;
+    }
+
+    static char* allocate(void* context, size_t n) {
+      SpillArena& arena = *static_cast<SpillArena*>(context);
+      if (!cacheable(n)) {
+        return new char[n];
+      }
+      for (Bin& bin : arena._bins) {
+        if (bin.size == n) {
+          if (bin.count == 0) {
+            break;
+          }
+          arena._cached -= n;
+          return bin.blocks[--bin.count];
+        }
+      }
+      return new char[n];
+    }
+
+    static void release(void* context, char* p, size_t n) noexcept {
+      SpillArena& arena = *static_cast<SpillArena*>(context);
+      if (cacheable(n) && arena._cached + n <= MAX_CACHED) {
+        // The bin for n, or else the first empty one, which takes n.
+        Bin* free_bin = nullptr;
+        for (Bin& bin : arena._bins) {
+          if (bin.size == n) {
+            free_bin = &bin;
+            break;
+          }
+          if (bin.count == 0 && free_bin == nullptr) {
+            free_bin = &bin;
+          }
+        }
+        if (free_bin != nullptr && free_bin->count < DEPTH) {
+          free_bin->size = n;
+          free_bin->blocks[free_bin->count++] = p;
+          arena._cached += n;
+          return;
+        }
+      }
+      delete[] p;
+    }
+
+  public:
+  SpillArena() noexcept : _cached(0), _hooks{this, &SpillArena::allocate, &SpillArena::release} {}
+
+  SpillArena(const SpillArena&) = delete;
+  SpillArena& operator=(const SpillArena&) = delete;
+
+  ~SpillArena() noexcept {
+    for (Bin& bin : _bins) {
+      for (size_t i = 0; i < bin.count; ++i) {
+        delete[] bin.blocks[i];
+      }
+    }
+  }
+
+  const CharHooks* hooks() const noexcept {
+    return &_hooks;
+  }
+
+  size_t cached_bytes() const noexcept {
+    return _cached;
+  }
+
+};
+
+// Makes arena this thread's char hooks for as long as it lives.
+class SpillScope {
+
+  private:
+  const CharHooks* _previous;
+
+  public:
+  explicit SpillScope(const SpillArena& arena) noexcept : _previous(char_hooks) {
+    char_hooks = arena.hooks();
+  }
+
+  SpillScope(const SpillScope&) = delete;
+  SpillScope& operator=(const SpillScope&) = delete;
+
+  ~SpillScope() noexcept {
+    char_hooks = _previous;
+  }
+
+};
+
+/*
+Chase-Lev deque of ranges, of fixed capacity (lazy splitting never
+stacks more than one range per halving, so CAPACITY is plenty; push
+just says no when full). A range is packed into one word, begin in the
+high half and end in the low one, so slots can be plain atomics.
+*/
+class RangeDeque {
+
+  static constexpr int64_t CAPACITY = 64;
+
+  private:
+  alignas(64) std::atomic<int64_t> _top;
+  alignas(64) std::atomic<int64_t> _bottom;
+  std::atomic<uint64_t> _items[CAPACITY];
+
+  public:
+  RangeDeque() noexcept : _top(0), _bottom(0) {}
+
+  static uint64_t pack(size_t begin, size_t end) noexcept {
+    return (static_cast<uint64_t>(begin) << 32) | end;
+  }
+
+  static size_t begin_of(uint64_t range) noexcept {
+    return static_cast<size_t>(range >> 32);
+  }
+
+  static size_t end_of(uint64_t range) noexcept {
+    return static_cast<size_t>(range & UINT32_MAX);
+  }
+
+  // Owner only.
+  bool empty() const noexcept {
+    return _bottom.load(std::memory_order_relaxed) <= _top.load(std::memory_order_relaxed);
+  }
+
+  // Owner only.
+  bool push(uint64_t range) noexcept {
+    int64_t b = _bottom.load(std::memory_order_relaxed);
+    int64_t t = _top.load(std::memory_order_acquire);
+    if (b - t >= CAPACITY) {
+      return false;
+    }
+    _items[b % CAPACITY].store(range, std::memory_order_relaxed);
+    _bottom.store(b + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Owner only.
+  bool pop(uint64_t& range) noexcept {
+    int64_t b = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(b, std::memory_order_seq_cst);
+    int64_t t = _top.load(std::memory_order_seq_cst);
+
+    if (t > b) {
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return false;
+    }
+
+    range = _items[b % CAPACITY].load(std::memory_order_relaxed);
+    if (t == b) {
+      // The last one: race the thieves for it.
+      bool won = _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+      _bottom.store(b + 1, std::memory_order_relaxed);
+      return won;
+    }
+    return true;
+  }
+
+  // Anyone. False if empty, or if another thread got there first.
+  bool steal(uint64_t& range) noexcept {
+    int64_t t = _top.load(std::memory_order_seq_cst);
+    int64_t b = _bottom.load(std::memory_order_seq_cst);
+    if (t >= b) {
+      return false;
+    }
+
+    range = _items[t % CAPACITY].load(std::memory_order_relaxed);
+    return _top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+  }
+
+};
+
+class WorkStealingPool {
+
+  // Largest loop in one go: ranges are packed in 32-bit halves.
+  static constexpr size_t MAX_LOOP = UINT32_MAX;
+
+  struct Participant {
+    RangeDeque deque;
+    SpillArena arena;
+  };
+
+  struct Loop {
+    const std::function<void(size_t, size_t)>* body;
+    size_t grain;
+    std::atomic<size_t> remaining;
+    std::atomic<size_t> inside{0};
+    std::atomic<bool> failed{false};
+    std::mutex error_lock;
+    std::exception_ptr error;
+  };
+
+  private:
+  std::vector<std::unique_ptr<Participant>> _participants;
+  std::vector<std::thread> _workers;
+  std::mutex _lock;
+  std::condition_variable _wake;
+  uint64_t _generation;
+  Loop* _loop;
+  bool _stopping;
+  std::mutex _run_lock;
+
+    static bool& inside_loop() noexcept {
+      static thread_local bool inside = false;
+      return inside;
+    }
+
+    // Works range by grains, splitting off the upper half of the rest
+    // whenever its own deque has run dry.
+    void run_range(Loop& loop, RangeDeque& deque, size_t begin, size_t end) {
+      while (begin < end) {
+        if (end - begin > loop.grain && deque.empty()) {
+          size_t middle = begin + (end - begin) / 2;
+          if (deque.push(RangeDeque::pack(middle, end))) {
+            end = middle;
+          }
+        }
+
+        size_t stop = std::min(end, begin + loop.grain);
+        if (!loop.failed.load(std::memory_order_relaxed)) {
+          try {
+            (*loop.body)(begin, stop);
+          }
+          catch (...) {
+            std::lock_guard<std::mutex> guard(loop.error_lock);
+            if (!loop.failed.exchange(true)) {
+              loop.error = std::current_exception();
+            }
+          }
+        }
+        loop.remaining.fetch_sub(stop - begin, std::memory_order_acq_rel);
+        begin = stop;
+      }
+    }
+
+    // Until the whole loop is done: own deque first, then steal, starting
+    // from the next participant along.
+    void participate(Loop& loop, size_t self) {
+      RangeDeque& deque = _participants[self]->deque;
+      SpillScope spill(_participants[self]->arena);
+      inside_loop() = true;
+
+      uint64_t range;
+      while (loop.remaining.load(std::memory_order_acquire) != 0) {
+        bool found = deque.pop(range);
+        for (size_t i = 1; !found && i < _participants.size(); ++i) {
+          found = _participants[(self + i) % _participants.size()]->deque.steal(range);
+        }
+
+        if (found) {
+          run_range(loop, deque, RangeDeque::begin_of(range), RangeDeque::end_of(range));
+        }
+        else {
+          std::this_thread::yield();
+        }
+      }
+
+      inside_loop() = false;
+    }
+
+    void worker(size_t self) {
+      uint64_t seen = 0;
+      while (true) {
+        Loop* loop;
+        {
+          std::unique_lock<std::mutex> guard(_lock);
+          _wake.wait(guard, [&]() {
+            return _stopping || _generation != seen;
+          });
+          if (_stopping) {
+            return;
+          }
+          seen = _generation;
+          loop = _loop;
+          if (loop == nullptr) {
+            continue; // Woke up after it was over.
+          }
+          loop->inside.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        participate(*loop, self);
+        loop->inside.fetch_sub(1, std::memory_order_release);
+      }
+    }
+
+  public:
+  // threads counts the caller, so threads - 1 are started.
+  explicit WorkStealingPool(size_t threads = std::thread::hardware_concurrency())
+    : _generation(0), _loop(nullptr), _stopping(false) {
+    threads = (threads == 0) ? 1 : threads;
+    for (size_t i = 0; i < threads; ++i) {
+      _participants.push_back(std::make_unique<Participant>());
+    }
+    for (size_t i = 1; i < threads; ++i) {
+      _workers.emplace_back(&WorkStealingPool::worker, this, i);
+    }
+  }
+
+  WorkStealingPool(const WorkStealingPool&) = delete;
+  WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+  ~WorkStealingPool() noexcept {
+    {
+      std::lock_guard<std::mutex> guard(_lock);
+      _stopping = true;
+    }
+    _wake.notify_all();
+    for (std::thread& worker : _workers) {
+      worker.join();
+    }
+  }
+
+  size_t threads() const noexcept {
+    return _participants.size();
+  }
+
+  // grain 0 picks one: small enough that every participant gets several
+  // pieces, big enough that a piece is worth a call.
+  template <typename F>
+  void parallel_for(size_t n, F body, size_t grain = 0) {
+    if (n == 0) {
+      return;
+    }
+    if (grain == 0) {
+      grain = std::clamp<size_t>(n / (16 * threads()), 16, 4096);
+    }
+    if (inside_loop() || threads() == 1) {
+      for (size_t begin = 0; begin < n; begin += grain) {
+        body(begin, std::min(n, begin + grain));
+      }
+      return;
+    }
+
+    std::lock_guard<std::mutex> run_guard(_run_lock);
+    for (size_t offset = 0; offset < n; offset += MAX_LOOP) {
+      size_t count = std::min(n - offset, MAX_LOOP);
+      const std::function<void(size_t, size_t)> shifted = [&body, offset](size_t begin, size_t end) {
+        body(offset + begin, offset + end);
+      };
+
+      Loop loop;
+      loop.body = &shifted;
+      loop.grain = grain;
+      loop.remaining.store(count, std::memory_order_relaxed);
+      _participants[0]->deque.push(RangeDeque::pack(0, count));
+
+      {
+        std::lock_guard<std::mutex> guard(_lock);
+        _loop = &loop;
+        ++_generation;
+      }
+      _wake.notify_all();
+
+      participate(loop, 0);
+
+      // Late risers must not find it, and those inside must be out
+      // before it goes.
+      {
+        std::lock_guard<std::mutex> guard(_lock);
+        _loop = nullptr;
+      }
+      while (loop.inside.load(std::memory_order_acquire) != 0) {
+        std::this_thread::yield();
+      }
+
+      if (loop.error) {
+        std::rethrow_exception(loop.error);
+      }
+    }
+  }
+
+};
+
+// f(s) on every string, in place.
+template <typename F>
+void parallel_for_each(WorkStealingPool& pool, std::span<SmallString> strings, F f, size_t grain = 0) {
+  pool.parallel_for(strings.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      f(strings[i]);
+    }
+  }, grain);
+}
+
+// out[i] = f(in[i]); out must be as long as in (and not overlap it).
+template <typename F>
+void parallel_transform(WorkStealingPool& pool, std::span<const SmallString> in, std::span<SmallString> out, F f,
+                        size_t grain = 0) {
+  if (in.size() != out.size()) {
+    throw std::invalid_argument("Input and output differ in length");
+  }
+
+  pool.parallel_for(in.size(), [&](size_t begin, size_t end) {
+    for (size_t i = begin; i < end; ++i) {
+      out[i] = f(in[i]);
+    }
+  }, grain);
+}
+
+#endif